@@ -17,6 +17,7 @@
 #include <dm.h>
 #include <dm/root.h>
 #include <image.h>
+#include <job.h>
 #include <u-boot/zlib.h>
 #include <asm/byteorder.h>
 #include <libfdt.h>
@@ -94,6 +95,9 @@ static void announce_and_cleanup(int fake)
 
 	board_quiesce_devices();
 
+	/* The kernel brings up the other CPUs itself */
+	job_stop_workers();
+
 	/*
 	 * Call remove function of all devices with a removal flag set.
 	 * This may be useful for last-stage operations, like cancelling
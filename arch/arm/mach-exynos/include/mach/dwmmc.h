@@ -26,5 +26,7 @@
 /* CLKSEL Register */
 #define DWMCI_DIVRATIO_BIT		24
 #define DWMCI_DIVRATIO_MASK		0x7
+#define DWMCI_SAMPLE_CLK_MASK		0x7
+#define DWMCI_SAMPLE_PHASES		8
 
 int exynos_dwmmc_init(const void *blob);
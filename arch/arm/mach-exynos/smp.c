@@ -0,0 +1,191 @@
+/*
+ * Secondary CPUs of the Exynos4412 as job workers
+ *
+ * After reset the boot ROM holds CPUs 1-3 in a wait loop until their word
+ * of iRAM gives an address to jump to. Point them at exynos_smp_entry()
+ * and let each one run job_worker().
+ *
+ * The workers run with the MMU and data cache off, as the boot CPU does
+ * with CONFIG_SYS_DCACHE_OFF, so there is nothing to keep coherent: a job
+ * sees exactly what the boot CPU wrote to memory. With the data cache on,
+ * the boot CPU would first have to join the SCU's coherency domain, which
+ * is not done here, so then no workers are started.
+ *
+ * Before an OS is started the workers power themselves down. Linux finds
+ * them off, as after reset, and powers them up into the boot ROM again.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <job.h>
+#include <malloc.h>
+#include <asm/gic.h>
+#include <asm/io.h>
+#include <asm/arch/cpu.h>
+#include <asm/arch/system.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define EXYNOS4412_CPUS			4
+#define EXYNOS4412_GIC_DIST_BASE	0x10490000
+/* Where the boot ROM looks for each CPU's entry point */
+#define EXYNOS4412_CPU_BOOT_ADDR(cpu)	(0x02020000 + 4 * (cpu))
+/* Power management unit core configuration and status */
+#define EXYNOS4412_CORE_CONFIG(cpu)	\
+	(EXYNOS4X12_POWER_BASE + 0x2000 + 0x80 * (cpu))
+#define EXYNOS4412_CORE_STATUS(cpu)	(EXYNOS4412_CORE_CONFIG(cpu) + 4)
+#define CORE_LOCAL_PWR_EN		0x3
+
+#define SMP_STACK_SIZE			(16 << 10)
+#define SMP_START_TIMEOUT_MS		100
+
+void exynos_smp_entry(void);
+
+/* Read by exynos_smp_entry(): global data, and a stack for each CPU */
+ulong exynos_smp_gd;
+ulong exynos_smp_stack[EXYNOS4412_CPUS];
+
+static int exynos_smp_online[EXYNOS4412_CPUS];
+
+/*
+ * Power this CPU down, which happens at the next wfi. Should it stay on,
+ * wait for a boot address as the boot ROM does.
+ */
+static void __noreturn exynos_smp_park(int cpu)
+{
+	void (*entry)(void);
+	u32 actlr;
+
+	writel(0, EXYNOS4412_CPU_BOOT_ADDR(cpu));
+
+	/* Leave the SCU's coherency domain, as Linux does before power down */
+	asm volatile("mrc p15, 0, %0, c1, c0, 1" : "=r" (actlr));
+	actlr &= ~(1 << 6);
+	asm volatile("mcr p15, 0, %0, c1, c0, 1" : : "r" (actlr));
+	isb();
+
+	writel(0, EXYNOS4412_CORE_CONFIG(cpu));
+	writel(0, &exynos_smp_online[cpu]);
+	dsb();
+	sev();
+
+	for (;;) {
+		wfi();
+		entry = (void *)readl(EXYNOS4412_CPU_BOOT_ADDR(cpu));
+		if (entry)
+			entry();
+	}
+}
+
+/* Called by exynos_smp_entry() on each secondary CPU */
+void exynos_smp_main(int cpu)
+{
+	writel(1, &exynos_smp_online[cpu]);
+	dsb();
+	sev();
+	job_worker(cpu - 1);
+	exynos_smp_park(cpu);
+}
+
+static int exynos_smp_start(int cpu)
+{
+	ulong start;
+	void *stack;
+
+	/* A CPU started before keeps its stack */
+	if (!exynos_smp_stack[cpu]) {
+		stack = malloc(SMP_STACK_SIZE);
+		if (!stack)
+			return -ENOMEM;
+		exynos_smp_stack[cpu] = (ulong)stack + SMP_STACK_SIZE;
+	}
+
+	if ((readl(EXYNOS4412_CORE_STATUS(cpu)) & CORE_LOCAL_PWR_EN) !=
+	    CORE_LOCAL_PWR_EN) {
+		writel(CORE_LOCAL_PWR_EN, EXYNOS4412_CORE_CONFIG(cpu));
+		start = get_timer(0);
+		while ((readl(EXYNOS4412_CORE_STATUS(cpu)) &
+			CORE_LOCAL_PWR_EN) != CORE_LOCAL_PWR_EN) {
+			if (get_timer(start) > SMP_START_TIMEOUT_MS)
+				goto err;
+		}
+	}
+
+	/* The ROM may wait for an event or for an interrupt */
+	writel((ulong)exynos_smp_entry, EXYNOS4412_CPU_BOOT_ADDR(cpu));
+	dsb();
+	sev();
+	writel(1 << (16 + cpu), EXYNOS4412_GIC_DIST_BASE + GICD_SGIR);
+
+	start = get_timer(0);
+	while (!readl(&exynos_smp_online[cpu])) {
+		if (get_timer(start) > SMP_START_TIMEOUT_MS)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	/* Keep the CPU from coming in later, as its stack is freed */
+	writel(0, EXYNOS4412_CPU_BOOT_ADDR(cpu));
+	dsb();
+	free((void *)(exynos_smp_stack[cpu] - SMP_STACK_SIZE));
+	exynos_smp_stack[cpu] = 0;
+
+	return -ETIMEDOUT;
+}
+
+int arch_job_start_workers(int max)
+{
+	int cpu;
+
+	if (!proid_is_exynos4412() || dcache_status())
+		return 0;
+
+	exynos_smp_gd = (ulong)gd;
+	dsb();
+
+	/*
+	 * CPU n runs worker n - 1. Stop at the first CPU that does not start,
+	 * so that if it does later, its worker is never given a job.
+	 */
+	for (cpu = 1; cpu < EXYNOS4412_CPUS && cpu <= max; cpu++) {
+		if (exynos_smp_start(cpu)) {
+			printf("CPU%d did not start\n", cpu);
+			break;
+		}
+	}
+
+	return cpu - 1;
+}
+
+void arch_job_stop_workers(int count)
+{
+	ulong start;
+	int cpu;
+
+	/* Each worker clears its online flag before powering down */
+	for (cpu = 1; cpu <= count; cpu++) {
+		start = get_timer(0);
+		while (readl(&exynos_smp_online[cpu]) ||
+		       readl(EXYNOS4412_CORE_STATUS(cpu)) & CORE_LOCAL_PWR_EN) {
+			if (get_timer(start) > SMP_START_TIMEOUT_MS) {
+				printf("CPU%d did not power down\n", cpu);
+				break;
+			}
+		}
+	}
+}
+
+void arch_job_idle(void)
+{
+	wfe();
+}
+
+void arch_job_notify(void)
+{
+	dsb();
+	sev();
+}
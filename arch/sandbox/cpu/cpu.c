@@ -6,6 +6,7 @@
 #include <common.h>
 #include <dm.h>
 #include <errno.h>
+#include <job.h>
 #include <libfdt.h>
 #include <os.h>
 #include <asm/io.h>
@@ -164,3 +165,37 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#ifdef CONFIG_JOBS
+/* Threads stand in for the three secondary CPUs of a quad-core SoC */
+#define SANDBOX_JOB_WORKERS	3
+
+static void *sandbox_job_worker(void *arg)
+{
+	job_worker((long)arg);
+
+	return NULL;
+}
+
+int arch_job_start_workers(int max)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < min(max, SANDBOX_JOB_WORKERS); cpu++) {
+		if (os_thread_create(sandbox_job_worker, (void *)(long)cpu))
+			break;
+	}
+
+	return cpu;
+}
+
+void arch_job_idle(void)
+{
+	os_event_wait();
+}
+
+void arch_job_notify(void)
+{
+	os_event_signal();
+}
+#endif
@@ -52,9 +52,12 @@ static int _raw_packet_start(const char *ifname, unsigned char *ethmac,
 		       strerror(errno));
 		return -errno;
 	}
-	/* Bind to the specified interface */
-	ret = setsockopt(priv->sd, SOL_SOCKET, SO_BINDTODEVICE, ifname,
-		   strlen(ifname) + 1);
+	/*
+	 * Bind to the specified interface. SO_BINDTODEVICE does not stop a
+	 * packet socket from receiving on every interface, and recvfrom()
+	 * then points device at whichever one the last packet came from.
+	 */
+	ret = bind(priv->sd, (struct sockaddr *)device, sizeof(*device));
 	if (ret < 0) {
 		printf("Failed to bind to '%s': %d %s\n", ifname, errno,
 		       strerror(errno));
@@ -239,6 +242,43 @@ int sandbox_eth_raw_os_recv(void *packet, int *length,
 	return -errno;
 }
 
+int sandbox_eth_raw_os_recv_split(void *packet, int hdr_len, void *dst,
+				  int len, int *length,
+				  const struct eth_sandbox_raw_priv *priv)
+{
+	struct iovec iov[3];
+	struct msghdr msg;
+	int retval;
+
+	if (!priv->sd || !priv->device)
+		return -EINVAL;
+
+	/* Anything past the end of @dst goes after it in the packet buffer */
+	iov[0].iov_base = packet;
+	iov[0].iov_len = hdr_len;
+	iov[1].iov_base = dst;
+	iov[1].iov_len = len;
+	iov[2].iov_base = packet + hdr_len + len;
+	iov[2].iov_len = hdr_len + len < 1536 ? 1536 - hdr_len - len : 0;
+	memset(&msg, '\0', sizeof(msg));
+	msg.msg_name = priv->device;
+	msg.msg_namelen = sizeof(struct sockaddr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 3;
+	retval = recvmsg(priv->sd, &msg, 0);
+	*length = 0;
+	if (retval >= 0) {
+		if (retval > hdr_len + len)
+			memcpy(packet + hdr_len, dst, len);
+		*length = retval;
+		return 0;
+	}
+	/* The socket is non-blocking, so expect EAGAIN when there is no data */
+	if (errno == EAGAIN)
+		return 0;
+	return -errno;
+}
+
 void sandbox_eth_raw_os_stop(struct eth_sandbox_raw_priv *priv)
 {
 	free(priv->device);
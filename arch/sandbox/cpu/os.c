@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -187,6 +188,43 @@ void os_usleep(unsigned long usec)
 	usleep(usec);
 }
 
+int os_thread_create(void *(*func)(void *arg), void *arg)
+{
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, func, arg))
+		return -1;
+	pthread_detach(thread);
+
+	return 0;
+}
+
+/*
+ * Each thread notes the last event it saw, so an event signalled after it
+ * last woke is not missed, as with the ARM event register
+ */
+static pthread_mutex_t os_event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t os_event_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long os_event_count;
+static __thread unsigned long os_event_seen;
+
+void os_event_wait(void)
+{
+	pthread_mutex_lock(&os_event_lock);
+	while (os_event_count == os_event_seen)
+		pthread_cond_wait(&os_event_cond, &os_event_lock);
+	os_event_seen = os_event_count;
+	pthread_mutex_unlock(&os_event_lock);
+}
+
+void os_event_signal(void)
+{
+	pthread_mutex_lock(&os_event_lock);
+	os_event_count++;
+	pthread_cond_broadcast(&os_event_cond);
+	pthread_mutex_unlock(&os_event_lock);
+}
+
 uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 {
 #if defined(CLOCK_MONOTONIC) && defined(_POSIX_MONOTONIC_CLOCK)
@@ -35,6 +35,9 @@ int sandbox_eth_raw_os_send(void *packet, int length,
 			    struct eth_sandbox_raw_priv *priv);
 int sandbox_eth_raw_os_recv(void *packet, int *length,
 			    const struct eth_sandbox_raw_priv *priv);
+int sandbox_eth_raw_os_recv_split(void *packet, int hdr_len, void *dst,
+				  int len, int *length,
+				  const struct eth_sandbox_raw_priv *priv);
 void sandbox_eth_raw_os_stop(struct eth_sandbox_raw_priv *priv);
 
 #endif /* __ETH_RAW_OS_H */
@@ -14,4 +14,10 @@ void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+void sandbox_eth_set_tftp_file(int size);
+
+int sandbox_eth_get_tftp_placed(void);
+
+int sandbox_eth_get_tftp_resent(void);
+
 #endif /* __ETH_H */
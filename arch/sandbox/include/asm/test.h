@@ -79,4 +79,40 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_mmc_cmd_count() - get the number of commands sent to an MMC device
+ *
+ * @dev:	sandbox MMC device
+ * @cmdidx:	command index (MMC_CMD_...)
+ * @return number of such commands since the last
+ *	sandbox_mmc_clear_cmd_counts()
+ */
+uint sandbox_mmc_cmd_count(struct udevice *dev, int cmdidx);
+
+/**
+ * sandbox_mmc_clear_cmd_counts() - reset the command counts of a device
+ *
+ * @dev:	sandbox MMC device
+ */
+void sandbox_mmc_clear_cmd_counts(struct udevice *dev);
+
+/**
+ * sandbox_mmc_data_pending() - check for a transfer left running
+ *
+ * @dev:	sandbox MMC device
+ * @return true if a command was started with its data not yet waited for
+ */
+bool sandbox_mmc_data_pending(struct udevice *dev);
+
+/**
+ * sandbox_mmc_set_emmc() - choose the card a sandbox MMC device emulates
+ *
+ * The change takes effect at the next mmc_init().
+ *
+ * @dev:	sandbox MMC device
+ * @emmc:	true for an HS200-capable eMMC, false for an SD card
+ * @good_phases: bitmask of the tuning sample phases at which HS200 works
+ */
+void sandbox_mmc_set_emmc(struct udevice *dev, bool emmc, u8 good_phases);
+
 #endif
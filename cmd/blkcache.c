@@ -14,23 +14,35 @@ static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
 	struct block_cache_stats stats;
+	struct block_cache_dev_stats dstats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
+	       "max cache entries: %u\n"
+	       "max read-ahead blocks: %u\n",
 	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.max_prefetch);
+
+	for (i = 0; !blkcache_dev_stats(i, &dstats); i++)
+		printf("%s %d: hits %u, misses %u, entries %u, "
+		       "read ahead %u, used %u\n",
+		       blk_get_if_type_name(dstats.iftype), dstats.devnum,
+		       dstats.hits, dstats.misses, dstats.entries,
+		       dstats.prefetched, dstats.prefetch_used);
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, max_entries, max_prefetch;
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
@@ -38,12 +50,17 @@ static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 	blkcache_configure(blocks_per_entry, max_entries);
 	printf("changed to max of %u entries of %u blocks each\n",
 	       max_entries, blocks_per_entry);
+	if (argc == 4) {
+		max_prefetch = simple_strtoul(argv[3], 0, 0);
+		blkcache_configure_readahead(max_prefetch);
+		printf("reading up to %u blocks ahead\n", max_prefetch);
+	}
 	return 0;
 }
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,8 +97,8 @@ static int do_blkcache(cmd_tbl_t *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
-	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"show - show and reset statistics, also per device\n"
+	"blkcache configure blocks entries [readahead]\n"
 );
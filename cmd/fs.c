@@ -27,21 +27,44 @@ U_BOOT_CMD(
 static int do_load_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
-	efi_set_bootdev(argv[1], (argc > 2) ? argv[2] : "",
-			(argc > 4) ? argv[4] : "");
+	char * const *args = argv;
+	int nargs = argc;
+
+	/* do_load() handles '-h <algo>' and '-d' itself */
+	if (nargs > 2 && !strcmp(args[1], "-h")) {
+		args += 2;
+		nargs -= 2;
+	}
+	if (nargs > 1 && !strcmp(args[1], "-d")) {
+		args++;
+		nargs--;
+	}
+	efi_set_bootdev(args[1], (nargs > 2) ? args[2] : "",
+			(nargs > 4) ? args[4] : "");
 	return do_load(cmdtp, flag, argc, argv, FS_TYPE_ANY);
 }
 
 U_BOOT_CMD(
-	load,	7,	0,	do_load_wrapper,
+	load,	9,	0,	do_load_wrapper,
 	"load binary file from a filesystem",
+	"[-h <algo>] "
+#ifdef CONFIG_DECOMP_STREAM
+	"[-d] "
+#endif
 	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [pos]]]]]\n"
 	"    - Load binary file 'filename' from partition 'part' on device\n"
 	"       type 'interface' instance 'dev' to address 'addr' in memory.\n"
 	"      'bytes' gives the size to load in bytes.\n"
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
-	"      If 'pos' is 0 or omitted, the file is read from the start."
+	"      If 'pos' is 0 or omitted, the file is read from the start.\n"
+	"      With -h the file is hashed with 'algo' (e.g. sha256) as it is\n"
+	"      read, and the digest is stored in 'filehash'."
+#ifdef CONFIG_DECOMP_STREAM
+	"\n"
+	"      With -d the gzip or LZ4 file is decompressed to 'addr' as it\n"
+	"      is read, and 'filesize' gives the decompressed size."
+#endif
 )
 
 static int do_save_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -89,3 +112,22 @@ U_BOOT_CMD(
 	"fstype <interface> <dev>:<part> <varname>\n"
 	"- set environment variable to filesystem type\n"
 );
+
+static int do_fs_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char * const argv[])
+{
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "umount"))
+		return do_fs_umount(cmdtp, flag, argc - 1, argv + 1);
+
+	return CMD_RET_USAGE;
+}
+
+U_BOOT_CMD(
+	fs, 2, 1, do_fs_wrapper,
+	"filesystem layer control",
+	"umount\n"
+	"- release the filesystem kept mounted by earlier commands\n"
+);
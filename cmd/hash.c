@@ -47,7 +47,9 @@ U_BOOT_CMD(
 	hash,	HARGS,	1,	do_hash,
 	"compute hash message digest",
 	"algorithm address count [[*]hash_dest]\n"
-		"    - compute message digest [save to env var / *address]"
+		"    - compute message digest [save to env var / *address]\n"
+	"hash algorithm,algorithm... address count\n"
+		"    - compute several message digests in one pass over memory"
 #ifdef CONFIG_HASH_VERIFY
 	"\nhash -v algorithm address count [*]hash\n"
 		"    - verify message digest of memory area to immediate value, \n"
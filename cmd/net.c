@@ -110,6 +110,19 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -442,3 +455,55 @@ U_BOOT_CMD(
 );
 
 #endif  /* CONFIG_CMD_LINK_LOCAL */
+
+#if defined(CONFIG_CMD_NET_STATS)
+static int do_net_stats(struct udevice *dev, int argc, char * const argv[])
+{
+	struct eth_rx_stats *stats = eth_get_rx_stats(dev);
+	ulong per_poll;
+
+	if (argc == 3) {
+		if (strcmp(argv[2], "clear"))
+			return CMD_RET_USAGE;
+		memset(stats, '\0', sizeof(*stats));
+		return CMD_RET_SUCCESS;
+	}
+
+	/* Packets per busy poll, in tenths */
+	per_poll = stats->busy_polls ?
+		stats->packets * 10 / stats->busy_polls : 0;
+	printf("%s: %lu polls, %lu with packets\n", eth_get_name(),
+	       stats->polls, stats->busy_polls);
+	printf("packets: %lu, %lu.%lu per poll with packets, %lu at most\n",
+	       stats->packets, per_poll / 10, per_poll % 10,
+	       stats->max_batch);
+	printf("device checks: %lu\n", stats->checks);
+	printf("polls stopped at the budget of %d: %lu\n",
+	       CONFIG_NET_RX_BUDGET, stats->budget_hit);
+
+	return CMD_RET_SUCCESS;
+}
+
+static int do_net(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct udevice *dev;
+
+	if (argc < 2 || strcmp(argv[1], "stats"))
+		return CMD_RET_USAGE;
+
+	dev = eth_get_dev();
+	if (!dev) {
+		puts("No ethernet found.\n");
+		return CMD_RET_FAILURE;
+	}
+
+	return do_net_stats(dev, argc, argv);
+}
+
+U_BOOT_CMD(
+	net,	3,	1,	do_net,
+	"network device information",
+	"stats - show how packets came in from the current device\n"
+	"net stats clear - clear those statistics"
+);
+#endif	/* CONFIG_CMD_NET_STATS */
@@ -9,9 +9,141 @@
  */
 
 #include <common.h>
+#include <bootm.h>
 #include <command.h>
+#include <decomp_stream.h>
+#include <job.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <memalign.h>
+#include <mmc.h>
 #include <part.h>
 
+#ifdef CONFIG_DECOMP_STREAM
+/* read_decomp() reads this much at a time into each of its two buffers */
+#define READ_DECOMP_CHUNK	(256 << 10)
+
+struct read_decomp_piece {
+	struct decomp_stream *ds;
+	const void *buf;
+	size_t len;
+};
+
+static int read_decomp_piece(void *arg)
+{
+	struct read_decomp_piece *piece = arg;
+
+	return decomp_stream_feed(piece->ds, piece->buf, piece->len);
+}
+
+/*
+ * Start reading blocks, leaving the read to run in the background if the
+ * device can. Returns the number of blocks being read, -ve on error.
+ */
+static long read_decomp_start(struct blk_desc *desc, lbaint_t start,
+			      lbaint_t cnt, void *dst, bool *async)
+{
+	*async = false;
+#ifdef CONFIG_MMC
+	if (desc->if_type == IF_TYPE_MMC) {
+		*async = true;
+		return mmc_bread_submit(desc, start, cnt, dst);
+	}
+#endif
+	return blk_dread(desc, start, cnt, dst) == cnt ? cnt : -EIO;
+}
+
+/* Wait for the read from read_decomp_start(), return its size or -ve */
+static long read_decomp_finish(struct blk_desc *desc, long n, bool async)
+{
+#ifdef CONFIG_MMC
+	if (async)
+		return mmc_bread_complete(desc);
+#endif
+	return n;
+}
+
+/*
+ * Read blocks and decompress them to @dst. Each piece is decompressed, on
+ * another CPU if there is one, while the next is read.
+ */
+static int read_decomp(struct blk_desc *desc, lbaint_t start, lbaint_t cnt,
+		       void *dst, ulong size, ulong *outlen)
+{
+	lbaint_t chunk = READ_DECOMP_CHUNK / desc->blksz;
+	struct read_decomp_piece piece;
+	struct decomp_stream ds;
+	struct job job;
+	bool started = false, busy = false, async;
+	char *buf[2];
+	int cur = 0;
+	size_t len;
+	long n;
+	int ret, err;
+
+	buf[0] = malloc_cache_aligned(2 * chunk * desc->blksz);
+	if (!buf[0])
+		return -ENOMEM;
+	buf[1] = buf[0] + chunk * desc->blksz;
+
+	n = read_decomp_start(desc, start, min(cnt, chunk), buf[cur], &async);
+	for (ret = 0; n > 0; cur = !cur) {
+		n = read_decomp_finish(desc, n, async);
+		if (n <= 0)
+			break;
+		start += n;
+		cnt -= n;
+		len = n * desc->blksz;
+
+		/* Read the next piece into the other buffer once it is free */
+		if (busy) {
+			busy = false;
+			ret = job_wait(&job);
+			if (ret) {
+				n = 0;
+				break;
+			}
+		}
+		n = cnt ? read_decomp_start(desc, start, min(cnt, chunk),
+					    buf[!cur], &async) : 0;
+
+		if (!started) {
+			ret = decomp_stream_start(&ds, dst, size, buf[cur], len);
+			if (ret)
+				break;
+			started = true;
+		} else {
+			piece.ds = &ds;
+			piece.buf = buf[cur];
+			piece.len = len;
+			job_submit(&job, read_decomp_piece, &piece);
+			busy = true;
+		}
+	}
+	/* After an error, let any read still going finish */
+	if (n > 0)
+		read_decomp_finish(desc, n, async);
+	if (n < 0 && !ret)
+		ret = -EIO;
+	if (busy) {
+		err = job_wait(&job);
+		if (!ret)
+			ret = err;
+	}
+	if (started) {
+		err = decomp_stream_end(&ds);
+		if (!ret)
+			ret = err;
+		*outlen = ds.out;
+	} else if (!ret) {
+		ret = -EINVAL;
+	}
+	free(buf[0]);
+
+	return ret;
+}
+#endif
+
 int do_read(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	char *ep;
@@ -24,6 +156,17 @@ int do_read(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	void *addr;
 	uint blk;
 	uint cnt;
+#ifdef CONFIG_DECOMP_STREAM
+	bool decomp = false;
+	ulong outlen;
+	int ret;
+
+	if (argc > 1 && !strcmp(argv[1], "-d")) {
+		decomp = true;
+		argc--;
+		argv++;
+	}
+#endif
 
 	if (argc != 6) {
 		cmd_usage(cmdtp);
@@ -45,7 +188,7 @@ int do_read(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return 1;
 	}
 
-	addr = (void *)simple_strtoul(argv[3], NULL, 16);
+	addr = map_sysmem(simple_strtoul(argv[3], NULL, 16), 0);
 	blk = simple_strtoul(argv[4], NULL, 16);
 	cnt = simple_strtoul(argv[5], NULL, 16);
 
@@ -66,6 +209,23 @@ int do_read(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return 1;
 	}
 
+#ifdef CONFIG_DECOMP_STREAM
+	if (decomp) {
+		ret = read_decomp(dev_desc, offset + blk, cnt, addr,
+				  CONFIG_SYS_BOOTM_LEN, &outlen);
+		if (ret == -ENOBUFS) {
+			printf("Image too large: increase CONFIG_SYS_BOOTM_LEN\n");
+			return 1;
+		} else if (ret) {
+			printf("Error decompressing blocks (err=%d)\n", ret);
+			return 1;
+		}
+		printf("Uncompressed size: %lu = 0x%lX\n", outlen, outlen);
+		env_set_hex("filesize", outlen);
+		return 0;
+	}
+#endif
+
 	if (blk_dread(dev_desc, offset + blk, cnt, addr) != cnt) {
 		printf("Error reading blocks\n");
 		return 1;
@@ -75,7 +235,13 @@ int do_read(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 }
 
 U_BOOT_CMD(
-	read,	6,	0,	do_read,
+	read,	7,	0,	do_read,
 	"Load binary data from a partition",
+#ifdef CONFIG_DECOMP_STREAM
+	"[-d] "
+#endif
 	"<interface> <dev[:part]> addr blk# cnt"
+#ifdef CONFIG_DECOMP_STREAM
+	"\n    - with -d, decompress the gzip or LZ4 data to addr as it is read"
+#endif
 );
@@ -0,0 +1,54 @@
+/*
+ * zstd uncompress command, made from the lzmadec command
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <mapmem.h>
+#include <asm/io.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static int do_zstddec(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	unsigned long src, dst, src_len;
+	size_t dst_len = 0;
+	int ret;
+
+	switch (argc) {
+	case 5:
+		dst_len = simple_strtoul(argv[4], NULL, 16);
+		/* fall through */
+	case 4:
+		src = simple_strtoul(argv[1], NULL, 16);
+		src_len = simple_strtoul(argv[2], NULL, 16);
+		dst = simple_strtoul(argv[3], NULL, 16);
+		break;
+	default:
+		return CMD_RET_USAGE;
+	}
+
+	/* Without a size, the output may go up to the top of RAM */
+	if (!dst_len && dst < gd->ram_top)
+		dst_len = gd->ram_top - dst;
+	ret = zstd_decompress(map_sysmem(src, src_len), src_len,
+			      map_sysmem(dst, dst_len), &dst_len);
+
+	if (ret) {
+		printf("zstd: uncompress error %d\n", ret);
+		return 1;
+	}
+	printf("Uncompressed size: %ld = %#lX\n", (ulong)dst_len,
+	       (ulong)dst_len);
+	env_set_hex("filesize", dst_len);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	zstddec,    5,    1,    do_zstddec,
+	"zstd uncompress a memory region",
+	"srcaddr srcsize dstaddr [dstsize]"
+);
@@ -909,8 +909,8 @@ void board_init_f(ulong boot_flags)
 	gd->have_console = 0;
 
 	/* 尝试点灯 */
-	*gpk1con = 0x1<<4;
-	*gpk1dat = (0x1 << 1);
+	if (!IS_ENABLED(CONFIG_SANDBOX)) *gpk1con = 0x1<<4;
+	if (!IS_ENABLED(CONFIG_SANDBOX)) *gpk1dat = (0x1 << 1);
 
 
 	if (initcall_run_list(init_sequence_f))
@@ -11,6 +11,7 @@
 #include <bzlib.h>
 #include <errno.h>
 #include <fdt_support.h>
+#include <job.h>
 #include <lmb.h>
 #include <malloc.h>
 #include <mapmem.h>
@@ -30,11 +31,6 @@
 #include <bootm.h>
 #include <image.h>
 
-#ifndef CONFIG_SYS_BOOTM_LEN
-/* use 8MByte as default max gunzip size */
-#define CONFIG_SYS_BOOTM_LEN	0x800000
-#endif
-
 #define IH_INITRD_ARCH IH_ARCH_DEFAULT
 
 #ifndef USE_HOSTCC
@@ -337,9 +333,155 @@ static int handle_decomp_error(int comp_type, size_t uncomp_size,
 	return BOOTM_ERR_RESET;
 }
 
+#if defined(CONFIG_LZ4) || defined(CONFIG_ZSTD)
+/* Most frames bootm_decomp_frames() splits an image into */
+#define BOOTM_MAX_FRAMES	32
+
+/**
+ * struct bootm_frame - One frame of a compressed image
+ *
+ * @job:	Job decompressing it
+ * @comp:	Compression type (IH_COMP_...)
+ * @hashed:	true if a hash covers the compressed data
+ * @src:	The frame
+ * @srcn:	Its length
+ * @dst:	Where it is decompressed to
+ * @dstn:	Size it decompresses to, then size it did decompress to
+ * @work:	Work area for the decompressor
+ */
+struct bootm_frame {
+	struct job job;
+	int comp;
+	bool hashed;
+	const void *src;
+	size_t srcn;
+	void *dst;
+	size_t dstn;
+	void *work;
+};
+
+static int bootm_decomp_frame(void *arg)
+{
+	struct bootm_frame *frame = arg;
+
+	switch (frame->comp) {
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+		return ulz4fn_verify(frame->src, frame->srcn, frame->dst,
+				     &frame->dstn, !frame->hashed);
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return zstd_decompress_work(frame->src, frame->srcn,
+					    frame->dst, &frame->dstn,
+					    frame->work);
+#endif
+	}
+
+	return -EPROTONOSUPPORT;
+}
+
+/**
+ * bootm_decomp_frames() - Decompress the frames of an image in parallel
+ *
+ * LZ4 and zstd frames are independent of each other, and their headers
+ * can say how big each one is once decompressed. So when there are other
+ * CPUs to help, an image made of several frames is decompressed a frame
+ * per job.
+ *
+ * @comp:	Compression type (IH_COMP_LZ4 or IH_COMP_ZSTD)
+ * @load_buf:	Where to decompress to
+ * @image_buf:	The compressed image
+ * @image_len:	Its length
+ * @unc_len:	Available space for decompression
+ * @hashed:	true if a hash covers the compressed data
+ * @outlen:	Returns the decompressed size
+ * @return 0 if OK, 1 if the image is to be decompressed in one piece
+ * instead, -ve error from the decompressor
+ */
+static int bootm_decomp_frames(int comp, void *load_buf,
+			       const void *image_buf, ulong image_len,
+			       uint unc_len, bool hashed, ulong *outlen)
+{
+	const void *in = image_buf, *end = image_buf + image_len;
+	struct bootm_frame *frames;
+	ulong total = 0;
+	void *work = NULL;
+	size_t framen;
+	u64 content;
+	int count = 0, i, ret, err;
+
+	if (job_workers() <= 0)
+		return 1;
+	frames = calloc(BOOTM_MAX_FRAMES, sizeof(*frames));
+	if (!frames)
+		return 1;
+
+	for (; in < end; in += framen, count++) {
+		if (count == BOOTM_MAX_FRAMES)
+			goto whole;
+		if (comp == IH_COMP_LZ4)
+			ret = ulz4fn_frame_info(in, end - in, &framen,
+						&content);
+		else
+			ret = zstd_frame_info(in, end - in, &framen, &content);
+		if (ret || content == -1ULL)
+			goto whole;
+		if (content > unc_len - total) {
+			*outlen = unc_len;
+			free(frames);
+			return -ENOBUFS;
+		}
+		frames[count].comp = comp;
+		frames[count].hashed = hashed;
+		frames[count].src = in;
+		frames[count].srcn = framen;
+		frames[count].dst = load_buf + total;
+		frames[count].dstn = content;
+		total += content;
+	}
+	/* Decompressing in place must go front to back */
+	if (count < 2 ||
+	    (load_buf < image_buf + image_len && load_buf + total > image_buf))
+		goto whole;
+	if (comp == IH_COMP_ZSTD) {
+		work = malloc(count * zstd_work_size());
+		if (!work)
+			goto whole;
+		for (i = 0; i < count; i++)
+			frames[i].work = work + i * zstd_work_size();
+	}
+
+	for (i = 0; i < count; i++)
+		job_submit(&frames[i].job, bootm_decomp_frame, &frames[i]);
+	for (i = 0, ret = 0; i < count; i++) {
+		void *next = load_buf + total;
+
+		if (i + 1 < count)
+			next = frames[i + 1].dst;
+		err = job_wait(&frames[i].job);
+		/* A frame must fill the space its header asked for */
+		if (!err && frames[i].dst + frames[i].dstn != next)
+			err = -EINVAL;
+		if (!ret)
+			ret = err;
+	}
+	*outlen = total;
+	free(work);
+	free(frames);
+
+	return ret;
+
+whole:
+	free(frames);
+
+	return 1;
+}
+#endif
+
 int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		       void *load_buf, void *image_buf, ulong image_len,
-		       uint unc_len, ulong *load_end)
+		       uint unc_len, bool hashed, ulong *load_end)
 {
 	int ret = 0;
 
@@ -405,11 +547,29 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 	case IH_COMP_LZ4: {
 		size_t size = unc_len;
 
-		ret = ulz4fn(image_buf, image_len, load_buf, &size);
+		ret = bootm_decomp_frames(comp, load_buf, image_buf, image_len,
+					  unc_len, hashed, &image_len);
+		if (ret != 1)
+			break;
+		ret = ulz4fn_verify(image_buf, image_len, load_buf, &size,
+				    !hashed);
 		image_len = size;
 		break;
 	}
 #endif /* CONFIG_LZ4 */
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD: {
+		size_t size = unc_len;
+
+		ret = bootm_decomp_frames(comp, load_buf, image_buf, image_len,
+					  unc_len, hashed, &image_len);
+		if (ret != 1)
+			break;
+		ret = zstd_decompress(image_buf, image_len, load_buf, &size);
+		image_len = size;
+		break;
+	}
+#endif /* CONFIG_ZSTD */
 	default:
 		printf("Unimplemented compression type %d\n", comp);
 		return BOOTM_ERR_UNIMPLEMENTED;
@@ -425,6 +585,55 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 }
 
 #ifndef USE_HOSTCC
+/*
+ * Check whether the OS image data was checked against a hash when it was
+ * selected from the FIT, so that the decompressor need not check it again
+ */
+static bool bootm_os_hashed(bootm_headers_t *images)
+{
+#if IMAGE_ENABLE_FIT
+	const void *fit = images->fit_hdr_os;
+	int noffset;
+
+	if (!images->verify || !fit)
+		return false;
+	fdt_for_each_subnode(noffset, fit, images->fit_noffset_os) {
+		if (!strncmp(fit_get_name(fit, noffset, NULL),
+			     FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			return true;
+	}
+#endif
+
+	return false;
+}
+
+/*
+ * Check the hashes of a FIT kernel left by fit_image_load(), which @vj may
+ * have worked out already
+ */
+static int bootm_os_verify(bootm_headers_t *images, struct fit_verify_job *vj)
+{
+#if IMAGE_ENABLE_FIT
+	int ok;
+
+	puts("   Verifying Hash Integrity ... ");
+	if (vj)
+		ok = fit_image_verify_finish(vj);
+	else
+		ok = fit_image_verify(images->fit_hdr_os,
+				      images->fit_noffset_os);
+	if (!ok) {
+		puts("Bad Data Hash\n");
+		bootstage_error(BOOTSTAGE_ID_FIT_KERNEL_START +
+				BOOTSTAGE_SUB_HASH);
+		return -EACCES;
+	}
+	puts("OK\n");
+#endif
+
+	return 0;
+}
+
 static int bootm_load_os(bootm_headers_t *images, unsigned long *load_end,
 			 int boot_progress)
 {
@@ -434,15 +643,38 @@ static int bootm_load_os(bootm_headers_t *images, unsigned long *load_end,
 	ulong blob_end = os.end;
 	ulong image_start = os.image_start;
 	ulong image_len = os.image_len;
+	struct fit_verify_job *vj = NULL;
 	bool no_overlap;
 	void *load_buf, *image_buf;
 	int err;
 
+	/*
+	 * Work out the hashes while the kernel is decompressed, unless it
+	 * might be decompressed over the image
+	 */
+#if IMAGE_ENABLE_FIT
+	if (images->verify_os_later) {
+		if (load >= blob_end ||
+		    load + CONFIG_SYS_BOOTM_LEN <= blob_start)
+			vj = fit_image_verify_start(images->fit_hdr_os,
+						    images->fit_noffset_os);
+		if (!vj) {
+			err = bootm_os_verify(images, NULL);
+			if (err)
+				return err;
+		}
+	}
+#endif
+
+	/* A hash checked only afterwards does not spare the decompressor's */
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
 	err = bootm_decomp_image(os.comp, load, os.image_start, os.type,
 				 load_buf, image_buf, image_len,
-				 CONFIG_SYS_BOOTM_LEN, load_end);
+				 CONFIG_SYS_BOOTM_LEN,
+				 !vj && bootm_os_hashed(images), load_end);
+	if (vj && bootm_os_verify(images, vj))
+		return -EACCES;
 	if (err) {
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
 		return err;
@@ -860,6 +1092,8 @@ static const void *boot_get_kernel(cmd_tbl_t *cmdtp, int flag, int argc,
 #endif
 #if IMAGE_ENABLE_FIT
 	case IMAGE_FORMAT_FIT:
+		/* With other CPUs to help, leave hashes to bootm_load_os() */
+		images->verify_os_later = images->verify && job_workers() > 0;
 		os_noffset = fit_image_load(images, img_addr,
 				&fit_uname_kernel, &fit_uname_config,
 				IH_ARCH_DEFAULT, IH_TYPE_KERNEL,
@@ -934,7 +1168,7 @@ static int bootm_host_load_image(const void *fit, int req_image_type)
 	load_buf = malloc((1 << 20) + len * 4);
 	ret = bootm_decomp_image(imape_comp, 0, data, image_type, load_buf,
 				 (void *)data, len, CONFIG_SYS_BOOTM_LEN,
-				 &load_end);
+				 false, &load_end);
 	free(load_buf);
 
 	if (ret && ret != BOOTM_ERR_UNIMPLEMENTED)
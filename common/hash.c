@@ -25,6 +25,7 @@
 #endif /* !USE_HOSTCC*/
 
 #include <hash.h>
+#include <watchdog.h>
 #include <u-boot/crc.h>
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
@@ -107,7 +108,8 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* Big-endian, as crc32_wd_buf() gives it */
+	*((uint32_t *)dest_buf) = cpu_to_uimage(*((uint32_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -212,6 +214,76 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	return -EPROTONOSUPPORT;
 }
 
+void hash_multi_init(struct hash_multi *hm)
+{
+	hm->count = 0;
+}
+
+int hash_multi_add(struct hash_multi *hm, const char *algo_name)
+{
+	struct hash_algo *algo;
+	int ret;
+
+	ret = hash_progressive_lookup_algo(algo_name, &algo);
+	if (ret)
+		return ret;
+	if (hm->count == HASH_MULTI_MAX)
+		return -ENOSPC;
+	if (algo->hash_init(algo, &hm->ctx[hm->count]))
+		return -ENOMEM;
+	hm->algo[hm->count] = algo;
+
+	return hm->count++;
+}
+
+int hash_multi_update(struct hash_multi *hm, const void *buf,
+		      unsigned int size, int is_last)
+{
+	const char *p = buf;
+	unsigned int chunk;
+	int ret = 0, i;
+
+	/*
+	 * Give each piece to every algorithm in turn, so that only the first
+	 * reads it from memory and the others find it in the cache
+	 */
+	do {
+		chunk = size < HASH_MULTI_CHUNK ? size : HASH_MULTI_CHUNK;
+		for (i = 0; i < hm->count; i++) {
+			/* A failed update releases the context */
+			if (hm->ctx[i] &&
+			    hm->algo[i]->hash_update(hm->algo[i], hm->ctx[i],
+						     p, chunk,
+						     is_last && chunk == size))
+				hm->ctx[i] = NULL;
+			if (!hm->ctx[i])
+				ret = -EIO;
+		}
+		p += chunk;
+		size -= chunk;
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+		WATCHDOG_RESET();
+#endif
+	} while (size);
+
+	return ret;
+}
+
+int hash_multi_finish(struct hash_multi *hm,
+		      uint8_t output[][HASH_MAX_DIGEST_SIZE])
+{
+	int ret = 0, i;
+
+	for (i = 0; i < hm->count; i++) {
+		if (!hm->ctx[i] ||
+		    hm->algo[i]->hash_finish(hm->algo[i], hm->ctx[i], output[i],
+					     HASH_MAX_DIGEST_SIZE))
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
@@ -377,6 +449,47 @@ static void hash_show(struct hash_algo *algo, ulong addr, ulong len, uint8_t *ou
 		printf("%02x", output[i]);
 }
 
+/* Show the digests of several algorithms, from one pass over the data */
+static int hash_command_multi(const char *algo_names, int flags, ulong addr,
+			      ulong len, int argc)
+{
+	uint8_t output[HASH_MULTI_MAX][HASH_MAX_DIGEST_SIZE];
+	char names[64], *name, *p;
+	struct hash_multi hm;
+	void *buf;
+	int i, ret;
+
+	/* There is no single digest to verify or store */
+	if ((flags & HASH_FLAG_VERIFY) || argc)
+		return CMD_RET_USAGE;
+
+	strlcpy(names, algo_names, sizeof(names));
+	hash_multi_init(&hm);
+	for (p = names; (name = strsep(&p, ",")); ) {
+		ret = hash_multi_add(&hm, name);
+		if (ret < 0) {
+			hash_multi_finish(&hm, output);
+			printf("Cannot hash with '%s' (%d)\n", name, ret);
+			return CMD_RET_USAGE;
+		}
+	}
+
+	buf = map_sysmem(addr, len);
+	ret = hash_multi_update(&hm, buf, len, 1);
+	unmap_sysmem(buf);
+	if (hash_multi_finish(&hm, output) || ret) {
+		puts("Hashing failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < hm.count; i++) {
+		hash_show(hm.algo[i], addr, len, output[i]);
+		printf("\n");
+	}
+
+	return 0;
+}
+
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[])
 {
@@ -388,6 +501,10 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 	addr = simple_strtoul(*argv++, NULL, 16);
 	len = simple_strtoul(*argv++, NULL, 16);
 
+	if (multi_hash() && strchr(algo_name, ','))
+		return hash_command_multi(algo_name, flags, addr, len,
+					  argc - 2);
+
 	if (multi_hash()) {
 		struct hash_algo *algo;
 		uint8_t output[HASH_MAX_DIGEST_SIZE];
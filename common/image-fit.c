@@ -17,6 +17,7 @@
 #include <linux/kconfig.h>
 #include <common.h>
 #include <errno.h>
+#include <job.h>
 #include <mapmem.h>
 #include <asm/io.h>
 #include <malloc.h>
@@ -995,11 +996,15 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/*
+ * Check the hash in a hash node against @data, or against @value if the
+ * caller has already worked it out
+ */
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const uint8_t *value,
+				int value_len, char **err_msgp)
 {
-	uint8_t value[FIT_MAX_HASH_LEN];
-	int value_len;
+	uint8_t calc_value[FIT_MAX_HASH_LEN];
 	char *algo;
 	uint8_t *fit_value;
 	int fit_value_len;
@@ -1027,9 +1032,12 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
-		*err_msgp = "Unsupported hash algorithm";
-		return -1;
+	if (!value) {
+		if (calculate_hash(data, size, algo, calc_value, &value_len)) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		value = calc_value;
 	}
 
 	if (value_len != fit_value_len) {
@@ -1043,6 +1051,67 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
+/* Whether common/hash.c is there to work out several hashes in one pass */
+#if defined(USE_HOSTCC) || \
+	(!defined(CONFIG_SPL_BUILD) && defined(CONFIG_HASH)) || \
+	(defined(CONFIG_SPL_BUILD) && defined(CONFIG_SPL_HASH_SUPPORT))
+#define FIT_HASH_MULTI		1
+#else
+#define FIT_HASH_MULTI		0
+#endif
+
+#if FIT_HASH_MULTI
+/**
+ * fit_image_hash_multi - set up hashing for all hash nodes of an image
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @hm: multi-algorithm hash to set up
+ * @node: returns the hash node offset for each algorithm in @hm
+ *
+ * fit_image_hash_multi() adds the algorithm of every hash node that is not
+ * ignored to @hm, so that they can all be worked out in one pass over the
+ * image data.
+ *
+ * returns:
+ *     number of hash nodes that could not be added (no progressive support
+ *     or too many of them)
+ */
+static int fit_image_hash_multi(const void *fit, int image_noffset,
+				struct hash_multi *hm, int node[])
+{
+	int noffset, ignore, missed = 0;
+	char *algo;
+
+	hash_multi_init(hm);
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		if (strncmp(fit_get_name(fit, noffset, NULL),
+			    FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (fit_image_hash_get_algo(fit, noffset, &algo) ||
+		    hash_multi_add(hm, algo) < 0) {
+			missed++;
+			continue;
+		}
+		node[hm->count - 1] = noffset;
+	}
+
+	return missed;
+}
+#else
+static int fit_image_hash_multi(const void *fit, int image_noffset,
+				struct hash_multi *hm, int node[])
+{
+	hm->count = 0;
+
+	return 1;
+}
+#endif
+
 /**
  * fit_image_verify - verify data integrity
  * @fit: pointer to the FIT format image header
@@ -1063,7 +1132,10 @@ int fit_image_verify(const void *fit, int image_noffset)
 	int		noffset = 0;
 	char		*err_msg = "";
 	int verify_all = 1;
-	int ret;
+	struct hash_multi hm;
+	uint8_t digest[HASH_MULTI_MAX][HASH_MAX_DIGEST_SIZE];
+	int hash_node[HASH_MULTI_MAX];
+	int ret, i;
 
 	/* Get image data and data length */
 	if (fit_image_get_data(fit, image_noffset, &data, &size)) {
@@ -1079,6 +1151,20 @@ int fit_image_verify(const void *fit, int image_noffset)
 		goto error;
 	}
 
+	/*
+	 * With several hash nodes, work out their hashes in a single pass
+	 * over the data. Those that cannot be are done one by one below.
+	 */
+	fit_image_hash_multi(fit, image_noffset, &hm, hash_node);
+	if (FIT_HASH_MULTI && hm.count > 1) {
+		ret = hash_multi_update(&hm, data, size, 1);
+		if (hash_multi_finish(&hm, digest) || ret)
+			hm.count = 0;
+	} else if (FIT_HASH_MULTI && hm.count) {
+		hash_multi_finish(&hm, digest);
+		hm.count = 0;
+	}
+
 	/* Process all hash subnodes of the component image node */
 	fdt_for_each_subnode(noffset, fit, image_noffset) {
 		const char *name = fit_get_name(fit, noffset, NULL);
@@ -1090,7 +1176,13 @@ int fit_image_verify(const void *fit, int image_noffset)
 		 */
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
+			for (i = 0; i < hm.count; i++)
+				if (hash_node[i] == noffset)
+					break;
 			if (fit_image_check_hash(fit, noffset, data, size,
+						 i < hm.count ? digest[i] : NULL,
+						 i < hm.count ?
+						 hm.algo[i]->digest_size : 0,
 						 &err_msg))
 				goto error;
 			puts("+ ");
@@ -1127,6 +1219,298 @@ error:
 	return 0;
 }
 
+#if !defined(USE_HOSTCC) && FIT_HASH_MULTI && \
+	!defined(CONFIG_FIT_IMAGE_POST_PROCESS)
+/**
+ * fit_image_can_copy_verify - check if hashes can be checked while copying
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @dst: where the image data is to be copied, or NULL if it is not
+ *
+ * This is so when every hash node uses an algorithm with progressive
+ * support, there are no signatures to check and the copy can be done
+ * front to back. The same goes for working out the hashes on a job with
+ * fit_image_verify_start().
+ *
+ * returns:
+ *     1, if fit_image_copy_verify() can be used
+ *     0, otherwise
+ */
+static int fit_image_can_copy_verify(const void *fit, int image_noffset,
+				     const void *dst)
+{
+	const void *sig_blob = gd_fdt_blob();
+	struct hash_algo *algo;
+	const char *required, *node_name;
+	const void *data;
+	size_t size;
+	char *name;
+	int noffset, sig_node, count = 0;
+
+	if (fit_image_get_data(fit, image_noffset, &data, &size) ||
+	    (dst > data && dst < data + size))
+		return 0;
+
+	/* Keys that must sign every image need the data in one piece */
+	if (IMAGE_ENABLE_VERIFY && sig_blob) {
+		sig_node = fdt_subnode_offset(sig_blob, 0, FIT_SIG_NODENAME);
+		fdt_for_each_subnode(noffset, sig_blob, sig_node) {
+			required = fdt_getprop(sig_blob, noffset, "required",
+					       NULL);
+			if (required && !strcmp(required, "image"))
+				return 0;
+		}
+	}
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		node_name = fit_get_name(fit, noffset, NULL);
+		if (IMAGE_ENABLE_VERIFY && !strncmp(node_name, FIT_SIG_NODENAME,
+						    strlen(FIT_SIG_NODENAME)))
+			return 0;
+		if (strncmp(node_name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &name) ||
+		    hash_progressive_lookup_algo(name, &algo) ||
+		    ++count > HASH_MULTI_MAX)
+			return 0;
+	}
+
+	return count > 0;
+}
+
+/**
+ * fit_config_can_verify_later - check if hashes may be checked during use
+ * @fit: pointer to the FIT format image header
+ * @cfg_noffset: configuration node offset, or -1 if no configuration is used
+ *
+ * Checking an image's hashes while it is used, e.g. decompressed, puts the
+ * data through the user before a bad hash is found. That is only allowed
+ * when nothing is signed: a signed FIT must be checked before anything
+ * parses its data.
+ *
+ * returns:
+ *     1, if the hashes may be checked after the image is used
+ *     0, otherwise
+ */
+static int fit_config_can_verify_later(const void *fit, int cfg_noffset)
+{
+	const void *sig_blob = gd_fdt_blob();
+	int noffset, sig_node;
+
+	if (!IMAGE_ENABLE_VERIFY)
+		return 1;
+
+	if (sig_blob) {
+		sig_node = fdt_subnode_offset(sig_blob, 0, FIT_SIG_NODENAME);
+		fdt_for_each_subnode(noffset, sig_blob, sig_node) {
+			if (fdt_getprop(sig_blob, noffset, "required", NULL))
+				return 0;
+		}
+	}
+
+	if (cfg_noffset < 0)
+		return 1;
+	fdt_for_each_subnode(noffset, fit, cfg_noffset) {
+		if (!strncmp(fit_get_name(fit, noffset, NULL),
+			     FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * fit_image_check_multi - check an image's hashes against worked-out digests
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @hm: multi-algorithm hash set up by fit_image_hash_multi()
+ * @hash_node: hash node offsets from fit_image_hash_multi()
+ * @ret: result of the last hash_multi_update()
+ *
+ * Finishes @hm and compares each digest with the value in its hash node,
+ * printing progress and errors like fit_image_verify().
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+static int fit_image_check_multi(const void *fit, int image_noffset,
+				 struct hash_multi *hm, const int *hash_node,
+				 int ret)
+{
+	uint8_t digest[HASH_MULTI_MAX][HASH_MAX_DIGEST_SIZE];
+	char *err_msg;
+	int noffset = 0, i;
+
+	if (hash_multi_finish(hm, digest) || ret) {
+		err_msg = "Unable to calculate hash";
+		goto error;
+	}
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		if (strncmp(fit_get_name(fit, noffset, NULL),
+			    FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		for (i = 0; i < hm->count; i++)
+			if (hash_node[i] == noffset)
+				break;
+		if (i == hm->count) {
+			/* Only an ignored node is left out */
+			fit_image_check_hash(fit, noffset, NULL, 0, NULL, 0,
+					     &err_msg);
+			continue;
+		}
+		if (fit_image_check_hash(fit, noffset, NULL, 0, digest[i],
+					 hm->algo[i]->digest_size, &err_msg))
+			goto error;
+		puts("+ ");
+	}
+
+	return 1;
+
+error:
+	printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+	       err_msg, fit_get_name(fit, noffset, NULL),
+	       fit_get_name(fit, image_noffset, NULL));
+	return 0;
+}
+
+/**
+ * fit_image_copy_verify - copy image data, checking its hashes on the way
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @dst: where to copy the image data
+ *
+ * Like fit_image_verify() followed by a memmove() of the data to @dst, but
+ * each piece of the data is hashed just before it is copied, so it is only
+ * brought through the cache once. Only valid if fit_image_can_copy_verify()
+ * says so.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+static int fit_image_copy_verify(const void *fit, int image_noffset,
+				 void *dst)
+{
+	struct hash_multi hm;
+	int hash_node[HASH_MULTI_MAX];
+	const char *src;
+	size_t size, done, chunk;
+	int ret;
+
+	if (fit_image_get_data(fit, image_noffset, (const void **)&src,
+			       &size)) {
+		printf(" error!\nCan't get image data/size for '%s' image node\n",
+		       fit_get_name(fit, image_noffset, NULL));
+		return 0;
+	}
+
+	ret = fit_image_hash_multi(fit, image_noffset, &hm, hash_node);
+	for (done = 0; !ret && done < size; done += chunk) {
+		chunk = min(size - done, (size_t)HASH_MULTI_CHUNK);
+		ret = hash_multi_update(&hm, src + done, chunk,
+					done + chunk == size);
+		memmove(dst + done, src + done, chunk);
+	}
+
+	return fit_image_check_multi(fit, image_noffset, &hm, hash_node, ret);
+}
+
+/**
+ * struct fit_verify_job - Hashes of an image being worked out on a job
+ *
+ * @job:	The job
+ * @fit:	Pointer to the FIT format image header
+ * @image_noffset: Component image node offset
+ * @data:	Image data
+ * @size:	Size of the image data
+ * @hm:		Its hashes
+ * @hash_node:	Hash node offset for each algorithm in @hm
+ */
+struct fit_verify_job {
+	struct job job;
+	const void *fit;
+	int image_noffset;
+	const void *data;
+	size_t size;
+	struct hash_multi hm;
+	int hash_node[HASH_MULTI_MAX];
+};
+
+static int fit_verify_job_hash(void *arg)
+{
+	struct fit_verify_job *vj = arg;
+
+	return hash_multi_update(&vj->hm, vj->data, vj->size, 1);
+}
+
+struct fit_verify_job *fit_image_verify_start(const void *fit,
+					      int image_noffset)
+{
+	struct fit_verify_job *vj;
+	uint8_t digest[HASH_MULTI_MAX][HASH_MAX_DIGEST_SIZE];
+
+	if (!fit_image_can_copy_verify(fit, image_noffset, NULL))
+		return NULL;
+	vj = malloc(sizeof(*vj));
+	if (!vj)
+		return NULL;
+	vj->fit = fit;
+	vj->image_noffset = image_noffset;
+	if (fit_image_get_data(fit, image_noffset, &vj->data, &vj->size) ||
+	    fit_image_hash_multi(fit, image_noffset, &vj->hm, vj->hash_node)) {
+		hash_multi_finish(&vj->hm, digest);
+		free(vj);
+		return NULL;
+	}
+	job_submit(&vj->job, fit_verify_job_hash, vj);
+
+	return vj;
+}
+
+int fit_image_verify_finish(struct fit_verify_job *vj)
+{
+	int ret;
+
+	ret = job_wait(&vj->job);
+	ret = fit_image_check_multi(vj->fit, vj->image_noffset, &vj->hm,
+				    vj->hash_node, ret);
+	free(vj);
+
+	return ret;
+}
+#else
+static int fit_image_can_copy_verify(const void *fit, int image_noffset,
+				     const void *dst)
+{
+	return 0;
+}
+
+static int fit_config_can_verify_later(const void *fit, int cfg_noffset)
+{
+	return 0;
+}
+
+static int fit_image_copy_verify(const void *fit, int image_noffset,
+				 void *dst)
+{
+	return 0;
+}
+
+struct fit_verify_job *fit_image_verify_start(const void *fit,
+					      int image_noffset)
+{
+	return NULL;
+}
+
+int fit_image_verify_finish(struct fit_verify_job *vj)
+{
+	return 0;
+}
+#endif
+
 /**
  * fit_all_image_verify - verify data integrity for all images
  * @fit: pointer to the FIT format image header
@@ -1682,14 +2066,14 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp)
 {
-	int cfg_noffset, noffset;
+	int cfg_noffset = -1, noffset;
 	const char *fit_uname;
 	const char *fit_uname_config;
 	const char *fit_base_uname_config;
 	const void *fit;
 	const void *buf;
 	size_t size;
-	int type_ok, os_ok;
+	int type_ok, os_ok, copy_verify, defer_verify;
 	ulong load, data, len;
 	uint8_t os;
 #ifndef USE_HOSTCC
@@ -1765,7 +2149,30 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/*
+	 * If the image is copied to its load address, check its hashes while
+	 * copying it rather than in a pass of their own
+	 */
+	copy_verify = images->verify && load_op != FIT_LOAD_IGNORED &&
+		      !fit_image_get_load(fit, noffset, &load) &&
+		      (load_op != FIT_LOAD_OPTIONAL_NON_ZERO || load) &&
+		      fit_image_can_copy_verify(fit, noffset,
+						map_sysmem(load, 0));
+
+	/*
+	 * A compressed kernel is only used once bootm decompresses it, so
+	 * the hashes of an unsigned one can be checked on another CPU while
+	 * that happens (see bootm_load_os())
+	 */
+	if (load_op == FIT_LOAD_IGNORED && images->verify_os_later)
+		images->verify_os_later =
+			!fit_image_check_comp(fit, noffset, IH_COMP_NONE) &&
+			fit_config_can_verify_later(fit, cfg_noffset) &&
+			fit_image_can_copy_verify(fit, noffset, NULL);
+	defer_verify = load_op == FIT_LOAD_IGNORED && images->verify_os_later;
+
+	ret = fit_image_select(fit, noffset,
+			       images->verify && !copy_verify && !defer_verify);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -1885,7 +2292,18 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		       prop_name, data, load);
 
 		dst = map_sysmem(load, len);
-		memmove(dst, buf, len);
+		if (copy_verify) {
+			puts("   Verifying Hash Integrity ... ");
+			if (!fit_image_copy_verify(fit, noffset, dst)) {
+				puts("Bad Data Hash\n");
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return -EACCES;
+			}
+			puts("OK\n");
+		} else {
+			memmove(dst, buf, len);
+		}
 		data = load;
 	}
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_LOAD);
@@ -8,6 +8,7 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <fs.h>
 #include <ide.h>
 #include <malloc.h>
 #include <part.h>
@@ -222,6 +223,8 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	fs_invalidate(dev_desc->if_type, dev_desc->devnum);
+	dev_desc->part_gen++;
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -298,13 +301,118 @@ void part_print(struct blk_desc *dev_desc)
 		drv->print(dev_desc);
 }
 
+/*
+ * The decoded partition table of a device, so that partitions can be looked
+ * up without reading and checking the table each time. It is rebuilt once
+ * dev_desc->part_gen moves on, which happens when the device is rescanned
+ * (part_init()) or written to. Only tables whose driver can decode them in
+ * one pass (get_info_all()) are cached.
+ */
+#define PART_CACHE_HASH_SIZE	64
+
+struct part_cache_entry {
+	disk_partition_t info;
+	bool valid;
+	int next;		/* next entry with the same name hash, or -1 */
+};
+
+struct part_cache {
+	unsigned int gen;	/* dev_desc->part_gen when it was read */
+	int part_type;
+	int hwpart;
+	int count;
+	int hash[PART_CACHE_HASH_SIZE];	/* first entry by name hash, or -1 */
+	struct part_cache_entry entry[0];	/* entry[i] is partition i + 1 */
+};
+
+static unsigned int part_name_hash(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + (unsigned char)*name++;
+
+	return hash % PART_CACHE_HASH_SIZE;
+}
+
+/* Read the whole partition table into a new cache, or return NULL */
+static struct part_cache *part_cache_read(struct blk_desc *dev_desc,
+					  struct part_driver *drv)
+{
+	disk_partition_t *info;
+	struct part_cache *cache;
+	int count = drv->max_entries;
+	int i, h;
+
+	cache = calloc(1, sizeof(*cache) + count * sizeof(cache->entry[0]));
+	info = calloc(count, sizeof(*info));
+	if (!cache || !info)
+		goto err;
+
+	if (drv->get_info_all(dev_desc, info, count))
+		goto err;
+	for (i = 0; i < count; i++)
+		cache->entry[i].valid = info[i].blksz != 0;
+
+	for (h = 0; h < PART_CACHE_HASH_SIZE; h++)
+		cache->hash[h] = -1;
+	for (i = count - 1; i >= 0; i--) {
+		cache->entry[i].info = info[i];
+		cache->entry[i].next = -1;
+		if (!cache->entry[i].valid)
+			continue;
+		h = part_name_hash((const char *)info[i].name);
+		cache->entry[i].next = cache->hash[h];
+		cache->hash[h] = i;
+	}
+	cache->gen = dev_desc->part_gen;
+	cache->part_type = dev_desc->part_type;
+	cache->hwpart = dev_desc->hwpart;
+	cache->count = count;
+	free(info);
+
+	return cache;
+err:
+	free(info);
+	free(cache);
+	return NULL;
+}
+
+/*
+ * Get the cached partition table of a device, reading it if needed. Returns
+ * NULL if there is none, so the caller must use drv->get_info() instead.
+ */
+static struct part_cache *part_cache_get(struct blk_desc *dev_desc,
+					 struct part_driver *drv)
+{
+	struct part_cache *cache = dev_desc->part_cache;
+
+	if (!drv->get_info_all)
+		return NULL;
+	if (cache && cache->gen == dev_desc->part_gen &&
+	    cache->part_type == dev_desc->part_type &&
+	    cache->hwpart == dev_desc->hwpart)
+		return cache;
+
+	part_cache_free(dev_desc);
+	dev_desc->part_cache = part_cache_read(dev_desc, drv);
+
+	return dev_desc->part_cache;
+}
 #endif /* HAVE_BLOCK_DEVICE */
 
+void part_cache_free(struct blk_desc *dev_desc)
+{
+	free(dev_desc->part_cache);
+	dev_desc->part_cache = NULL;
+}
+
 int part_get_info(struct blk_desc *dev_desc, int part,
 		       disk_partition_t *info)
 {
 #ifdef HAVE_BLOCK_DEVICE
 	struct part_driver *drv;
+	struct part_cache *cache;
 
 #if CONFIG_IS_ENABLED(PARTITION_UUIDS)
 	/* The common case is no UUID support */
@@ -325,6 +433,14 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 		       drv->name);
 		return -ENOSYS;
 	}
+	cache = part >= 1 ? part_cache_get(dev_desc, drv) : NULL;
+	if (cache && part <= cache->count) {
+		if (!cache->entry[part - 1].valid)
+			return -1;
+		*info = cache->entry[part - 1].info;
+		PRINTF("## Valid %s partition found ##\n", drv->name);
+		return 0;
+	}
 	if (drv->get_info(dev_desc, part, info) == 0) {
 		PRINTF("## Valid %s partition found ##\n", drv->name);
 		return 0;
@@ -636,10 +752,30 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 		ll_entry_start(struct part_driver, part_driver);
 	const int n_drvs = ll_entry_count(struct part_driver, part_driver);
 	struct part_driver *part_drv;
+	struct part_cache *cache;
 
 	for (part_drv = first_drv; part_drv != first_drv + n_drvs; part_drv++) {
 		int ret;
 		int i;
+
+		if (part_type >= 0 && part_type != part_drv->part_type)
+			continue;
+		/* The table of the device itself is looked up by name hash */
+		cache = NULL;
+		if (part_drv->part_type == dev_desc->part_type)
+			cache = part_cache_get(dev_desc, part_drv);
+		if (cache) {
+			i = cache->hash[part_name_hash(name)];
+			for (; i >= 0; i = cache->entry[i].next) {
+				if (strcmp(name,
+					   (char *)cache->entry[i].info.name))
+					continue;
+				*info = cache->entry[i].info;
+				return i + 1;
+			}
+			continue;
+		}
+
 		for (i = 1; i < part_drv->max_entries; i++) {
 			if (part_type >= 0 && part_type != part_drv->part_type)
 				break;
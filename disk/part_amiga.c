@@ -288,17 +288,13 @@ static struct partition_block *find_partition(struct blk_desc *dev_desc,
 }
 
 /*
- * Get info about a partition
+ * Fill in info from a partition block
  */
-static int part_get_info_amiga(struct blk_desc *dev_desc, int part,
-				    disk_partition_t *info)
+static void set_part_info(struct partition_block *p, disk_partition_t *info)
 {
-    struct partition_block *p = find_partition(dev_desc, part-1);
     struct amiga_part_geometry *g;
     u32 disk_type;
 
-    if (!p) return -1;
-
     g = (struct amiga_part_geometry *)&(p->environment);
     info->start = g->low_cyl  * g->block_per_track * g->surfaces;
     info->size  = (g->high_cyl - g->low_cyl + 1) * g->block_per_track * g->surfaces - 1;
@@ -314,6 +310,49 @@ static int part_get_info_amiga(struct blk_desc *dev_desc, int part,
     info->type[3] = '\\';
     info->type[4] = (disk_type & 0x000000FF) + '0';
     info->type[5] = 0;
+}
+
+/*
+ * Get info about a partition
+ */
+static int part_get_info_amiga(struct blk_desc *dev_desc, int part,
+				    disk_partition_t *info)
+{
+    struct partition_block *p = find_partition(dev_desc, part-1);
+
+    if (!p) return -1;
+
+    set_part_info(p, info);
+
+    return 0;
+}
+
+/*
+ * Get info about all partitions, walking the partition list once
+ */
+static int part_get_info_all_amiga(struct blk_desc *dev_desc,
+				   disk_partition_t *info, int count)
+{
+    struct partition_block *p;
+    u32 block;
+    int i;
+
+    if (!get_rdisk(dev_desc))
+	return -1;
+
+    memset(info, 0, count * sizeof(*info));
+    block = rdb.partition_list;
+    for (i = 0; i < count && block != 0xFFFFFFFF; i++)
+    {
+	if (blk_dread(dev_desc, block, 1, (ulong *)block_buffer) != 1)
+	    break;
+	p = (struct partition_block *)block_buffer;
+	if (p->id != AMIGA_ID_PART || sum_block((struct block_header *)p) != 0)
+	    break;
+
+	set_part_info(p, &info[i]);
+	block = p->next;
+    }
 
     return 0;
 }
@@ -383,6 +422,7 @@ U_BOOT_PART_TYPE(amiga) = {
 	.part_type	= PART_TYPE_AMIGA,
 	.max_entries	= AMIGA_ENTRY_NUMBERS,
 	.get_info	= part_get_info_amiga,
+	.get_info_all	= part_get_info_all_amiga,
 	.print		= part_print_amiga,
 	.test		= part_test_amiga,
 };
@@ -180,6 +180,38 @@ static void print_partition_extended(struct blk_desc *dev_desc,
 }
 
 
+/* Fill in @info for the table entry @pt, numbered @part_num */
+static void part_set_info(struct blk_desc *dev_desc, dos_partition_t *pt,
+			  lbaint_t ext_part_sector, int part_num,
+			  disk_partition_t *info, unsigned int disksig)
+{
+	info->blksz = DOS_PART_DEFAULT_SECTOR;
+	info->start = (lbaint_t)(ext_part_sector + le32_to_int(pt->start4));
+	info->size  = (lbaint_t)le32_to_int(pt->size4);
+	part_set_generic_name(dev_desc, part_num, (char *)info->name);
+	/* sprintf(info->type, "%d, pt->sys_ind); */
+	strcpy((char *)info->type, "U-Boot");
+	info->bootable = is_bootable(pt);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	sprintf(info->uuid, "%08x-%02x", disksig, part_num);
+#endif
+	info->sys_ind = pt->sys_ind;
+}
+
+/* Fill in @info for a disk with a DOS boot sector but no partitions */
+static void part_set_info_pbr(struct blk_desc *dev_desc,
+			      disk_partition_t *info)
+{
+	info->start = 0;
+	info->size = dev_desc->lba;
+	info->blksz = DOS_PART_DEFAULT_SECTOR;
+	info->bootable = 0;
+	strcpy((char *)info->type, "U-Boot");
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	info->uuid[0] = 0;
+#endif
+}
+
 /*  Print a partition that is relative to its Extended partition table
  */
 static int part_get_info_extended(struct blk_desc *dev_desc,
@@ -221,19 +253,8 @@ static int part_get_info_extended(struct blk_desc *dev_desc,
 		    (pt->sys_ind != 0) &&
 		    (part_num == which_part) &&
 		    (ext_part_sector == 0 || is_extended(pt->sys_ind) == 0)) {
-			info->blksz = DOS_PART_DEFAULT_SECTOR;
-			info->start = (lbaint_t)(ext_part_sector +
-					le32_to_int(pt->start4));
-			info->size  = (lbaint_t)le32_to_int(pt->size4);
-			part_set_generic_name(dev_desc, part_num,
-					      (char *)info->name);
-			/* sprintf(info->type, "%d, pt->sys_ind); */
-			strcpy((char *)info->type, "U-Boot");
-			info->bootable = is_bootable(pt);
-#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
-			sprintf(info->uuid, "%08x-%02x", disksig, part_num);
-#endif
-			info->sys_ind = pt->sys_ind;
+			part_set_info(dev_desc, pt, ext_part_sector, part_num,
+				      info, disksig);
 			return 0;
 		}
 
@@ -261,20 +282,84 @@ static int part_get_info_extended(struct blk_desc *dev_desc,
 	dos_type = test_block_type(buffer);
 
 	if (dos_type == DOS_PBR) {
-		info->start = 0;
-		info->size = dev_desc->lba;
-		info->blksz = DOS_PART_DEFAULT_SECTOR;
-		info->bootable = 0;
-		strcpy((char *)info->type, "U-Boot");
-#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
-		info->uuid[0] = 0;
-#endif
+		part_set_info_pbr(dev_desc, info);
 		return 0;
 	}
 
 	return -1;
 }
 
+/*
+ * Decode the whole table for the partition cache, following the chain of
+ * extended partition tables once. Partitions are numbered as
+ * part_get_info_extended() numbers them.
+ */
+static int part_get_info_all_dos(struct blk_desc *dev_desc,
+				 disk_partition_t *info, int count)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
+	lbaint_t ext_part_sector = 0, relative = 0, lba_start;
+	unsigned int disksig = 0;
+	dos_partition_t *pt;
+	int i, part_num = 1;
+
+	memset(info, '\0', count * sizeof(*info));
+	for (;;) {
+		if (blk_dread(dev_desc, ext_part_sector, 1,
+			      (ulong *)buffer) != 1) {
+			printf("** Can't read partition table on %d:" LBAFU
+			       " **\n", dev_desc->devnum, ext_part_sector);
+			return ext_part_sector ? 0 : -1;
+		}
+		if (buffer[DOS_PART_MAGIC_OFFSET] != 0x55 ||
+		    buffer[DOS_PART_MAGIC_OFFSET + 1] != 0xaa) {
+			printf("bad MBR sector signature 0x%02x%02x\n",
+			       buffer[DOS_PART_MAGIC_OFFSET],
+			       buffer[DOS_PART_MAGIC_OFFSET + 1]);
+			return ext_part_sector ? 0 : -1;
+		}
+
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+		if (!ext_part_sector)
+			disksig = le32_to_int(&buffer[DOS_PART_DISKSIG_OFFSET]);
+#endif
+
+		pt = (dos_partition_t *)(buffer + DOS_PART_TBL_OFFSET);
+		for (i = 0; i < 4; i++, pt++) {
+			if (((pt->boot_ind & ~0x80) == 0) &&
+			    (pt->sys_ind != 0) && part_num <= count &&
+			    (ext_part_sector == 0 || !is_extended(pt->sys_ind)))
+				part_set_info(dev_desc, pt, ext_part_sector,
+					      part_num, &info[part_num - 1],
+					      disksig);
+			if ((ext_part_sector == 0) ||
+			    (pt->sys_ind != 0 && !is_extended(pt->sys_ind)))
+				part_num++;
+		}
+
+		/* Follow the first extended partition, if any */
+		pt = (dos_partition_t *)(buffer + DOS_PART_TBL_OFFSET);
+		for (i = 0; i < 4 && !is_extended(pt->sys_ind); i++)
+			pt++;
+		if (i == 4 || part_num > count)
+			break;
+		lba_start = le32_to_int(pt->start4) + relative;
+		if (!ext_part_sector)
+			relative = lba_start;
+		ext_part_sector = lba_start;
+	}
+
+	/* Numbers left over are the whole disk if it has a DOS boot sector */
+	if (i == 4 && test_block_type(buffer) == DOS_PBR) {
+		for (i = 0; i < count; i++) {
+			if (!info[i].blksz)
+				part_set_info_pbr(dev_desc, &info[i]);
+		}
+	}
+
+	return 0;
+}
+
 void part_print_dos(struct blk_desc *dev_desc)
 {
 	printf("Part\tStart Sector\tNum Sectors\tUUID\t\tType\n");
@@ -312,6 +397,7 @@ U_BOOT_PART_TYPE(dos) = {
 	.part_type	= PART_TYPE_DOS,
 	.max_entries	= DOS_ENTRY_NUMBERS,
 	.get_info	= part_get_info_ptr(part_get_info_dos),
+	.get_info_all	= part_get_info_ptr(part_get_info_all_dos),
 	.print		= part_print_ptr(part_print_dos),
 	.test		= part_test_dos,
 };
@@ -238,11 +238,49 @@ static int part_get_info_mac(struct blk_desc *dev_desc, int part,
 	return (0);
 }
 
+/*
+ * Decode the whole partition map for the partition cache, reading each
+ * block once and quietly leaving entries past the end of the map unused
+ */
+static int part_get_info_all_mac(struct blk_desc *dev_desc,
+				 disk_partition_t *info, int count)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(mac_driver_desc_t, ddesc, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(mac_partition_t, mpart, 1);
+	int i, n = 1;
+
+	if (part_mac_read_ddb(dev_desc, ddesc))
+		return -1;
+
+	memset(info, '\0', count * sizeof(*info));
+	for (i = 1; i <= n && i <= count; i++) {
+		if (blk_dread(dev_desc, i, 1, (ulong *)mpart) != 1 ||
+		    mpart->signature != MAC_PARTITION_MAGIC) {
+			/* Without the first block there is no map at all */
+			if (i == 1)
+				return -1;
+			continue;
+		}
+		/* As part_mac_read_pdb(), trust the first block's count */
+		if (i == 1)
+			n = mpart->map_count;
+
+		info[i - 1].blksz = ddesc->blk_size;
+		info[i - 1].start = mpart->start_block;
+		info[i - 1].size = mpart->block_count;
+		memcpy(info[i - 1].type, mpart->type, sizeof(info->type));
+		memcpy(info[i - 1].name, mpart->name, sizeof(info->name));
+	}
+
+	return 0;
+}
+
 U_BOOT_PART_TYPE(mac) = {
 	.name		= "MAC",
 	.part_type	= PART_TYPE_MAC,
 	.max_entries	= MAC_ENTRY_NUMBERS,
 	.get_info	= part_get_info_mac,
+	.get_info_all	= part_get_info_all_mac,
 	.print		= part_print_mac,
 	.test		= part_test_mac,
 };
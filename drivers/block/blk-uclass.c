@@ -8,6 +8,9 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 
@@ -401,11 +404,47 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/*
+ * Read blocks along with the @ahead blocks following them in a single
+ * transfer, and leave the latter in the block cache.
+ * Return the number of blocks read into @buffer, 0 on failure.
+ */
+static ulong blk_dread_ahead(struct blk_desc *block_dev, lbaint_t start,
+			     lbaint_t blkcnt, lbaint_t ahead, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	unsigned long blksz = block_dev->blksz;
+	ulong blks_read;
+	char *buf;
+
+	buf = malloc_cache_aligned((blkcnt + ahead) * blksz);
+	if (!buf)
+		return 0;
+
+	blks_read = ops->read(dev, start, blkcnt + ahead, buf);
+	if (blks_read == blkcnt + ahead) {
+		memcpy(buffer, buf, blkcnt * blksz);
+		blkcache_fill(block_dev->if_type, block_dev->devnum,
+			      start, blkcnt, blksz, buf);
+		blkcache_fill_ahead(block_dev->if_type, block_dev->devnum,
+				    start + blkcnt, ahead, blksz,
+				    buf + blkcnt * blksz);
+		blks_read = blkcnt;
+	} else {
+		blks_read = 0;
+	}
+	free(buf);
+
+	return blks_read;
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t ahead;
 	ulong blks_read;
 
 	if (!ops->read)
@@ -414,6 +453,17 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+
+	ahead = blkcache_readahead(block_dev->if_type, block_dev->devnum,
+				   start, blkcnt);
+	if (start + blkcnt >= block_dev->lba)
+		ahead = 0;
+	else if (ahead > block_dev->lba - start - blkcnt)
+		ahead = block_dev->lba - start - blkcnt;
+	if (ahead && blk_dread_ahead(block_dev, start, blkcnt, ahead,
+				     buffer) == blkcnt)
+		return blkcnt;
+
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
@@ -432,6 +482,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->part_gen++;
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -445,6 +497,8 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->part_gen++;
 	return ops->erase(dev, start, blkcnt);
 }
 
@@ -621,8 +675,21 @@ int blk_unbind_all(int if_type)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	/* The descriptor goes with the device */
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	fs_invalidate(desc->if_type, desc->devnum);
+	part_cache_free(desc);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_remove	= blk_pre_remove,
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
 };
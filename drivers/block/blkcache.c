@@ -7,91 +7,218 @@
  */
 #include <config.h>
 #include <common.h>
+#include <errno.h>
 #include <malloc.h>
 #include <part.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
 
+/*
+ * The cache is split into one shard per device, each with its own hash
+ * index and list of entries. Entries hold at most max_blocks_per_entry
+ * blocks and are hashed on start / max_blocks_per_entry, so the entry
+ * covering a block is in the chain of that block or of the one before it.
+ * When the cache is full, the least recently used entry of any device is
+ * recycled.
+ */
+#define BLKCACHE_HASH_BITS	6
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
+/* Reads in a row that make an access pattern sequential */
+#define BLKCACHE_SEQ_READS	2
+
+struct block_cache_dev;
+
 struct block_cache_node {
-	struct list_head lh;
-	int iftype;
-	int devnum;
+	struct list_head lh;		/* in the device's LRU list */
+	struct list_head glh;		/* in block_cache_lru */
+	struct hlist_node hn;		/* in its hash chain */
+	struct block_cache_dev *bdev;
 	lbaint_t start;
 	lbaint_t blkcnt;
 	unsigned long blksz;
+	unsigned fill;			/* fill which made the entry */
+	bool prefetched;		/* read ahead and not used yet */
 	char *cache;
 };
 
-static LIST_HEAD(block_cache);
+struct block_cache_dev {
+	struct list_head lh;		/* in block_cache_devs */
+	int iftype;
+	int devnum;
+	struct list_head lru;		/* most recently used first */
+	struct hlist_head hash[BLKCACHE_HASH_SIZE];
+	lbaint_t next;			/* block following the last read */
+	unsigned seq;			/* sequential reads in a row */
+	struct block_cache_dev_stats stats;
+};
+
+static LIST_HEAD(block_cache_devs);
+/* Entries of all devices, most recently used first */
+static LIST_HEAD(block_cache_lru);
+/* Number of the current fill, whose entries are not recycled */
+static unsigned cache_fill_id;
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 2,
-	.max_entries = 32
+	.max_entries = 32,
+	.max_prefetch = 8,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
+static inline struct hlist_head *cache_chain(struct block_cache_dev *bd,
+					     lbaint_t key)
+{
+	return &bd->hash[((u32)key * 0x9e3779b9) >> (32 - BLKCACHE_HASH_BITS)];
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum, bool create)
+{
+	struct block_cache_dev *bd;
+	int i;
+
+	list_for_each_entry(bd, &block_cache_devs, lh)
+		if (bd->iftype == iftype && bd->devnum == devnum)
+			return bd;
+
+	if (!create)
+		return NULL;
+
+	bd = calloc(1, sizeof(*bd));
+	if (!bd)
+		return NULL;
+	bd->iftype = iftype;
+	bd->devnum = devnum;
+	bd->stats.iftype = iftype;
+	bd->stats.devnum = devnum;
+	INIT_LIST_HEAD(&bd->lru);
+	for (i = 0; i < BLKCACHE_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&bd->hash[i]);
+	list_add_tail(&bd->lh, &block_cache_devs);
+
+	return bd;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *bd,
 					   lbaint_t start, lbaint_t blkcnt,
 					   unsigned long blksz)
 {
 	struct block_cache_node *node;
+	struct hlist_node *pos;
+	lbaint_t key = start / _stats.max_blocks_per_entry;
+	int i;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
+	for (i = 0; i < 2 && i <= key; i++) {
+		hlist_for_each_entry(node, pos, cache_chain(bd, key - i), hn)
+			if ((node->blksz == blksz) &&
+			    (node->start <= start) &&
+			    (node->start + node->blkcnt >= start + blkcnt)) {
 				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+				list_move(&node->lh, &bd->lru);
+				list_move(&node->glh, &block_cache_lru);
+				return node;
 			}
-			return node;
-		}
+	}
 	return 0;
 }
 
+static void cache_drop(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	list_del(&node->glh);
+	hlist_del(&node->hn);
+	node->bdev->stats.entries--;
+	_stats.entries--;
+}
+
+/* Pick the entry to recycle: the LRU one not made by the current fill */
+static struct block_cache_node *cache_victim(void)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry_reverse(node, &block_cache_lru, glh)
+		if (node->fill != cache_fill_id)
+			return node;
+
+	return NULL;
+}
+
+static void cache_reset_stats(struct block_cache_dev *bd)
+{
+	bd->stats.hits = 0;
+	bd->stats.misses = 0;
+	bd->stats.prefetched = 0;
+	bd->stats.prefetch_used = 0;
+}
+
+static void cache_flush(struct block_cache_dev *bd)
+{
+	struct block_cache_node *node, *n;
+
+	list_for_each_entry_safe(node, n, &bd->lru, lh) {
+		cache_drop(node);
+		free(node->cache);
+		free(node);
+	}
+	bd->seq = 0;
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
+	struct block_cache_dev *bd;
+	struct block_cache_node *node;
+
+	if (_stats.max_entries == 0 || _stats.max_blocks_per_entry == 0)
+		return 0;
+
+	bd = cache_dev(iftype, devnum, true);
+	if (!bd)
+		return 0;
+
+	/* Track sequential access for blkcache_readahead() */
+	if (start == bd->next)
+		bd->seq++;
+	else
+		bd->seq = 0;
+	bd->next = start + blkcnt;
+
+	node = cache_find(bd, start, blkcnt, blksz);
 	if (node) {
 		const char *src = node->cache + (start - node->start) * blksz;
 		memcpy(buffer, src, blksz * blkcnt);
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
+		if (node->prefetched) {
+			bd->stats.prefetch_used += node->blkcnt;
+			node->prefetched = false;
+		}
+		++bd->stats.hits;
 		++_stats.hits;
 		return 1;
 	}
 
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
+	++bd->stats.misses;
 	++_stats.misses;
 	return 0;
 }
 
-void blkcache_fill(int iftype, int devnum,
-		   lbaint_t start, lbaint_t blkcnt,
-		   unsigned long blksz, void const *buffer)
+static void cache_fill(struct block_cache_dev *bd, lbaint_t start,
+		       lbaint_t blkcnt, unsigned long blksz,
+		       void const *buffer, bool prefetched)
 {
 	lbaint_t bytes;
 	struct block_cache_node *node;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
-		return;
-
-	if (_stats.max_entries == 0)
-		return;
-
 	bytes = blksz * blkcnt;
 	if (_stats.max_entries <= _stats.entries) {
+		node = cache_victim();
+		if (!node)
+			return;
 		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
+		cache_drop(node);
 		debug("drop: start " LBAF ", count " LBAFU "\n",
 		      node->start, node->blkcnt);
 		if (node->blkcnt * node->blksz < bytes) {
@@ -116,46 +243,95 @@ void blkcache_fill(int iftype, int devnum,
 	debug("fill: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
+	node->bdev = bd;
 	node->start = start;
 	node->blkcnt = blkcnt;
 	node->blksz = blksz;
+	node->fill = cache_fill_id;
+	node->prefetched = prefetched;
 	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
+	list_add(&node->lh, &bd->lru);
+	list_add(&node->glh, &block_cache_lru);
+	hlist_add_head(&node->hn,
+		       cache_chain(bd, start / _stats.max_blocks_per_entry));
+	bd->stats.entries++;
 	_stats.entries++;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_fill(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_dev *bd;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+	/* don't cache big stuff */
+	if (blkcnt > _stats.max_blocks_per_entry)
+		return;
+
+	if (_stats.max_entries == 0)
+		return;
+
+	bd = cache_dev(iftype, devnum, true);
+	if (bd) {
+		cache_fill_id++;
+		cache_fill(bd, start, blkcnt, blksz, buffer, false);
 	}
 }
 
+lbaint_t blkcache_readahead(int iftype, int devnum,
+			    lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_dev *bd = cache_dev(iftype, devnum, false);
+	lbaint_t ahead = _stats.max_prefetch;
+
+	if (!bd || bd->seq < BLKCACHE_SEQ_READS ||
+	    blkcnt > _stats.max_blocks_per_entry)
+		return 0;
+
+	/* Leave room in the cache for more than the read-ahead */
+	if (ahead > _stats.max_entries * _stats.max_blocks_per_entry / 2)
+		ahead = _stats.max_entries * _stats.max_blocks_per_entry / 2;
+
+	return ahead;
+}
+
+void blkcache_fill_ahead(int iftype, int devnum,
+			 lbaint_t start, lbaint_t blkcnt,
+			 unsigned long blksz, void const *buffer)
+{
+	struct block_cache_dev *bd = cache_dev(iftype, devnum, false);
+	const char *src = buffer;
+	lbaint_t count;
+
+	if (!bd || _stats.max_entries == 0 || _stats.max_blocks_per_entry == 0)
+		return;
+
+	bd->stats.prefetched += blkcnt;
+	cache_fill_id++;
+	for (; blkcnt; blkcnt -= count, start += count) {
+		count = min(blkcnt, (lbaint_t)_stats.max_blocks_per_entry);
+		cache_fill(bd, start, count, blksz, src, true);
+		src += count * blksz;
+	}
+}
+
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_dev *bd = cache_dev(iftype, devnum, false);
+
+	if (bd)
+		cache_flush(bd);
+}
+
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
-	struct block_cache_node *node;
+	struct block_cache_dev *bd;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+		list_for_each_entry(bd, &block_cache_devs, lh)
+			cache_flush(bd);
 	}
 
 	_stats.max_blocks_per_entry = blocks;
@@ -163,6 +339,13 @@ void blkcache_configure(unsigned blocks, unsigned entries)
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	list_for_each_entry(bd, &block_cache_devs, lh)
+		cache_reset_stats(bd);
+}
+
+void blkcache_configure_readahead(unsigned blocks)
+{
+	_stats.max_prefetch = blocks;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -171,3 +354,18 @@ void blkcache_stats(struct block_cache_stats *stats)
 	_stats.hits = 0;
 	_stats.misses = 0;
 }
+
+int blkcache_dev_stats(int idx, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bd;
+
+	list_for_each_entry(bd, &block_cache_devs, lh) {
+		if (idx--)
+			continue;
+		memcpy(stats, &bd->stats, sizeof(*stats));
+		cache_reset_stats(bd);
+		return 0;
+	}
+
+	return -ENOENT;
+}
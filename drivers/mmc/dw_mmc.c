@@ -39,7 +39,29 @@ static void dwmci_set_idma_desc(struct dwmci_idmac *idmac,
 	desc->flags = desc0;
 	desc->cnt = desc1;
 	desc->addr = desc2;
-	desc->next_addr = (ulong)desc + sizeof(struct dwmci_idmac);
+}
+
+/*
+ * Get room for @count descriptors. These are kept off the stack since a
+ * transfer of b_max blocks can need far more than it has room for, and are
+ * chained into a ring once when allocated, so that each transfer only
+ * fills in the buffers.
+ */
+static struct dwmci_idmac *dwmci_get_idmac(struct dwmci_host *host,
+					   unsigned int count)
+{
+	unsigned int i;
+
+	if (count > host->idmac_count) {
+		free(host->idmac);
+		host->idmac = malloc_cache_aligned(count * sizeof(*host->idmac));
+		host->idmac_count = host->idmac ? count : 0;
+		for (i = 0; i < host->idmac_count; i++)
+			host->idmac[i].next_addr =
+				(ulong)&host->idmac[(i + 1) % count];
+	}
+
+	return host->idmac;
 }
 
 static void dwmci_prepare_data(struct dwmci_host *host,
@@ -185,25 +207,34 @@ static int dwmci_set_transfer_mode(struct dwmci_host *host,
 	return mode;
 }
 
-#ifdef CONFIG_DM_MMC
-static int dwmci_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
-		   struct mmc_data *data)
+/* Stop the DMA of a transfer and hand its buffer back to the CPU */
+static void dwmci_end_data(struct dwmci_host *host)
 {
-	struct mmc *mmc = mmc_get_mmc_dev(dev);
-#else
-static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
-		struct mmc_data *data)
+	u32 ctrl;
+
+	/* only dma mode need it */
+	if (!host->fifo_mode) {
+		ctrl = dwmci_readl(host, DWMCI_CTRL);
+		ctrl &= ~(DWMCI_DMA_EN);
+		dwmci_writel(host, DWMCI_CTRL, ctrl);
+		bounce_buffer_stop(&host->bbstate);
+	}
+}
+
+/*
+ * Send a command and read its response. Any data phase is left running, to
+ * be finished with dwmci_finish_data().
+ */
+static int dwmci_start_cmd(struct dwmci_host *host, struct mmc_cmd *cmd,
+			   struct mmc_data *data)
 {
-#endif
-	struct dwmci_host *host = mmc->priv;
-	ALLOC_CACHE_ALIGN_BUFFER(struct dwmci_idmac, cur_idmac,
-				 data ? DIV_ROUND_UP(data->blocks, 8) : 0);
-	int ret = 0, flags = 0, i;
+	struct bounce_buffer *bbstate = &host->bbstate;
+	struct dwmci_idmac *cur_idmac;
+	int flags = 0, i;
 	unsigned int timeout = 500;
 	u32 retry = 100000;
-	u32 mask, ctrl;
+	u32 mask;
 	ulong start = get_timer(0);
-	struct bounce_buffer bbstate;
 
 	while (dwmci_readl(host, DWMCI_STATUS) & DWMCI_BUSY) {
 		if (get_timer(start) > timeout) {
@@ -221,17 +252,21 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 				     data->blocksize * data->blocks);
 			dwmci_wait_reset(host, DWMCI_CTRL_FIFO_RESET);
 		} else {
+			cur_idmac = dwmci_get_idmac(host,
+					DIV_ROUND_UP(data->blocks, 8));
+			if (!cur_idmac)
+				return -ENOMEM;
 			if (data->flags == MMC_DATA_READ) {
-				bounce_buffer_start(&bbstate, (void*)data->dest,
+				bounce_buffer_start(bbstate, (void*)data->dest,
 						data->blocksize *
 						data->blocks, GEN_BB_WRITE);
 			} else {
-				bounce_buffer_start(&bbstate, (void*)data->src,
+				bounce_buffer_start(bbstate, (void*)data->src,
 						data->blocksize *
 						data->blocks, GEN_BB_READ);
 			}
 			dwmci_prepare_data(host, data, cur_idmac,
-					   bbstate.bounce_buffer);
+					   bbstate->bounce_buffer);
 		}
 	}
 
@@ -240,8 +275,11 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 	if (data)
 		flags = dwmci_set_transfer_mode(host, data);
 
-	if ((cmd->resp_type & MMC_RSP_136) && (cmd->resp_type & MMC_RSP_BUSY))
+	if ((cmd->resp_type & MMC_RSP_136) && (cmd->resp_type & MMC_RSP_BUSY)) {
+		if (data)
+			dwmci_end_data(host);
 		return -1;
+	}
 
 	if (cmd->cmdidx == MMC_CMD_STOP_TRANSMISSION)
 		flags |= DWMCI_CMD_ABORT_STOP;
@@ -274,6 +312,8 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 
 	if (i == retry) {
 		debug("%s: Timeout.\n", __func__);
+		if (data)
+			dwmci_end_data(host);
 		return -ETIMEDOUT;
 	}
 
@@ -287,9 +327,13 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		 * CMD8, please keep that in mind.
 		 */
 		debug("%s: Response Timeout.\n", __func__);
+		if (data)
+			dwmci_end_data(host);
 		return -ETIMEDOUT;
 	} else if (mask & DWMCI_INTMSK_RE) {
 		debug("%s: Response Error.\n", __func__);
+		if (data)
+			dwmci_end_data(host);
 		return -EIO;
 	}
 
@@ -305,23 +349,72 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		}
 	}
 
-	if (data) {
-		ret = dwmci_data_transfer(host, data);
-
-		/* only dma mode need it */
-		if (!host->fifo_mode) {
-			ctrl = dwmci_readl(host, DWMCI_CTRL);
-			ctrl &= ~(DWMCI_DMA_EN);
-			dwmci_writel(host, DWMCI_CTRL, ctrl);
-			bounce_buffer_stop(&bbstate);
-		}
-	}
+	return 0;
+}
+
+static int dwmci_finish_data(struct dwmci_host *host, struct mmc_data *data)
+{
+	int ret;
+
+	ret = dwmci_data_transfer(host, data);
+	dwmci_end_data(host);
+
+	return ret;
+}
+
+#ifdef CONFIG_DM_MMC
+static int dwmci_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+		   struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+		struct mmc_data *data)
+{
+#endif
+	struct dwmci_host *host = mmc->priv;
+	int ret;
+
+	ret = dwmci_start_cmd(host, cmd, data);
+	if (ret)
+		return ret;
+
+	if (data)
+		ret = dwmci_finish_data(host, data);
 
 	udelay(100);
 
 	return ret;
 }
 
+/*
+ * With IDMAC the data moves by itself once the command is sent, so the CPU
+ * is free until dwmci_wait_data()
+ */
+#ifdef CONFIG_DM_MMC
+static int dwmci_async_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+			   struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int dwmci_async_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data)
+{
+#endif
+	return dwmci_start_cmd(mmc->priv, cmd, data);
+}
+
+#ifdef CONFIG_DM_MMC
+static int dwmci_wait_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int dwmci_wait_data(struct mmc *mmc, struct mmc_data *data)
+{
+#endif
+	return dwmci_finish_data(mmc->priv, data);
+}
+
 static int dwmci_setup_bus(struct dwmci_host *host, u32 freq)
 {
 	u32 div, status;
@@ -426,6 +519,22 @@ static int dwmci_set_ios(struct mmc *mmc)
 	return 0;
 }
 
+#ifdef CONFIG_DM_MMC
+static int dwmci_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int dwmci_execute_tuning(struct mmc *mmc, uint opcode)
+{
+#endif
+	struct dwmci_host *host = (struct dwmci_host *)mmc->priv;
+
+	if (!host->execute_tuning)
+		return -ENOSYS;
+
+	return host->execute_tuning(host, opcode);
+}
+
 static int dwmci_init(struct mmc *mmc)
 {
 	struct dwmci_host *host = mmc->priv;
@@ -478,12 +587,18 @@ int dwmci_probe(struct udevice *dev)
 const struct dm_mmc_ops dm_dwmci_ops = {
 	.send_cmd	= dwmci_send_cmd,
 	.set_ios	= dwmci_set_ios,
+	.execute_tuning	= dwmci_execute_tuning,
+	.start_cmd	= dwmci_async_cmd,
+	.wait_data	= dwmci_wait_data,
 };
 
 #else
 static const struct mmc_ops dwmci_ops = {
 	.send_cmd	= dwmci_send_cmd,
 	.set_ios	= dwmci_set_ios,
+	.execute_tuning	= dwmci_execute_tuning,
+	.start_cmd	= dwmci_async_cmd,
+	.wait_data	= dwmci_wait_data,
 	.init		= dwmci_init,
 };
 #endif
@@ -510,8 +625,10 @@ void dwmci_setup_cfg(struct mmc_config *cfg, struct dwmci_host *host,
 		cfg->host_caps &= ~MMC_MODE_8BIT;
 	}
 	cfg->host_caps |= MMC_MODE_HS | MMC_MODE_HS_52MHz;
+	/* Data commands never send an automatic stop, so CMD23 can be used */
+	cfg->host_caps |= MMC_MODE_CMD23;
 
-	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+	cfg->b_max = host->b_max ? host->b_max : CONFIG_SYS_MMC_MAX_BLK_COUNT;
 }
 
 #ifdef CONFIG_BLK
@@ -39,6 +39,8 @@ struct dwmci_exynos_priv_data {
 	struct dwmci_host host;
 #endif
 	u32 sdr_timing;
+	u32 ddr_timing;
+	u32 hs200_timing;	/* sdr_timing with the tuned sample phase */
 };
 
 /*
@@ -48,8 +50,68 @@ struct dwmci_exynos_priv_data {
 static void exynos_dwmci_clksel(struct dwmci_host *host)
 {
 	struct dwmci_exynos_priv_data *priv = host->priv;
+	u32 timing = priv->sdr_timing;
 
-	dwmci_writel(host, DWMCI_CLKSEL, priv->sdr_timing);
+	if (host->mmc) {
+		if (host->mmc->timing == MMC_TIMING_DDR52)
+			timing = priv->ddr_timing;
+		else if (host->mmc->timing == MMC_TIMING_HS200)
+			timing = priv->hs200_timing;
+	}
+
+	dwmci_writel(host, DWMCI_CLKSEL, timing);
+}
+
+/*
+ * Try each of the eight sample phases with the tuning block and settle on
+ * the middle of the longest run that works, wrapping around phase 7.
+ */
+static int exynos_dwmci_execute_tuning(struct dwmci_host *host, u32 opcode)
+{
+	struct dwmci_exynos_priv_data *priv = host->priv;
+	u32 base = priv->sdr_timing & ~DWMCI_SAMPLE_CLK_MASK;
+	int start = -1, len = 0, best_start = -1, best_len = 0;
+	u8 good = 0;
+	int i;
+
+	for (i = 0; i < DWMCI_SAMPLE_PHASES; i++) {
+		dwmci_writel(host, DWMCI_CLKSEL,
+			     base | DWMCI_SET_SAMPLE_CLK(i));
+		if (!mmc_send_tuning(host->mmc, opcode))
+			good |= 1 << i;
+	}
+	debug("DWMMC%d: tuning phases %02x\n", host->dev_index, good);
+
+	if (!good)
+		return -EIO;
+
+	for (i = 0; i < 2 * DWMCI_SAMPLE_PHASES && len < DWMCI_SAMPLE_PHASES;
+	     i++) {
+		if (good & (1 << (i % DWMCI_SAMPLE_PHASES))) {
+			if (start < 0)
+				start = i;
+			len = i - start + 1;
+			if (len > best_len) {
+				best_start = start;
+				best_len = len;
+			}
+		} else {
+			start = -1;
+			len = 0;
+		}
+	}
+
+	priv->hs200_timing = base | DWMCI_SET_SAMPLE_CLK((best_start +
+				best_len / 2) % DWMCI_SAMPLE_PHASES);
+	dwmci_writel(host, DWMCI_CLKSEL, priv->hs200_timing);
+
+	return 0;
+}
+
+static uint exynos_dwmci_max_freq(struct dwmci_host *host)
+{
+	return host->caps & MMC_MODE_HS200 ? MMC_HS200_MAX_DTR :
+		DWMMC_MAX_FREQ;
 }
 
 unsigned int exynos_dwmci_get_clk(struct dwmci_host *host, uint freq)
@@ -115,13 +177,14 @@ static int exynos_dwmci_core_init(struct dwmci_host *host)
 #endif
 	host->board_init = exynos_dwmci_board_init;
 
-	host->caps = MMC_MODE_DDR_52MHz;
+	host->caps |= MMC_MODE_DDR_52MHz;
 	host->clksel = exynos_dwmci_clksel;
+	host->execute_tuning = exynos_dwmci_execute_tuning;
 	host->get_mmc_clk = exynos_dwmci_get_clk;
 
 #ifndef CONFIG_DM_MMC
 	/* Add the mmc channel to be registered with mmc core */
-	if (add_dwmci(host, DWMMC_MAX_FREQ, DWMMC_MIN_FREQ)) {
+	if (add_dwmci(host, exynos_dwmci_max_freq(host), DWMMC_MIN_FREQ)) {
 		printf("DWMMC%d registration failed\n", host->dev_index);
 		return -1;
 	}
@@ -147,17 +210,11 @@ static int do_dwmci_init(struct dwmci_host *host)
 }
 
 static int exynos_dwmci_get_config(const void *blob, int node,
-					struct dwmci_host *host)
+				   struct dwmci_host *host,
+				   struct dwmci_exynos_priv_data *priv)
 {
 	int err = 0;
 	u32 base, timing[3];
-	struct dwmci_exynos_priv_data *priv;
-
-	priv = malloc(sizeof(struct dwmci_exynos_priv_data));
-	if (!priv) {
-		pr_err("dwmci_exynos_priv_data malloc fail!\n");
-		return -ENOMEM;
-	}
 
 	/* Extract device id for each mmc channel */
 	host->dev_id = pinmux_decode_periph_id(blob, node);
@@ -202,9 +259,22 @@ static int exynos_dwmci_get_config(const void *blob, int node,
 			priv->sdr_timing = DWMMC_MMC2_SDR_TIMING_VAL;
 	}
 
+	/* DDR52 may need a different phase; default to the SDR one */
+	if (fdtdec_get_int_array(blob, node, "samsung,ddr-timing", timing, 3))
+		priv->ddr_timing = priv->sdr_timing;
+	else
+		priv->ddr_timing = DWMCI_SET_SAMPLE_CLK(timing[0]) |
+				DWMCI_SET_DRV_CLK(timing[1]) |
+				DWMCI_SET_DIV_RATIO(timing[2]);
+	priv->hs200_timing = priv->sdr_timing;
+
+	if (fdtdec_get_bool(blob, node, "mmc-hs200-1_8v"))
+		host->caps |= MMC_MODE_HS200;
+
 	host->fifoth_val = fdtdec_get_int(blob, node, "fifoth_val", 0);
 	host->bus_hz = fdtdec_get_int(blob, node, "bus_hz", 0);
 	host->div = fdtdec_get_int(blob, node, "div", 0);
+	host->b_max = CONFIG_MMC_DW_EXYNOS_MAX_BLK_COUNT;
 
 	host->priv = priv;
 
@@ -214,6 +284,7 @@ static int exynos_dwmci_get_config(const void *blob, int node,
 static int exynos_dwmci_process_node(const void *blob,
 					int node_list[], int count)
 {
+	struct dwmci_exynos_priv_data *priv;
 	struct dwmci_host *host;
 	int i, node, err;
 
@@ -222,7 +293,12 @@ static int exynos_dwmci_process_node(const void *blob,
 		if (node <= 0)
 			continue;
 		host = &dwmci_host[i];
-		err = exynos_dwmci_get_config(blob, node, host);
+		priv = calloc(1, sizeof(*priv));
+		if (!priv) {
+			pr_err("dwmci_exynos_priv_data malloc fail!\n");
+			return -ENOMEM;
+		}
+		err = exynos_dwmci_get_config(blob, node, host, priv);
 		if (err) {
 			printf("%s: failed to decode dev %d\n", __func__, i);
 			return err;
@@ -264,17 +340,18 @@ static int exynos_dwmmc_probe(struct udevice *dev)
 	struct dwmci_host *host = &priv->host;
 	int err;
 
-	err = exynos_dwmci_get_config(gd->fdt_blob, dev_of_offset(dev), host);
+	err = exynos_dwmci_get_config(gd->fdt_blob, dev_of_offset(dev), host,
+				      priv);
 	if (err)
 		return err;
 	err = do_dwmci_init(host);
 	if (err)
 		return err;
 
-	dwmci_setup_cfg(&plat->cfg, host, DWMMC_MAX_FREQ, DWMMC_MIN_FREQ);
+	dwmci_setup_cfg(&plat->cfg, host, exynos_dwmci_max_freq(host),
+			DWMMC_MIN_FREQ);
 	host->mmc = &plat->mmc;
 	host->mmc->priv = &priv->host;
-	host->priv = dev;
 	upriv->mmc = host->mmc;
 
 	return dwmci_probe(dev);
@@ -34,6 +34,7 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+	mmc_async_wait(mmc);
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
@@ -79,6 +80,57 @@ int mmc_getcd(struct mmc *mmc)
 	return dm_mmc_get_cd(mmc->dev);
 }
 
+int dm_mmc_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->execute_tuning)
+		return -ENOSYS;
+	return ops->execute_tuning(dev, opcode);
+}
+
+int mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	return dm_mmc_execute_tuning(mmc->dev, opcode);
+}
+
+int dm_mmc_start_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+		     struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+	int ret;
+
+	if (!ops->start_cmd || !ops->wait_data)
+		return -ENOSYS;
+
+	mmmc_trace_before_send(mmc, cmd);
+	ret = ops->start_cmd(dev, cmd, data);
+	mmmc_trace_after_send(mmc, cmd, ret);
+
+	return ret;
+}
+
+int mmc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	mmc_async_wait(mmc);
+	return dm_mmc_start_cmd(mmc->dev, cmd, data);
+}
+
+int dm_mmc_wait_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->wait_data)
+		return -ENOSYS;
+	return ops->wait_data(dev, data);
+}
+
+int mmc_wait_data(struct mmc *mmc, struct mmc_data *data)
+{
+	return dm_mmc_wait_data(mmc->dev, data);
+}
+
 struct mmc *mmc_get_mmc_dev(struct udevice *dev)
 {
 	struct mmc_uclass_priv *upriv;
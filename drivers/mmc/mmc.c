@@ -154,12 +154,34 @@ int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int ret;
 
+	mmc_async_wait(mmc);
 	mmmc_trace_before_send(mmc, cmd);
 	ret = mmc->cfg->ops->send_cmd(mmc, cmd, data);
 	mmmc_trace_after_send(mmc, cmd, ret);
 
 	return ret;
 }
+
+static int mmc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			 struct mmc_data *data)
+{
+	int ret;
+
+	if (!mmc->cfg->ops->start_cmd || !mmc->cfg->ops->wait_data)
+		return -ENOSYS;
+
+	mmc_async_wait(mmc);
+	mmmc_trace_before_send(mmc, cmd);
+	ret = mmc->cfg->ops->start_cmd(mmc, cmd, data);
+	mmmc_trace_after_send(mmc, cmd, ret);
+
+	return ret;
+}
+
+static int mmc_wait_data(struct mmc *mmc, struct mmc_data *data)
+{
+	return mmc->cfg->ops->wait_data(mmc, data);
+}
 #endif
 
 int mmc_send_status(struct mmc *mmc, int timeout)
@@ -220,47 +242,231 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 	return mmc_send_cmd(mmc, &cmd, NULL);
 }
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+int mmc_set_blockcount(struct mmc *mmc, unsigned int blockcount,
+		       bool is_rel_write)
+{
+	struct mmc_cmd cmd = {0};
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blockcount & MMC_SBC_MAX_BLOCKS;
+	if (is_rel_write)
+		cmd.cmdarg |= MMC_SBC_RELIABLE_WRITE;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+/*
+ * Check whether a multi-block transfer of @blkcnt blocks can be announced
+ * with CMD23, so that it ends by itself instead of with a CMD12 and the
+ * busy wait after it.
+ */
+bool mmc_can_sbc(struct mmc *mmc, lbaint_t blkcnt)
+{
+	if (!(mmc->cfg->host_caps & MMC_MODE_CMD23) || mmc_host_is_spi(mmc))
+		return false;
+	if (blkcnt > MMC_SBC_MAX_BLOCKS)
+		return false;
+	if (IS_SD(mmc))
+		return mmc->scr[0] & SD_SCR_CMD23;
+
+	return mmc->version >= MMC_VERSION_3;
+}
+
+static void mmc_send_stop(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
-	struct mmc_data data;
+
+	cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1b;
+	mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+/* Set up a read, announcing it with CMD23 if the card can take that */
+static int mmc_read_prepare(struct mmc *mmc, struct mmc_cmd *cmd,
+			    struct mmc_data *data, void *dst, lbaint_t start,
+			    lbaint_t blkcnt, bool *sbc)
+{
+	*sbc = blkcnt > 1 && mmc_can_sbc(mmc, blkcnt);
+	if (*sbc && mmc_set_blockcount(mmc, blkcnt, false))
+		return -EIO;
 
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
-		return 0;
+	return 0;
+}
+
+/* Finish a read whose data phase ended with @err */
+static int mmc_read_finish(struct mmc *mmc, lbaint_t blkcnt, bool sbc,
+			   int err)
+{
+	struct mmc_cmd cmd;
+
+	if (err) {
+		/* Get the card out of the data state it may be left in */
+		if (sbc)
+			mmc_send_stop(mmc);
+		return err;
+	}
 
-	if (blkcnt > 1) {
+	if (blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
-		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+		err = mmc_send_cmd(mmc, &cmd, NULL);
+		if (err) {
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 			printf("mmc fail to send stop cmd\n");
 #endif
-			return 0;
+			return err;
 		}
 	}
 
+	return 0;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	bool sbc;
+	int err;
+
+	if (mmc_read_prepare(mmc, &cmd, &data, dst, start, blkcnt, &sbc))
+		return 0;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (mmc_read_finish(mmc, blkcnt, sbc, err))
+		return 0;
+
 	return blkcnt;
 }
 
+/*
+ * Let a read queued by mmc_bread_submit() run to its end. This is called
+ * before every command and bus change, including the stop command that
+ * ends the read itself, so in_flight is cleared first.
+ */
+void mmc_async_wait(struct mmc *mmc)
+{
+	struct mmc_async_read *req = &mmc->async;
+	int err;
+
+	if (!req->in_flight)
+		return;
+
+	req->in_flight = false;
+	err = mmc_wait_data(mmc, &req->data);
+	req->ret = mmc_read_finish(mmc, req->blkcnt, req->sbc, err);
+}
+
+/* Select the hardware partition and check the range for a block access */
+static int mmc_access_check(struct mmc *mmc, struct blk_desc *block_dev,
+			    lbaint_t start, lbaint_t blkcnt)
+{
+	int err;
+
+	if (CONFIG_IS_ENABLED(MMC_TINY))
+		err = mmc_switch_part(mmc, block_dev->hwpart);
+	else
+		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
+
+	if (err < 0)
+		return err;
+
+	if ((start + blkcnt) > block_dev->lba) {
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
+			start + blkcnt, block_dev->lba);
+#endif
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+long mmc_bread_submit(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt, void *dst)
+{
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	struct mmc_async_read *req;
+	struct mmc_cmd cmd;
+	int err;
+
+	if (!mmc)
+		return -ENODEV;
+	req = &mmc->async;
+	if (req->blkcnt)
+		return -EBUSY;
+	if (!blkcnt)
+		return 0;
+
+	err = mmc_access_check(mmc, block_dev, start, blkcnt);
+	if (err)
+		return err;
+
+	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
+		debug("%s: Failed to set blocklen\n", __func__);
+		return -EIO;
+	}
+
+	blkcnt = min(blkcnt, (lbaint_t)mmc->cfg->b_max);
+	err = mmc_read_prepare(mmc, &cmd, &req->data, dst, start, blkcnt,
+			       &req->sbc);
+	if (err)
+		return err;
+
+	err = mmc_start_cmd(mmc, &cmd, &req->data);
+	if (err == -ENOSYS) {
+		/* The host cannot leave the data running, so do it all now */
+		err = mmc_send_cmd(mmc, &cmd, &req->data);
+		req->ret = mmc_read_finish(mmc, blkcnt, req->sbc, err);
+	} else if (err) {
+		return mmc_read_finish(mmc, blkcnt, req->sbc, err);
+	} else {
+		req->in_flight = true;
+	}
+	req->blkcnt = blkcnt;
+
+	return blkcnt;
+}
+
+long mmc_bread_complete(struct blk_desc *block_dev)
+{
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	struct mmc_async_read *req;
+	lbaint_t blkcnt;
+
+	if (!mmc)
+		return -ENODEV;
+	req = &mmc->async;
+	if (!req->blkcnt)
+		return -ENOENT;
+
+	mmc_async_wait(mmc);
+	blkcnt = req->blkcnt;
+	req->blkcnt = 0;
+
+	return req->ret ? req->ret : blkcnt;
+}
+
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
 #else
@@ -282,21 +488,9 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (!mmc)
 		return 0;
 
-	if (CONFIG_IS_ENABLED(MMC_TINY))
-		err = mmc_switch_part(mmc, block_dev->hwpart);
-	else
-		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
-
-	if (err < 0)
-		return 0;
-
-	if ((start + blkcnt) > block_dev->lba) {
-#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
-			start + blkcnt, block_dev->lba);
-#endif
+	err = mmc_access_check(mmc, block_dev, start, blkcnt);
+	if (err)
 		return 0;
-	}
 
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		debug("%s: Failed to set blocklen\n", __func__);
@@ -517,6 +711,67 @@ static int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 	return err;
 }
 
+/* The tuning block a card sends in reply to CMD21, by bus width */
+const u8 tuning_blk_pattern_4bit[MMC_TUNING_BLK_4BIT_SIZE] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+const u8 tuning_blk_pattern_8bit[MMC_TUNING_BLK_8BIT_SIZE] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+int mmc_send_tuning(struct mmc *mmc, uint opcode)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, buf, MMC_TUNING_BLK_8BIT_SIZE);
+	const u8 *pattern = tuning_blk_pattern_4bit;
+	uint size = MMC_TUNING_BLK_4BIT_SIZE;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int err;
+
+	if (mmc->bus_width == 8) {
+		pattern = tuning_blk_pattern_8bit;
+		size = MMC_TUNING_BLK_8BIT_SIZE;
+	}
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	data.dest = (char *)buf;
+	data.blocks = 1;
+	data.blocksize = size;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	return memcmp(buf, pattern, size) ? -EIO : 0;
+}
+
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 {
 	struct mmc_cmd cmd;
@@ -568,7 +823,7 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0x3f;
 
 	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
 
@@ -589,6 +844,8 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (cardtype & EXT_CSD_CARD_TYPE_52) {
 		if (cardtype & EXT_CSD_CARD_TYPE_DDR_1_8V)
 			mmc->card_caps |= MMC_MODE_DDR_52MHz;
+		if (cardtype & EXT_CSD_CARD_TYPE_HS200_1_8V)
+			mmc->card_caps |= MMC_MODE_HS200;
 		mmc->card_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
 	} else {
 		mmc->card_caps |= MMC_MODE_HS;
@@ -1081,6 +1338,13 @@ static void mmc_set_ios(struct mmc *mmc)
 	if (mmc->cfg->ops->set_ios)
 		mmc->cfg->ops->set_ios(mmc);
 }
+
+static int mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	if (!mmc->cfg->ops->execute_tuning)
+		return -ENOSYS;
+	return mmc->cfg->ops->execute_tuning(mmc, opcode);
+}
 #endif
 
 void mmc_set_clock(struct mmc *mmc, uint clock)
@@ -1091,6 +1355,7 @@ void mmc_set_clock(struct mmc *mmc, uint clock)
 	if (clock < mmc->cfg->f_min)
 		clock = mmc->cfg->f_min;
 
+	mmc_async_wait(mmc);
 	mmc->clock = clock;
 
 	mmc_set_ios(mmc);
@@ -1098,11 +1363,51 @@ void mmc_set_clock(struct mmc *mmc, uint clock)
 
 static void mmc_set_bus_width(struct mmc *mmc, uint width)
 {
+	mmc_async_wait(mmc);
 	mmc->bus_width = width;
 
 	mmc_set_ios(mmc);
 }
 
+/*
+ * Switch to HS200: the widest SDR bus first, then the timing, then the
+ * clock, after which the host must find a sampling point that works.
+ */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	uint width = (mmc->card_caps & MMC_MODE_8BIT) ? 8 : 4;
+	int err;
+
+	if (!(mmc->card_caps & (MMC_MODE_8BIT | MMC_MODE_4BIT)))
+		return -EOPNOTSUPP;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 width == 8 ? EXT_CSD_BUS_WIDTH_8 : EXT_CSD_BUS_WIDTH_4);
+	if (err)
+		return err;
+	mmc_set_bus_width(mmc, width);
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS200);
+	if (err)
+		return err;
+	mmc->timing = MMC_TIMING_HS200;
+	mmc_set_clock(mmc, MMC_HS200_MAX_DTR);
+
+	return mmc_execute_tuning(mmc, MMC_CMD_SEND_TUNING_BLOCK_HS200);
+}
+
+/* Go back to high speed after HS200 did not work out */
+static int mmc_deselect_hs200(struct mmc *mmc)
+{
+	mmc->card_caps &= ~MMC_MODE_HS200;
+	mmc->timing = MMC_TIMING_HS;
+	mmc_set_clock(mmc, 26000000);
+
+	return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			  EXT_CSD_TIMING_HS);
+}
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -1259,6 +1564,7 @@ static int mmc_startup(struct mmc *mmc)
 	 * For SD, its erase group is always one sector
 	 */
 	mmc->erase_grp_size = 1;
+	mmc->erased_zero = 0;
 	mmc->part_config = MMCPART_NOAVAILABLE;
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
@@ -1408,6 +1714,9 @@ static int mmc_startup(struct mmc *mmc)
 			* ext_csd[EXT_CSD_HC_WP_GRP_SIZE];
 
 		mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
+		mmc->wr_rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
+		mmc->rel_wr_sec_c = ext_csd[EXT_CSD_REL_WR_SEC_C];
+		mmc->erased_zero = !ext_csd[EXT_CSD_ERASED_MEM_CONT];
 	}
 
 	err = mmc_set_capacity(mmc, mmc_get_blk_desc(mmc)->hwpart);
@@ -1448,6 +1757,7 @@ static int mmc_startup(struct mmc *mmc)
 		err = sd_read_ssr(mmc);
 		if (err)
 			return err;
+		mmc->erased_zero = !(mmc->scr[0] & SD_SCR_ERASED_ONES);
 
 		if (mmc->card_caps & MMC_MODE_HS)
 			mmc->tran_speed = 50000000;
@@ -1481,7 +1791,18 @@ static int mmc_startup(struct mmc *mmc)
 			8, 4, 8, 4, 1,
 		};
 
-		for (idx=0; idx < ARRAY_SIZE(ext_csd_bits); idx++) {
+		if (mmc->card_caps & MMC_MODE_HS200) {
+			err = mmc_select_hs200(mmc);
+			if (err) {
+				debug("%s: HS200 failed (%d)\n", __func__, err);
+				err = mmc_deselect_hs200(mmc);
+				if (err)
+					return err;
+			}
+		}
+
+		for (idx = 0; mmc->timing != MMC_TIMING_HS200 &&
+		     idx < ARRAY_SIZE(ext_csd_bits); idx++) {
 			unsigned int extw = ext_csd_bits[idx];
 			unsigned int caps = ext_to_hostcaps[extw];
 
@@ -1537,7 +1858,9 @@ static int mmc_startup(struct mmc *mmc)
 		if (err)
 			return err;
 
-		if (mmc->card_caps & MMC_MODE_HS) {
+		if (mmc->timing == MMC_TIMING_HS200) {
+			mmc->tran_speed = MMC_HS200_MAX_DTR;
+		} else if (mmc->card_caps & MMC_MODE_HS) {
 			if (mmc->card_caps & MMC_MODE_HS_52MHz)
 				mmc->tran_speed = 52000000;
 			else
@@ -1545,6 +1868,12 @@ static int mmc_startup(struct mmc *mmc)
 		}
 	}
 
+	if (mmc->timing != MMC_TIMING_HS200) {
+		if (mmc->ddr_mode)
+			mmc->timing = MMC_TIMING_DDR52;
+		else if (mmc->card_caps & MMC_MODE_HS)
+			mmc->timing = MMC_TIMING_HS;
+	}
 	mmc_set_clock(mmc, mmc->tran_speed);
 
 	/* Fix the block length for DDR mode */
@@ -1682,6 +2011,7 @@ int mmc_start_init(struct mmc *mmc)
 		return err;
 #endif
 	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_LEGACY;
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -10,6 +10,7 @@
 #include <config.h>
 #include <common.h>
 #include <dm.h>
+#include <errno.h>
 #include <part.h>
 #include <div64.h>
 #include <linux/math64.h>
@@ -127,12 +128,54 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
+lbaint_t mmc_erase_zero_grp(struct blk_desc *block_dev)
+{
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+
+	if (!mmc || !mmc->erased_zero)
+		return 0;
+
+	return mmc->erase_grp_size;
+}
+
+int mmc_set_reliable_write(struct mmc *mmc, bool enable)
+{
+	if (enable && (IS_SD(mmc) || mmc->version < MMC_VERSION_4_3 ||
+		       !mmc->rel_wr_sec_c || !mmc_can_sbc(mmc, 1)))
+		return -EOPNOTSUPP;
+
+	mmc->reliable_write = enable;
+
+	return 0;
+}
+
+/*
+ * Without enhanced reliable write the card only guarantees writes of one
+ * block, or of rel_wr_sec_c blocks at an aligned address, so cut the
+ * transfer down to one of those.
+ */
+static lbaint_t mmc_reliable_write_count(struct mmc *mmc, lbaint_t start,
+					 lbaint_t blkcnt)
+{
+	lbaint_t sec = mmc->rel_wr_sec_c;
+	u64 pos = start;
+
+	if (mmc->wr_rel_param & EXT_CSD_EN_REL_WR)
+		return blkcnt;
+	if (do_div(pos, sec) || blkcnt < sec)
+		return 1;
+
+	return sec;
+}
+
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 		lbaint_t blkcnt, const void *src)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int timeout = 1000;
+	bool rel = mmc->reliable_write;
+	bool sbc;
 
 	if ((start + blkcnt) > mmc_get_blk_desc(mmc)->lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
@@ -142,7 +185,15 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 
 	if (blkcnt == 0)
 		return 0;
-	else if (blkcnt == 1)
+
+	/* Reliable writes are always announced with CMD23 */
+	sbc = rel || (blkcnt > 1 && mmc_can_sbc(mmc, blkcnt));
+	if (sbc && mmc_set_blockcount(mmc, blkcnt, rel)) {
+		printf("mmc fail to set block count\n");
+		return 0;
+	}
+
+	if (blkcnt == 1 && !rel)
 		cmd.cmdidx = MMC_CMD_WRITE_SINGLE_BLOCK;
 	else
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
@@ -161,13 +212,20 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 
 	if (mmc_send_cmd(mmc, &cmd, &data)) {
 		printf("mmc write failed\n");
+		if (sbc) {
+			cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+			cmd.cmdarg = 0;
+			cmd.resp_type = MMC_RSP_R1b;
+			mmc_send_cmd(mmc, &cmd, NULL);
+		}
 		return 0;
 	}
 
 	/* SPI multiblock writes terminate using a special
-	 * token, not a STOP_TRANSMISSION request.
+	 * token, not a STOP_TRANSMISSION request. Transfers announced
+	 * with CMD23 end by themselves.
 	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
+	if (!mmc_host_is_spi(mmc) && blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -213,6 +271,10 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
+		if (mmc->reliable_write) {
+			cur = min(cur, (lbaint_t)MMC_SBC_MAX_BLOCKS);
+			cur = mmc_reliable_write_count(mmc, start, cur);
+		}
 		if (mmc_write_blocks(mmc, start, cur, src) != cur)
 			return 0;
 		blocks_todo -= cur;
@@ -14,20 +14,87 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#define SANDBOX_MMC_CMDS	64
+#define SANDBOX_MMC_PHASES	8
+
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
+	uint cmd_count[SANDBOX_MMC_CMDS];	/* commands seen, by index */
+	bool emmc;				/* emulate an eMMC, not SD */
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	u8 good_phases;		/* sample phases at which HS200 works */
+	u8 phase;		/* sample phase set by tuning */
+	struct mmc_data *pending;	/* data started by start_cmd() */
 };
 
+/* Handle the commands where an eMMC differs from an SD card */
+static int sandbox_emmc_send_cmd(struct sandbox_mmc_plat *plat,
+				 struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	u8 *ext_csd = plat->ext_csd;
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_APP_CMD:
+		return -ETIMEDOUT;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS;
+		break;
+	case MMC_CMD_SEND_CSD:
+		cmd->response[0] = 4 << 26;	/* MMC version 4 */
+		cmd->response[1] = 9 << 16;	/* 1 << read_bl_len */
+		cmd->response[2] = 0;
+		cmd->response[3] = 9 << 22;	/* 1 << write_bl_len */
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		if (!data)
+			return -ETIMEDOUT;	/* SD_CMD_SEND_IF_COND */
+		memcpy(data->dest, ext_csd, MMC_MAX_BLOCK_LEN);
+		break;
+	case MMC_CMD_SWITCH:
+		ext_csd[(cmd->cmdarg >> 16) & 0xff] = (cmd->cmdarg >> 8) & 0xff;
+		break;
+	case MMC_CMD_SEND_TUNING_BLOCK_HS200:
+		if (ext_csd[EXT_CSD_HS_TIMING] != EXT_CSD_TIMING_HS200 ||
+		    !(plat->good_phases & (1 << plat->phase)))
+			return -EIO;
+		if (ext_csd[EXT_CSD_BUS_WIDTH] == EXT_CSD_BUS_WIDTH_8)
+			memcpy(data->dest, tuning_blk_pattern_8bit,
+			       MMC_TUNING_BLK_8BIT_SIZE);
+		else
+			memcpy(data->dest, tuning_blk_pattern_4bit,
+			       MMC_TUNING_BLK_4BIT_SIZE);
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
- * This emulate an SD card version 2. Single-block reads result in zero data.
- * Multiple-block reads return a test string.
+ * This emulate an SD card version 2 that supports CMD23, or an eMMC 4.5
+ * capable of HS200 once sandbox_mmc_set_emmc() is called. Single-block reads
+ * result in zero data. Multiple-block reads return a test string. Writes are
+ * accepted and dropped.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	int ret;
+
+	if (cmd->cmdidx < SANDBOX_MMC_CMDS)
+		plat->cmd_count[cmd->cmdidx]++;
+
+	if (plat->emmc) {
+		ret = sandbox_emmc_send_cmd(plat, cmd, data);
+		if (ret != -ENOENT)
+			return ret;
+	}
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		break;
@@ -60,6 +127,9 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		strcpy(data->dest, "this is a test");
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
+	case MMC_CMD_SET_BLOCK_COUNT:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
 		break;
 	case SD_CMD_APP_SEND_OP_COND:
 		cmd->response[0] = OCR_BUSY | OCR_HCS;
@@ -74,7 +144,8 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	case SD_CMD_APP_SEND_SCR: {
 		u32 *scr = (u32 *)data->dest;
 
-		scr[0] = cpu_to_be32(2 << 24 | 1 << 15);  /* SD version 3 */
+		/* SD version 3, with CMD23 */
+		scr[0] = cpu_to_be32(2 << 24 | 1 << 15 | SD_SCR_CMD23);
 		break;
 	}
 	default:
@@ -95,10 +166,98 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+static int sandbox_mmc_start_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	int ret;
+
+	ret = sandbox_mmc_send_cmd(dev, cmd, data);
+	if (!ret)
+		plat->pending = data;
+
+	return ret;
+}
+
+static int sandbox_mmc_wait_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	if (!plat->pending || plat->pending != data)
+		return -EINVAL;
+	plat->pending = NULL;
+
+	return 0;
+}
+
+/* Sweep the sample phases and keep the first that works */
+static int sandbox_mmc_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	u8 good = 0;
+	int i;
+
+	for (i = 0; i < SANDBOX_MMC_PHASES; i++) {
+		plat->phase = i;
+		if (!mmc_send_tuning(&plat->mmc, opcode))
+			good |= 1 << i;
+	}
+	if (!good)
+		return -EIO;
+	plat->phase = ffs(good) - 1;
+
+	return 0;
+}
+
+uint sandbox_mmc_cmd_count(struct udevice *dev, int cmdidx)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	return plat->cmd_count[cmdidx];
+}
+
+void sandbox_mmc_clear_cmd_counts(struct udevice *dev)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	memset(plat->cmd_count, '\0', sizeof(plat->cmd_count));
+}
+
+bool sandbox_mmc_data_pending(struct udevice *dev)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	return plat->pending != NULL;
+}
+
+void sandbox_mmc_set_emmc(struct udevice *dev, bool emmc, u8 good_phases)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	u8 *ext_csd = plat->ext_csd;
+
+	plat->emmc = emmc;
+	plat->good_phases = good_phases;
+	plat->phase = 0;
+
+	memset(ext_csd, '\0', sizeof(plat->ext_csd));
+	ext_csd[EXT_CSD_REV] = 6;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_1_8V |
+		EXT_CSD_CARD_TYPE_HS200_1_8V;
+	/* 8GiB */
+	ext_csd[EXT_CSD_SEC_CNT + 3] = 0x01;
+
+	/* Start again from the beginning on the next mmc_init() */
+	plat->mmc.has_init = 0;
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+	.execute_tuning = sandbox_mmc_execute_tuning,
+	.start_cmd = sandbox_mmc_start_cmd,
+	.wait_data = sandbox_mmc_wait_data,
 };
 
 int sandbox_mmc_probe(struct udevice *dev)
@@ -114,10 +273,11 @@ int sandbox_mmc_bind(struct udevice *dev)
 	struct mmc_config *cfg = &plat->cfg;
 
 	cfg->name = dev->name;
-	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT;
+	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT |
+			 MMC_MODE_CMD23 | MMC_MODE_DDR_52MHz | MMC_MODE_HS200;
 	cfg->voltages = MMC_VDD_165_195 | MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->f_min = 1000000;
-	cfg->f_max = 52000000;
+	cfg->f_max = MMC_HS200_MAX_DTR;
 	cfg->b_max = U32_MAX;
 
 	return mmc_bind(dev, &plat->mmc, cfg);
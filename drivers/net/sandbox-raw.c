@@ -26,8 +26,7 @@ static int sb_eth_raw_start(struct udevice *dev)
 
 	debug("eth_sandbox_raw: Start\n");
 
-	interface = fdt_getprop(gd->fdt_blob, dev_of_offset(dev),
-					    "host-raw-interface", NULL);
+	interface = dev_read_string(dev, "host-raw-interface");
 	if (interface == NULL)
 		return -EINVAL;
 
@@ -65,7 +64,8 @@ static int sb_eth_raw_send(struct udevice *dev, void *packet, int length)
 	return sandbox_eth_raw_os_send(packet, length, priv);
 }
 
-static int sb_eth_raw_recv(struct udevice *dev, int flags, uchar **packetp)
+static int sb_eth_raw_recv_common(struct udevice *dev, uchar **packetp,
+				  const struct eth_rx_split *split)
 {
 	struct eth_pdata *pdata = dev_get_platdata(dev);
 	struct eth_sandbox_raw_priv *priv = dev_get_priv(dev);
@@ -97,6 +97,11 @@ static int sb_eth_raw_recv(struct udevice *dev, int flags, uchar **packetp)
 		memcpy(&arp->ar_tha, pdata->enetaddr, ARP_HLEN);
 		net_write_ip(&arp->ar_tpa, net_ip);
 		length = ARP_HDR_SIZE;
+	} else if (split) {
+		retval = sandbox_eth_raw_os_recv_split(net_rx_packets[0],
+						       split->hdr_len,
+						       split->dst, split->len,
+						       &length, priv);
 	} else {
 		/* If local, the Ethernet header won't be included; skip it */
 		uchar *pktptr = priv->local ?
@@ -125,6 +130,30 @@ static int sb_eth_raw_recv(struct udevice *dev, int flags, uchar **packetp)
 	return retval;
 }
 
+static int sb_eth_raw_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+	return sb_eth_raw_recv_common(dev, packetp, NULL);
+}
+
+static int sb_eth_raw_recv_split(struct udevice *dev, int flags,
+				 uchar **packetp,
+				 const struct eth_rx_split *split)
+{
+	struct eth_sandbox_raw_priv *priv = dev_get_priv(dev);
+	int length;
+
+	if (!priv->local)
+		return sb_eth_raw_recv_common(dev, packetp, split);
+
+	/* Packets on lo have their Ethernet header made up; just move data */
+	length = sb_eth_raw_recv_common(dev, packetp, NULL);
+	if (length > split->hdr_len && length <= split->hdr_len + split->len)
+		memcpy(split->dst, *packetp + split->hdr_len,
+		       length - split->hdr_len);
+
+	return length;
+}
+
 static void sb_eth_raw_stop(struct udevice *dev)
 {
 	struct eth_sandbox_raw_priv *priv = dev_get_priv(dev);
@@ -138,6 +167,7 @@ static const struct eth_ops sb_eth_raw_ops = {
 	.start			= sb_eth_raw_start,
 	.send			= sb_eth_raw_send,
 	.recv			= sb_eth_raw_recv,
+	.recv_split		= sb_eth_raw_recv_split,
 	.stop			= sb_eth_raw_stop,
 };
 
@@ -22,16 +22,39 @@ DECLARE_GLOBAL_DATA_PTR;
  * fake_host_ipaddr: IP address of mocked machine
  * recv_packet_buffer: buffer of the packet returned as received
  * recv_packet_length: length of the packet returned as received
+ * tftp_pending: the mock TFTP server has a reply to send
+ * tftp_block: block the mock TFTP server sends next, 0 for the OACK
+ * tftp_client_hwaddr: MAC address the mock TFTP server replies to
+ * tftp_client_ipaddr: IP address the mock TFTP server replies to
+ * tftp_client_port: UDP port the mock TFTP server replies to
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
 	uchar *recv_packet_buffer;
 	int recv_packet_length;
+	bool tftp_pending;
+	int tftp_block;
+	uchar tftp_client_hwaddr[ARP_HLEN];
+	struct in_addr tftp_client_ipaddr;
+	int tftp_client_port;
 };
 
+/* The mock TFTP server, which sends 512-byte blocks */
+#define SB_TFTP_PORT		69
+#define SB_TFTP_DATA_PORT	1069
+#define SB_TFTP_BLOCK_SIZE	512
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_OACK		6
+
 static bool disabled[8] = {false};
 static bool skip_timeout;
+static int tftp_file_size;
+static int tftp_last_sent;
+static int tftp_placed;
+static int tftp_resent;
 
 /*
  * sandbox_eth_disable_response()
@@ -54,6 +77,41 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_set_tftp_file()
+ *
+ * size - Size of the file the mock TFTP server sends for any read request,
+ *	  byte n holding n % 251, or 0 to ignore TFTP requests
+ */
+void sandbox_eth_set_tftp_file(int size)
+{
+	tftp_file_size = size;
+	tftp_last_sent = -1;
+	tftp_placed = 0;
+	tftp_resent = 0;
+}
+
+/*
+ * sandbox_eth_get_tftp_placed()
+ *
+ * Return the number of TFTP blocks received split since the file was set
+ */
+int sandbox_eth_get_tftp_placed(void)
+{
+	return tftp_placed;
+}
+
+/*
+ * sandbox_eth_get_tftp_resent()
+ *
+ * Return the number of TFTP replies sent again, because the client asked
+ * again, since the file was set
+ */
+int sandbox_eth_get_tftp_resent(void)
+{
+	return tftp_resent;
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -67,6 +125,91 @@ static int sb_eth_start(struct udevice *dev)
 	return 0;
 }
 
+/* Note what the mock TFTP server should answer to a request or an ACK */
+static void sb_tftp_request(struct eth_sandbox_priv *priv, void *packet)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	__be16 *s = (__be16 *)(ip + 1);
+
+	if (ntohs(ip->udp_dst) == SB_TFTP_PORT && ntohs(s[0]) == SB_TFTP_RRQ)
+		priv->tftp_block = 0;
+	else if (ntohs(ip->udp_dst) == SB_TFTP_DATA_PORT &&
+		 ntohs(s[0]) == SB_TFTP_ACK &&
+		 ntohs(s[1]) * SB_TFTP_BLOCK_SIZE <= tftp_file_size)
+		priv->tftp_block = ntohs(s[1]) + 1;
+	else
+		return;
+
+	memcpy(priv->tftp_client_hwaddr, eth->et_src, ARP_HLEN);
+	priv->tftp_client_ipaddr = net_read_ip(&ip->ip_src);
+	priv->tftp_client_port = ntohs(ip->udp_src);
+	priv->tftp_pending = true;
+}
+
+/* Formulate the OACK or data block the mock TFTP server sends next */
+static void sb_tftp_reply(struct eth_sandbox_priv *priv)
+{
+	struct ethernet_hdr *eth = (void *)priv->recv_packet_buffer;
+	struct ip_udp_hdr *ip = (void *)priv->recv_packet_buffer +
+		ETHER_HDR_SIZE;
+	uchar *data = (uchar *)(ip + 1);
+	struct {
+		struct in_addr src;
+		struct in_addr dest;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} ph;
+	int offset, len, i;
+	unsigned sum;
+
+	if (!priv->tftp_block) {
+		*(__be16 *)data = htons(SB_TFTP_OACK);
+		len = 2 + sprintf((char *)data + 2, "tsize%c%d", 0,
+				  tftp_file_size) + 1;
+	} else {
+		offset = (priv->tftp_block - 1) * SB_TFTP_BLOCK_SIZE;
+		len = min(SB_TFTP_BLOCK_SIZE, tftp_file_size - offset);
+		*(__be16 *)data = htons(SB_TFTP_DATA);
+		*(__be16 *)(data + 2) = htons(priv->tftp_block);
+		for (i = 0; i < len; i++)
+			data[4 + i] = (offset + i) % 251;
+		len += 4;
+	}
+
+	memcpy(eth->et_dest, priv->tftp_client_hwaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+
+	net_set_ip_header((uchar *)ip, priv->tftp_client_ipaddr,
+			  priv->fake_host_ipaddr);
+	ip->ip_len = htons(IP_UDP_HDR_SIZE + len);
+	ip->ip_p = IPPROTO_UDP;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+	ip->udp_src = htons(SB_TFTP_DATA_PORT);
+	ip->udp_dst = htons(priv->tftp_client_port);
+	ip->udp_len = htons(UDP_HDR_SIZE + len);
+	ip->udp_xsum = 0;
+
+	/* Give the data a checksum, so that receiving it checks that too */
+	ph.src = priv->fake_host_ipaddr;
+	ph.dest = priv->tftp_client_ipaddr;
+	ph.zero = 0;
+	ph.proto = IPPROTO_UDP;
+	ph.len = ip->udp_len;
+	sum = compute_ip_checksum(&ip->udp_src, UDP_HDR_SIZE + len);
+	ip->udp_xsum = add_ip_checksums(sizeof(ph),
+					compute_ip_checksum(&ph, sizeof(ph)),
+					sum);
+
+	priv->recv_packet_length = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	priv->tftp_pending = false;
+	if (priv->tftp_block <= tftp_last_sent)
+		tftp_resent++;
+	tftp_last_sent = priv->tftp_block;
+}
+
 static int sb_eth_send(struct udevice *dev, void *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -147,6 +290,8 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 
 				priv->recv_packet_length = length;
 			}
+		} else if (ip->ip_p == IPPROTO_UDP && tftp_file_size) {
+			sb_tftp_request(priv, packet);
 		}
 	}
 
@@ -162,6 +307,9 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		skip_timeout = false;
 	}
 
+	if (!priv->recv_packet_length && priv->tftp_pending)
+		sb_tftp_reply(priv);
+
 	if (priv->recv_packet_length) {
 		int lcl_recv_packet_length = priv->recv_packet_length;
 
@@ -174,6 +322,23 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 	return 0;
 }
 
+static int sb_eth_recv_split(struct udevice *dev, int flags, uchar **packetp,
+			     const struct eth_rx_split *split)
+{
+	int length = sb_eth_recv(dev, flags, packetp);
+
+	/* Like a device scattering the packet, leave no data in the buffer */
+	if (length > split->hdr_len && length <= split->hdr_len + split->len) {
+		memcpy(split->dst, *packetp + split->hdr_len,
+		       length - split->hdr_len);
+		memset(*packetp + split->hdr_len, '\0',
+		       length - split->hdr_len);
+		tftp_placed++;
+	}
+
+	return length;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
 	debug("eth_sandbox: Stop\n");
@@ -192,6 +357,7 @@ static const struct eth_ops sb_eth_ops = {
 	.start			= sb_eth_start,
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
+	.recv_split		= sb_eth_recv_split,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
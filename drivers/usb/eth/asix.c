@@ -86,6 +86,8 @@
 #define USB_BULK_RECV_TIMEOUT 5000
 
 #define AX_RX_URB_SIZE 2048
+/* Room for a frame carried over from one transfer plus the next transfer */
+#define AX_RX_BUF_SIZE (3 * AX_RX_URB_SIZE)
 #define PHY_CONNECT_TIMEOUT 5000
 
 /* asix_flags defines */
@@ -759,34 +761,21 @@ int asix_eth_send(struct udevice *dev, void *packet, int length)
 	return asix_send_common(&priv->ueth, packet, length);
 }
 
-int asix_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+/*
+ * Check the frame at @ptr, returning its length, -EAGAIN if only part of it
+ * has arrived or -EINVAL if it is malformed
+ */
+static int asix_rx_frame_len(const uint8_t *ptr, int len)
 {
-	struct asix_private *priv = dev_get_priv(dev);
-	struct ueth_data *ueth = &priv->ueth;
-	uint8_t *ptr;
-	int ret, len;
 	u32 packet_len;
 
-	len = usb_ether_get_rx_bytes(ueth, &ptr);
-	debug("%s: first try, len=%d\n", __func__, len);
-	if (!len) {
-		if (!(flags & ETH_RECV_CHECK_DEVICE))
-			return -EAGAIN;
-		ret = usb_ether_receive(ueth, AX_RX_URB_SIZE);
-		if (ret == -EAGAIN)
-			return ret;
-
-		len = usb_ether_get_rx_bytes(ueth, &ptr);
-		debug("%s: second try, len=%d\n", __func__, len);
-	}
-
 	/*
 	 * 1st 4 bytes contain the length of the actual data as two
 	 * complementary 16-bit words. Extract the length of the data.
 	 */
 	if (len < sizeof(packet_len)) {
 		debug("Rx: incomplete packet length\n");
-		goto err;
+		return -EAGAIN;
 	}
 	memcpy(&packet_len, ptr, sizeof(packet_len));
 	le32_to_cpus(&packet_len);
@@ -794,16 +783,51 @@ int asix_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("Rx: malformed packet length: %#x (%#x:%#x)\n",
 		      packet_len, (~packet_len >> 16) & 0x7ff,
 		      packet_len & 0x7ff);
-		goto err;
+		return -EINVAL;
 	}
 	packet_len = packet_len & 0x7ff;
 	if (packet_len > len - sizeof(packet_len)) {
-		debug("Rx: too large packet: %d\n", packet_len);
-		goto err;
+		debug("Rx: incomplete packet: %d\n", packet_len);
+		return -EAGAIN;
 	}
 
-	*packetp = ptr + sizeof(packet_len);
 	return packet_len;
+}
+
+int asix_eth_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+	struct asix_private *priv = dev_get_priv(dev);
+	struct ueth_data *ueth = &priv->ueth;
+	uint8_t *ptr = NULL;
+	int ret, len;
+
+	len = usb_ether_get_rx_bytes(ueth, &ptr);
+	debug("%s: first try, len=%d\n", __func__, len);
+	ret = asix_rx_frame_len(ptr, len);
+	if (ret == -EAGAIN) {
+		/*
+		 * The device fills each transfer, so a frame may continue in
+		 * the next one. Keep what has arrived and receive after it.
+		 */
+		if (!(flags & ETH_RECV_CHECK_DEVICE))
+			return -EAGAIN;
+		ret = usb_ether_receive_more(ueth, AX_RX_URB_SIZE);
+		if (ret == -EAGAIN)
+			return ret;
+		if (ret)
+			goto err;
+
+		len = usb_ether_get_rx_bytes(ueth, &ptr);
+		debug("%s: second try, len=%d\n", __func__, len);
+		ret = asix_rx_frame_len(ptr, len);
+		if (ret == -EAGAIN)
+			return ret;
+	}
+	if (ret < 0)
+		goto err;
+
+	*packetp = ptr + sizeof(u32);
+	return ret;
 
 err:
 	usb_ether_advance_rxbuf(ueth, -1);
@@ -840,7 +864,7 @@ static int asix_eth_probe(struct udevice *dev)
 	int ret;
 
 	priv->flags = dev->driver_data;
-	ret = usb_ether_register(dev, ss, AX_RX_URB_SIZE);
+	ret = usb_ether_register(dev, ss, AX_RX_BUF_SIZE);
 	if (ret)
 		return ret;
 
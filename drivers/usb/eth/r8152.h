@@ -455,7 +455,7 @@
 #define BYTE_EN_END_MASK	0xf0
 
 #define RTL8152_ETH_FRAME_LEN	1514
-#define RTL8152_AGG_BUF_SZ	2048
+#define RTL8152_AGG_BUF_SZ	16384
 
 #define RTL8152_RMS		(RTL8152_ETH_FRAME_LEN + CRC_SIZE)
 #define RTL8153_RMS		(RTL8152_ETH_FRAME_LEN + CRC_SIZE)
@@ -93,16 +93,17 @@ int usb_ether_deregister(struct ueth_data *ueth)
 	return 0;
 }
 
-int usb_ether_receive(struct ueth_data *ueth, int rxsize)
+/* Receive up to @rxsize bytes into the buffer at offset @start */
+static int usb_ether_receive_at(struct ueth_data *ueth, int start, int rxsize)
 {
 	int actual_len;
 	int ret;
 
-	if (rxsize > ueth->rxsize)
+	if (start + rxsize > ueth->rxsize)
 		return -EINVAL;
 	ret = usb_bulk_msg(ueth->pusb_dev,
 			   usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in),
-			   ueth->rxbuf, rxsize, &actual_len,
+			   ueth->rxbuf + start, rxsize, &actual_len,
 			   USB_BULK_RECV_TIMEOUT);
 	debug("Rx: len = %u, actual = %u, err = %d\n", rxsize, actual_len, ret);
 	if (ret) {
@@ -113,12 +114,37 @@ int usb_ether_receive(struct ueth_data *ueth, int rxsize)
 		debug("Rx: received too many bytes %d\n", actual_len);
 		return -ENOSPC;
 	}
-	ueth->rxlen = actual_len;
-	ueth->rxptr = 0;
+	ueth->rxlen += actual_len;
 
 	return actual_len ? 0 : -EAGAIN;
 }
 
+int usb_ether_receive(struct ueth_data *ueth, int rxsize)
+{
+	ueth->rxlen = 0;
+	ueth->rxptr = 0;
+
+	return usb_ether_receive_at(ueth, 0, rxsize);
+}
+
+int usb_ether_receive_more(struct ueth_data *ueth, int rxsize)
+{
+	int left = ueth->rxlen ? ueth->rxlen - ueth->rxptr : 0;
+	int start = roundup(left, ARCH_DMA_MINALIGN);
+
+	if (start + rxsize > ueth->rxsize) {
+		debug("Rx: no room after %d bytes held\n", left);
+		return -ENOSPC;
+	}
+
+	/* Keep what is held just before the aligned start of the transfer */
+	memmove(ueth->rxbuf + start - left, ueth->rxbuf + ueth->rxptr, left);
+	ueth->rxptr = start - left;
+	ueth->rxlen = start;
+
+	return usb_ether_receive_at(ueth, start, rxsize);
+}
+
 void usb_ether_advance_rxbuf(struct ueth_data *ueth, int num_bytes)
 {
 	ueth->rxptr += num_bytes;
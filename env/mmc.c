@@ -138,7 +138,10 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	blk_start	= ALIGN(offset, mmc->write_bl_len) / mmc->write_bl_len;
 	blk_cnt		= ALIGN(size, mmc->write_bl_len) / mmc->write_bl_len;
 
+	/* Don't let a power cut leave a half-written environment behind */
+	mmc_set_reliable_write(mmc, true);
 	n = blk_dwrite(desc, blk_start, blk_cnt, (u_char *)buffer);
+	mmc_set_reliable_write(mmc, false);
 
 	return (n == blk_cnt) ? 0 : -1;
 }
@@ -29,6 +29,7 @@
 #include <fs_internal.h>
 #include <ext4fs.h>
 #include <ext_common.h>
+#include <fs.h>
 #include "ext4_common.h"
 
 lbaint_t part_offset;
@@ -39,6 +40,9 @@ static disk_partition_t *part_info;
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info)
 {
 	assert(rbdd->blksz == (1 << rbdd->log2blksz));
+	/* Drop any mount the generic layer kept of the previous device */
+	fs_umount();
+	ext4fs_extmap_free();
 	ext4fs_blk_desc = rbdd;
 	get_fs()->dev_desc = rbdd;
 	part_info = info;
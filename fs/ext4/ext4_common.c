@@ -1513,43 +1513,206 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
-static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+/*
+ * Extent map cache
+ *
+ * The leaves of the extent tree of the most recently looked up inode are
+ * flattened into a sorted array, so that mapping a file block costs a
+ * binary search instead of a walk (and re-read) of the on-disk tree.  The
+ * cache is keyed on the device, the partition, the inode number (0 where
+ * the caller does not know it) and the 60 byte tree root stored in the
+ * inode.  It is dropped whenever another filesystem is set up, and by
+ * ext4fs_reinit_global().
+ */
+#define EXT4_EXT_MAX_DEPTH	5
+#define EXT4_EXT_INIT_MAX_LEN	32768
+
+struct ext4_extent_map {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block, 0 if unwritten */
+};
+
+static struct ext4_extent_map *ext4fs_extmap;
+static int ext4fs_extmap_count;
+static int ext4fs_extmap_size;
+static int ext4fs_extmap_valid;
+static struct blk_desc *ext4fs_extmap_dev;
+static lbaint_t ext4fs_extmap_start;
+static int ext4fs_extmap_ino;
+static char ext4fs_extmap_root[sizeof(((struct ext2_inode *)0)->b)];
+
+void ext4fs_extmap_free(void)
+{
+	free(ext4fs_extmap);
+	ext4fs_extmap = NULL;
+	ext4fs_extmap_count = 0;
+	ext4fs_extmap_size = 0;
+	ext4fs_extmap_valid = 0;
+}
+
+static int ext4fs_extmap_add(struct ext4_extent *extent)
+{
+	struct ext4_extent_map *map;
+	unsigned int len = le16_to_cpu(extent->ee_len);
+	uint64_t start;
+
+	if (ext4fs_extmap_count == ext4fs_extmap_size) {
+		int size = ext4fs_extmap_size ? ext4fs_extmap_size * 2 : 16;
+
+		map = realloc(ext4fs_extmap, size * sizeof(*map));
+		if (!map)
+			return -ENOMEM;
+		ext4fs_extmap = map;
+		ext4fs_extmap_size = size;
+	}
+
+	start = le16_to_cpu(extent->ee_start_hi);
+	start = (start << 32) + le32_to_cpu(extent->ee_start_lo);
+	/* Unwritten (preallocated) extents read back as zeroes */
+	if (len > EXT4_EXT_INIT_MAX_LEN) {
+		len -= EXT4_EXT_INIT_MAX_LEN;
+		start = 0;
+	}
+
+	map = &ext4fs_extmap[ext4fs_extmap_count];
+	map->lblk = le32_to_cpu(extent->ee_block);
+	map->len = len;
+	map->pblk = start;
+	if (ext4fs_extmap_count &&
+	    map->lblk < map[-1].lblk + map[-1].len)
+		return -EINVAL;
+	ext4fs_extmap_count++;
+
+	return 0;
+}
+
+static int ext4fs_extmap_walk(struct ext4_extent_header *ext_block, int depth)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
-	int i;
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	char *buf;
+	int i, ret;
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth ||
+	    depth > EXT4_EXT_MAX_DEPTH)
+		return -EINVAL;
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return NULL;
+	if (depth == 0) {
+		struct ext4_extent *extent;
 
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries; i++) {
+			ret = ext4fs_extmap_add(&extent[i]);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
 
-		if (--i < 0)
-			return NULL;
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
 
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < entries; i++) {
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			free(buf);
+			return -EIO;
+		}
+		ret = ext4fs_extmap_walk((struct ext4_extent_header *)buf,
+					 depth - 1);
+		if (ret) {
+			free(buf);
+			return ret;
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+
+static int ext4fs_extmap_load(struct ext2_inode *inode, int ino)
+{
+	struct blk_desc *dev = get_fs()->dev_desc;
+	struct ext4_extent_header *root;
+	int ret;
+
+	if (ext4fs_extmap_valid && ext4fs_extmap_dev == dev &&
+	    ext4fs_extmap_start == part_offset && ext4fs_extmap_ino == ino &&
+	    !memcmp(ext4fs_extmap_root, &inode->b, sizeof(ext4fs_extmap_root)))
+		return 0;
+
+	ext4fs_extmap_valid = 0;
+	ext4fs_extmap_count = 0;
+	root = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	ret = ext4fs_extmap_walk(root, le16_to_cpu(root->eh_depth));
+	if (ret)
+		return ret;
+
+	ext4fs_extmap_dev = dev;
+	ext4fs_extmap_start = part_offset;
+	ext4fs_extmap_ino = ino;
+	memcpy(ext4fs_extmap_root, &inode->b, sizeof(ext4fs_extmap_root));
+	ext4fs_extmap_valid = 1;
+
+	return 0;
+}
+
+/*
+ * Map @fileblock of extent-mapped inode @ino.  Returns the physical block
+ * (0 for a hole or an unwritten extent) and stores the number of following
+ * blocks, including @fileblock, that map the same way into @count.
+ */
+static long int ext4fs_extmap_lookup(struct ext2_inode *inode, int ino,
+				     int fileblock, int *count)
+{
+	struct ext4_extent_map *map;
+	uint32_t lblk = fileblock;
+	int lo, hi, mid;
+
+	if (ext4fs_extmap_load(inode, ino)) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	/* Find the last extent starting at or before lblk */
+	lo = 0;
+	hi = ext4fs_extmap_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ext4fs_extmap[mid].lblk <= lblk)
+			lo = mid + 1;
 		else
-			return NULL;
+			hi = mid;
+	}
+
+	if (lo > 0) {
+		map = &ext4fs_extmap[lo - 1];
+		if (lblk - map->lblk < map->len) {
+			*count = map->len - (lblk - map->lblk);
+			if (!map->pblk)
+				return 0;
+			return map->pblk + (lblk - map->lblk);
+		}
 	}
+
+	/* Sparse file */
+	if (lo < ext4fs_extmap_count)
+		*count = ext4fs_extmap[lo].lblk - lblk;
+	else
+		*count = INT_MAX;
+
+	return 0;
 }
 
 static int ext4fs_blockgroup
@@ -1614,53 +1777,15 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
+		int count;
 
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		free(buf);
-		return 0;
+		return ext4fs_extmap_lookup(inode, 0, fileblock, &count);
 	}
 
 	/* Direct blocks. */
@@ -1948,6 +2073,30 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	return blknr;
 }
 
+/**
+ * read_allocated_extent() - map a run of file blocks
+ *
+ * @node:	the file
+ * @fileblock:	first logical block to map
+ * @count:	returns the number of blocks, starting at @fileblock, that are
+ *		physically contiguous (or all holes)
+ *
+ * Like read_allocated_block(), but lets callers walk an extent-mapped file
+ * one extent at a time. Block-mapped inodes always return a count of 1.
+ *
+ * Return: first physical block, 0 for a hole, negative on error
+ */
+long int read_allocated_extent(struct ext2fs_node *node, int fileblock,
+			       int *count)
+{
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_extmap_lookup(&node->inode, node->ino, fileblock,
+					    count);
+
+	*count = 1;
+	return read_allocated_block(&node->inode, fileblock);
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -1962,6 +2111,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_extmap_free();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -1995,6 +2145,291 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/*
+ * Allocate the node for a directory entry and work out its type, reading
+ * the inode if the entry does not record the file type.
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *diro,
+					      struct ext2_dirent *dirent,
+					      int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = diro->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+	*ftype = FILETYPE_UNKNOWN;
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			*ftype = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			*ftype = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			*ftype = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data,
+					   le32_to_cpu(dirent->inode),
+					   &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
+		}
+		fdiro->inode_read = 1;
+
+		if ((le16_to_cpu(fdiro->inode.mode) &
+		     FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY)
+			*ftype = FILETYPE_DIRECTORY;
+		else if ((le16_to_cpu(fdiro->inode.mode) &
+			  FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK)
+			*ftype = FILETYPE_SYMLINK;
+		else if ((le16_to_cpu(fdiro->inode.mode) &
+			  FILETYPE_INO_MASK) == FILETYPE_INO_REG)
+			*ftype = FILETYPE_REG;
+	}
+
+	return fdiro;
+}
+
+/* One level of the path from the htree root down to a leaf */
+struct ext4fs_dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	int count;
+	int at;
+};
+
+static int ext4fs_dx_read_block(struct ext2fs_node *diro, uint32_t lblk,
+				char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	int log2_blksz = LOG2_BLOCK_SIZE(diro->data)
+		- get_fs()->dev_desc->log2blksz;
+	long int blknr;
+
+	if ((loff_t)lblk * blksz >= le32_to_cpu(diro->inode.size))
+		return -EINVAL;
+
+	blknr = read_allocated_block(&diro->inode, lblk);
+	if (blknr <= 0)
+		return -EINVAL;
+
+	if (!ext4fs_devread((lbaint_t)blknr << log2_blksz, 0, blksz, buf))
+		return -EIO;
+
+	return 0;
+}
+
+/* Check the limit/count header of an index block's entry array */
+static int ext4fs_dx_frame_init(struct ext4fs_dx_frame *frame,
+				struct dx_entry *entries, int blksz)
+{
+	struct dx_countlimit *cl = (struct dx_countlimit *)entries;
+	int count = le16_to_cpu(cl->count);
+	int limit = le16_to_cpu(cl->limit);
+
+	if (!count || count > limit ||
+	    (char *)(entries + limit) > frame->buf + blksz)
+		return -EINVAL;
+
+	frame->entries = entries;
+	frame->count = count;
+	frame->at = 0;
+
+	return 0;
+}
+
+/* Read the child block of the current entry of frame[0] into frame[1] */
+static int ext4fs_dx_descend(struct ext2fs_node *diro,
+			     struct ext4fs_dx_frame *frame, int blksz)
+{
+	uint32_t block;
+	int ret;
+
+	block = le32_to_cpu(frame[0].entries[frame[0].at].block) & 0x0fffffff;
+	if (!frame[1].buf) {
+		frame[1].buf = zalloc(blksz);
+		if (!frame[1].buf)
+			return -ENOMEM;
+	}
+
+	ret = ext4fs_dx_read_block(diro, block, frame[1].buf);
+	if (ret)
+		return ret;
+
+	/* Interior nodes start with an empty dirent covering the block */
+	return ext4fs_dx_frame_init(&frame[1], (struct dx_entry *)
+				    (frame[1].buf + sizeof(struct ext2_dirent)),
+				    blksz);
+}
+
+/* Search one leaf block; returns 1 if found, 0 if not, <0 on error */
+static int ext4fs_dx_search_leaf(struct ext2fs_node *diro, char *buf,
+				 int blksz, const char *name,
+				 struct ext2fs_node **fnode, int *ftype)
+{
+	int namelen = strlen(name);
+	struct ext2_dirent *dirent;
+	unsigned int off = 0;
+	unsigned int reclen;
+
+	while (off + sizeof(struct ext2_dirent) <= blksz) {
+		dirent = (struct ext2_dirent *)(buf + off);
+		reclen = le16_to_cpu(dirent->direntlen);
+		if (reclen < sizeof(struct ext2_dirent) ||
+		    off + reclen > blksz ||
+		    dirent->namelen > reclen - sizeof(struct ext2_dirent))
+			return -EINVAL;
+
+		if (dirent->inode && dirent->namelen == namelen &&
+		    !memcmp(dirent + 1, name, namelen)) {
+			*fnode = ext4fs_dirent_node(diro, dirent, ftype);
+			return *fnode ? 1 : -EIO;
+		}
+		off += reclen;
+	}
+
+	return 0;
+}
+
+/*
+ * Move to the next leaf if it may hold more names with the same hash,
+ * i.e. if the next index entry carries the hash with the collision bit
+ * set. Returns 1 if the frames now point at that leaf, 0 if not.
+ */
+static int ext4fs_dx_next(struct ext2fs_node *diro,
+			  struct ext4fs_dx_frame *frames, int levels,
+			  uint32_t hash, int blksz)
+{
+	uint32_t bhash;
+	int i, ret;
+
+	for (i = levels; frames[i].at + 1 >= frames[i].count; i--) {
+		if (i == 0)
+			return 0;
+	}
+
+	frames[i].at++;
+	bhash = le32_to_cpu(frames[i].entries[frames[i].at].hash);
+	if ((bhash & ~1) != hash)
+		return 0;
+
+	for (; i < levels; i++) {
+		ret = ext4fs_dx_descend(diro, &frames[i], blksz);
+		if (ret)
+			return ret;
+	}
+
+	return 1;
+}
+
+/*
+ * Look a name up in an htree indexed directory, reading only the index
+ * blocks on the way to the leaf the name hashes to. Returns 1 if found,
+ * 0 if not, or a negative error if the index cannot be used and the caller
+ * should scan the directory instead.
+ */
+static int ext4fs_dx_find(struct ext2fs_node *diro, const char *name,
+			  struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext2_sblock *sblock = &diro->data->sblock;
+	struct ext4fs_dx_frame frames[EXT4_HTREE_LEVEL];
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	struct ext4fs_dx_frame *frame;
+	struct ext2_dirent *dot;
+	struct dx_root_info *info;
+	uint32_t seed[4], hash, block;
+	int levels, version;
+	char *leaf;
+	int i, ret, lo, hi, mid;
+
+	memset(frames, 0, sizeof(frames));
+	leaf = zalloc(blksz);
+	frames[0].buf = zalloc(blksz);
+	if (!leaf || !frames[0].buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = ext4fs_dx_read_block(diro, 0, frames[0].buf);
+	if (ret)
+		goto out;
+
+	/* The root info follows the fixed-size "." and ".." entries */
+	dot = (struct ext2_dirent *)frames[0].buf;
+	info = (struct dx_root_info *)(frames[0].buf + 24);
+	if (le16_to_cpu(dot->direntlen) != 12 || info->reserved_zero ||
+	    info->info_length != sizeof(*info) ||
+	    info->indirect_levels >= EXT4_HTREE_LEVEL) {
+		ret = -EINVAL;
+		goto out;
+	}
+	levels = info->indirect_levels;
+
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    (le32_to_cpu(sblock->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	for (i = 0; i < 4; i++)
+		seed[i] = le32_to_cpu(sblock->hash_seed[i]);
+	ret = ext4fs_dirhash(name, strlen(name), version, seed, &hash);
+	if (ret)
+		goto out;
+
+	ret = ext4fs_dx_frame_init(&frames[0], (struct dx_entry *)
+				   ((char *)info + info->info_length), blksz);
+	for (i = 0; !ret; i++) {
+		/* Find the last entry whose hash is not above ours */
+		frame = &frames[i];
+		lo = 1;
+		hi = frame->count - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			if (le32_to_cpu(frame->entries[mid].hash) > hash)
+				hi = mid - 1;
+			else
+				lo = mid + 1;
+		}
+		frame->at = lo - 1;
+
+		if (i == levels)
+			break;
+		ret = ext4fs_dx_descend(diro, frame, blksz);
+	}
+
+	while (!ret) {
+		frame = &frames[levels];
+		block = le32_to_cpu(frame->entries[frame->at].block) &
+			0x0fffffff;
+		ret = ext4fs_dx_read_block(diro, block, leaf);
+		if (ret)
+			break;
+
+		ret = ext4fs_dx_search_leaf(diro, leaf, blksz, name, fnode,
+					    ftype);
+		if (ret)
+			break;
+
+		ret = ext4fs_dx_next(diro, frames, levels, hash, blksz);
+		if (ret <= 0)
+			break;
+		ret = 0;
+	}
+
+out:
+	for (i = 0; i < EXT4_HTREE_LEVEL; i++)
+		free(frames[i].buf);
+	free(leaf);
+
+	return ret;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2012,7 +2447,17 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
-	/* Search the file.  */
+	/* Use the hash index if there is one, otherwise search the file */
+	if (name && fnode && ftype &&
+	    (le32_to_cpu(diro->data->sblock.feature_compatibility) &
+	     EXT4_FEATURE_COMPAT_DIR_INDEX) &&
+	    (le32_to_cpu(diro->inode.flags) & EXT4_INDEX_FL)) {
+		status = ext4fs_dx_find(diro, name, fnode, ftype);
+		if (status >= 0)
+			return status;
+		debug("htree lookup of %s failed, scanning directory\n", name);
+	}
+
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
 
@@ -2030,7 +2475,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (dirent.namelen != 0) {
 			char filename[dirent.namelen + 1];
 			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
+			int type;
 
 			status = ext4fs_read_file(diro,
 						  fpos +
@@ -2040,49 +2485,11 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
 			if (!fdiro)
 				return 0;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
-
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
@@ -2294,7 +2701,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* The mount may outlive a file opened by an earlier command */
+	if (ext4fs_file != NULL) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2321,6 +2732,8 @@ int ext4fs_mount(unsigned part_length)
 	struct ext2_data *data;
 	int status;
 	struct ext_filesystem *fs = get_fs();
+
+	ext4fs_extmap_free();
 	data = zalloc(SUPERBLOCK_SIZE);
 	if (!data)
 		return 0;
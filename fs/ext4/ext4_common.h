@@ -70,6 +70,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index);
 int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index);
 void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index);
 int ext4fs_iget(int inode_no, struct ext2_inode *inode);
+void ext4fs_extmap_free(void);
 void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block);
@@ -50,11 +50,13 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	int i, count;
 	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
+	/* Keep the byte length of a single read within an int */
+	int maxrun = 1 << (30 - log2_fs_blocksize - log2blksz);
 	unsigned int filesize = le32_to_cpu(node->inode.size);
 	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
@@ -70,38 +72,44 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
+	/* Walk the file one run of contiguous (or sparse) blocks at a time */
+	for (i = lldiv(pos, blocksize); i < blockcnt; i += count) {
 		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
+		loff_t runstart = (loff_t)i * blocksize;
+		loff_t runend;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
+		int blockend;
+
+		blknr = read_allocated_extent(node, i, &count);
 		if (blknr < 0)
 			return -1;
 
+		if (count > blockcnt - i)
+			count = blockcnt - i;
+		if (count > maxrun)
+			count = maxrun;
+
 		blknr = blknr << log2_fs_blocksize;
 
 		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		runend = runstart + ((loff_t)count * blocksize);
+		if (runend > len + pos)
+			runend = len + pos;
 
 		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		if (runstart < pos)
+			skipfirst = pos - runstart;
+		blockend = runend - runstart - skipfirst;
+
 		if (blknr) {
 			int status;
 
 			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
+				if (delayed_next == blknr &&
+				    delayed_extent + blockend <= INT_MAX) {
 					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
+					delayed_next += count <<
+						log2_fs_blocksize;
 				} else {	/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -115,7 +123,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 					delayed_skipfirst = skipfirst;
 					delayed_buf = buf;
 					delayed_next = blknr +
-						(blockend >> log2blksz);
+						(count << log2_fs_blocksize);
 				}
 			} else {
 				previous_block_number = blknr;
@@ -124,7 +132,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
 				delayed_next = blknr +
-					(blockend >> log2blksz);
+					(count << log2_fs_blocksize);
 			}
 		} else {
 			if (previous_block_number != -1) {
@@ -137,9 +145,9 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 					return -1;
 				previous_block_number = -1;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, blockend);
 		}
-		buf += blocksize - skipfirst;
+		buf += blockend;
 	}
 	if (previous_block_number != -1) {
 		/* spill */
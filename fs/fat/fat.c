@@ -44,6 +44,15 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static disk_partition_t cur_part_info;
 
+/*
+ * Filesystem parameters and FAT cache of the mounted volume, kept from one
+ * command to the next until fat_close(). They are lent to one user at a
+ * time; anyone else gets a private copy read from the disk.
+ */
+static fsdata fat_mount;
+static int fat_mounted;
+static int fat_mount_busy;
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -67,6 +76,10 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	/* Whatever was mounted before goes away with the old device */
+	fs_umount();
+	fat_close();
+
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -97,6 +110,8 @@ int fat_register_device(struct blk_desc *dev_desc, int part_no)
 	disk_partition_t info;
 
 	/* First close any currently found FAT filesystem */
+	fs_umount();
+	fat_close();
 	cur_dev = NULL;
 
 	/* Read the partition table, if present */
@@ -151,16 +166,100 @@ static void get_name(dir_entry *dirent, char *s_name)
 		*s_name = DELETED_FLAG;
 }
 
-static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int win);
 #if !defined(CONFIG_FAT_WRITE)
 /* Stub for read only operation */
-int flush_dirty_fat_buffer(fsdata *mydata)
+int flush_fat_window(fsdata *mydata, int win)
 {
 	(void)(mydata);
+	(void)(win);
 	return 0;
 }
 #endif
 
+/*
+ * Allocate the FAT cache. Tables no larger than FATCACHEWINDOWS windows
+ * get one window per FATBUFBLOCKS sectors and end up cached as a whole.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_init(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbufwins = DIV_ROUND_UP(mydata->fatlength, FATBUFBLOCKS);
+	if (mydata->fatbufwins > FATCACHEWINDOWS || !mydata->fatbufwins)
+		mydata->fatbufwins = FATCACHEWINDOWS;
+
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		mydata->fatbufnum[i] = -1;
+		mydata->fat_dirty[i] = 0;
+		mydata->fatbuflru[i] = 0;
+	}
+	mydata->fatbuftick = 0;
+	mydata->fatbufcur = 0;
+	mydata->freemap = NULL;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * mydata->fatbufwins);
+	if (mydata->fatbuf == NULL) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Return the buffer holding FAT window 'bufnum', reading it into the
+ * least recently used slot of the cache if it is not present. The slot
+ * index is stored in *winp when winp is not NULL.
+ * Return NULL on failure.
+ */
+static __u8 *get_fat_window(fsdata *mydata, __u32 bufnum, int *winp)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 fatlength = mydata->fatlength;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, win = mydata->fatbufcur;
+
+	if (mydata->fatbufnum[win] != bufnum) {
+		for (i = 0; i < mydata->fatbufwins; i++) {
+			if (mydata->fatbufnum[i] == bufnum)
+				break;
+			if (mydata->fatbuflru[i] < mydata->fatbuflru[win])
+				win = i;
+		}
+		if (i < mydata->fatbufwins)
+			win = i;
+	}
+
+	if (mydata->fatbufnum[win] != bufnum) {
+		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		if (startblock + getsize > fatlength)
+			getsize = fatlength - startblock;
+
+		startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+		/* Write back the evicted window to the disk */
+		if (flush_fat_window(mydata, win) < 0)
+			return NULL;
+
+		mydata->fatbufnum[win] = -1;
+		if (disk_read(startblock, getsize,
+			      mydata->fatbuf + win * FATBUFSIZE) < 0) {
+			debug("Error reading FAT blocks\n");
+			return NULL;
+		}
+		mydata->fatbufnum[win] = bufnum;
+	}
+
+	mydata->fatbuflru[win] = ++mydata->fatbuftick;
+	mydata->fatbufcur = win;
+	if (winp)
+		*winp = win;
+
+	return mydata->fatbuf + win * FATBUFSIZE;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -170,6 +269,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		printf("Error: Invalid FAT entry: 0x%08x\n", entry);
@@ -198,42 +298,23 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Read a new block of FAT entries into the cache if needed. */
+	fatbuf = get_fat_window(mydata, bufnum, NULL);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -551,12 +632,23 @@ exit:
 	return ret;
 }
 
+/*
+ * Fill in the filesystem parameters, handing out the mounted volume's
+ * copy and FAT cache when they are free. Release with put_fs_info().
+ * Return 0 on success.
+ */
 static int get_fs_info(fsdata *mydata)
 {
 	boot_sector bs;
 	volume_info volinfo;
 	int ret;
 
+	if (fat_mounted && !fat_mount_busy) {
+		*mydata = fat_mount;
+		fat_mount_busy = 1;
+		return 0;
+	}
+
 	ret = read_bootsectandvi(&bs, &volinfo, &mydata->fatsize);
 	if (ret) {
 		debug("Error: reading boot sector\n");
@@ -597,13 +689,8 @@ static int get_fs_info(fsdata *mydata)
 			sect_to_clust(mydata, mydata->rootdir_sect);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	if (fat_cache_init(mydata))
 		return -1;
-	}
 
 	if (vfat_enabled)
 		debug("VFAT Support enabled\n");
@@ -618,9 +705,31 @@ static int get_fs_info(fsdata *mydata)
 	debug("Sector size: %d, cluster size: %d\n", mydata->sect_size,
 	      mydata->clust_size);
 
+	if (!fat_mounted) {
+		fat_mount = *mydata;
+		fat_mounted = 1;
+		fat_mount_busy = 1;
+	}
+
 	return 0;
 }
 
+/*
+ * Hand back parameters obtained from get_fs_info(), keeping the state of
+ * the FAT cache for the next user if they belong to the mounted volume.
+ */
+static void put_fs_info(fsdata *mydata)
+{
+	if (fat_mounted && fat_mount_busy &&
+	    mydata->fatbuf == fat_mount.fatbuf) {
+		fat_mount = *mydata;
+		fat_mount_busy = 0;
+		return;
+	}
+
+	free(mydata->fatbuf);
+}
+
 
 /*
  * Directory iterator, to simplify filesystem traversal
@@ -1046,7 +1155,7 @@ int fat_exists(const char *filename)
 		goto out;
 
 	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	put_fs_info(&fsdata);
 out:
 	free(itr);
 	return ret == 0;
@@ -1071,7 +1180,7 @@ int fat_size(const char *filename, loff_t *size)
 		 * Directories don't have size, but fs_size() is not
 		 * expected to fail if passed a directory path:
 		 */
-		free(fsdata.fatbuf);
+		put_fs_info(&fsdata);
 		fat_itr_root(itr, &fsdata);
 		if (!fat_itr_resolve(itr, filename, TYPE_DIR)) {
 			*size = 0;
@@ -1082,7 +1191,7 @@ int fat_size(const char *filename, loff_t *size)
 
 	*size = FAT2CPU32(itr->dent->size);
 out_free_both:
-	free(fsdata.fatbuf);
+	put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1110,7 +1219,7 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	ret = get_contents(&fsdata, itr->dent, pos, buffer, maxsize, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1167,7 +1276,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	put_fs_info(&dir->fsdata);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1199,12 +1308,17 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	put_fs_info(&dir->fsdata);
 	free(dir);
 }
 
 void fat_close(void)
 {
+	/* A volume still lent out is freed when it is handed back */
+	if (fat_mounted && !fat_mount_busy)
+		free(fat_mount.fatbuf);
+	fat_mounted = 0;
+	fat_mount_busy = 0;
 }
 
 #define BYTE_PER_SEC	512
@@ -102,42 +102,64 @@ static void set_name(dir_entry *dirent, const char *filename)
 
 static __u8 num_of_fats;
 /*
- * Write fat buffer into block device
+ * Write the modified sectors of FAT cache window 'win' into block device,
+ * one write per run of consecutive sectors and per copy of the FAT
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, int win)
 {
-	int getsize = FATBUFBLOCKS;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 dirty = mydata->fat_dirty[win];
+	__u8 *bufptr = mydata->fatbuf + win * FATBUFSIZE;
+	__u32 startblock = mydata->fatbufnum[win] * FATBUFBLOCKS;
+	__u32 first, last;
+	int i;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+	debug("debug: evicting %d, dirty: %08x\n", mydata->fatbufnum[win],
+	      dirty);
 
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
+	if ((!dirty) || (mydata->fatbufnum[win] == -1))
 		return 0;
 
-	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-	if (startblock + getsize > fatlength)
-		getsize = fatlength - startblock;
+	for (first = 0; first < FATBUFBLOCKS; first = last) {
+		if (!(dirty & (1U << first))) {
+			last = first + 1;
+			continue;
+		}
+		for (last = first; last < FATBUFBLOCKS; last++)
+			if (!(dirty & (1U << last)))
+				break;
 
-	startblock += mydata->fat_sect;
+		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		if (startblock + last > fatlength)
+			last = fatlength - startblock;
+		if (last <= first)
+			break;
 
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
+		/* Write the run to every copy of the FAT */
+		for (i = 0; i < num_of_fats; i++) {
+			if (disk_write(mydata->fat_sect + i * fatlength +
+				       startblock + first, last - first,
+				       bufptr + first * mydata->sect_size) < 0) {
+				debug("error: writing FAT %d blocks\n", i + 1);
+				return -1;
+			}
+		}
 	}
+	mydata->fat_dirty[win] = 0;
+
+	return 0;
+}
 
-	if (num_of_fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
+/*
+ * Write all modified FAT cache windows into block device
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int win;
+
+	for (win = 0; win < mydata->fatbufwins; win++)
+		if (flush_fat_window(mydata, win) < 0)
 			return -1;
-		}
-	}
-	mydata->fat_dirty = 0;
 
 	return 0;
 }
@@ -360,13 +382,155 @@ get_long_file_name(fsdata *mydata, int curclust, __u8 *cluster,
 	return 0;
 }
 
+/*
+ * Free cluster bitmap
+ *
+ * Built once from the FAT when writing starts and kept in sync by
+ * set_fatent_value(), so that finding free clusters does not have to
+ * walk the table entry by entry. A set bit marks a cluster in use.
+ */
+static inline int test_freemap(fsdata *mydata, __u32 clust)
+{
+	return mydata->freemap[clust / 32] & (1U << (clust % 32));
+}
+
+static inline void set_freemap(fsdata *mydata, __u32 clust, int used)
+{
+	if (used)
+		mydata->freemap[clust / 32] |= 1U << (clust % 32);
+	else
+		mydata->freemap[clust / 32] &= ~(1U << (clust % 32));
+}
+
+/*
+ * Read the whole FAT in large chunks and build the free cluster bitmap.
+ * Return 0 on success, -1 otherwise.
+ */
+static int build_freemap(fsdata *mydata)
+{
+	__u32 chunk = FATBUFBLOCKS * 8;
+	__u32 entries, entry, sect, nsect, i, val, off8;
+	__u32 words;
+	__u8 *buf;
+
+	/* Entries are bounded by both the data area and the FAT size */
+	mydata->max_clust = (total_sector - mydata->data_begin) /
+			    mydata->clust_size;
+	entries = mydata->fatlength * mydata->sect_size * 8 / mydata->fatsize;
+	if (mydata->max_clust > entries)
+		mydata->max_clust = entries;
+
+	words = DIV_ROUND_UP(mydata->max_clust, 32);
+	mydata->freemap = calloc(words, sizeof(__u32));
+	buf = malloc_cache_aligned(chunk * mydata->sect_size);
+	if (!mydata->freemap || !buf) {
+		debug("Error: allocating memory\n");
+		free(buf);
+		return -1;
+	}
+
+	/* Entries 0 and 1 are reserved, as are bits past the last cluster */
+	set_freemap(mydata, 0, 1);
+	set_freemap(mydata, 1, 1);
+	for (i = mydata->max_clust; i < words * 32; i++)
+		set_freemap(mydata, i, 1);
+
+	entry = 0;
+	for (sect = 0; sect < mydata->fatlength && entry < mydata->max_clust;
+	     sect += nsect) {
+		nsect = min(chunk, mydata->fatlength - sect);
+		if (disk_read(mydata->fat_sect + sect, nsect, buf) < 0) {
+			debug("Error reading FAT blocks\n");
+			free(buf);
+			return -1;
+		}
+
+		entries = nsect * mydata->sect_size * 8 / mydata->fatsize;
+		for (i = 0; i < entries && entry < mydata->max_clust;
+		     i++, entry++) {
+			switch (mydata->fatsize) {
+			case 32:
+				val = FAT2CPU32(((__u32 *)buf)[i]) & 0xfffffff;
+				break;
+			case 16:
+				val = FAT2CPU16(((__u16 *)buf)[i]);
+				break;
+			default:
+				off8 = (i * 3) / 2;
+				val = buf[off8] + (buf[off8 + 1] << 8);
+				if (i & 0x1)
+					val >>= 4;
+				val &= 0xfff;
+				break;
+			}
+			if (val && entry > 1)
+				set_freemap(mydata, entry, 1);
+		}
+	}
+
+	free(buf);
+	return 0;
+}
+
+/*
+ * Find the first free cluster at or after 'start'.
+ * Return 0 if the filesystem is full.
+ */
+static __u32 find_free_clust(fsdata *mydata, __u32 start)
+{
+	__u32 clust;
+
+	for (clust = start; clust < mydata->max_clust; clust++) {
+		/* Skip fully allocated words at once */
+		if (!(clust % 32) && mydata->freemap[clust / 32] == ~0U) {
+			clust += 31;
+			continue;
+		}
+		if (!test_freemap(mydata, clust))
+			return clust;
+	}
+
+	return 0;
+}
+
+/*
+ * Find the start of the first run of at least 'count' free clusters, so
+ * that a file can be laid out contiguously. Fall back to the first free
+ * cluster if there is no such run.
+ * Return 0 if the filesystem is full.
+ */
+static __u32 find_free_extent(fsdata *mydata, __u32 count)
+{
+	__u32 clust, start = 0, run = 0;
+
+	for (clust = 2; clust < mydata->max_clust; clust++) {
+		if (!(clust % 32) && mydata->freemap[clust / 32] == ~0U) {
+			run = 0;
+			clust += 31;
+			continue;
+		}
+		if (test_freemap(mydata, clust)) {
+			run = 0;
+			continue;
+		}
+		if (!run)
+			start = clust;
+		if (++run >= count)
+			return start;
+	}
+
+	return find_free_clust(mydata, 2);
+}
+
 /*
  * Set the entry at index 'entry' in a FAT (12/16/32) table.
  */
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
-	__u32 bufnum, offset, off16;
+	__u32 bufnum, offset, off16, first, last;
 	__u16 val1, val2;
+	__u8 *fatbuf;
+	int win;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -386,39 +550,41 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
+	/* Read a new block of FAT entries into the cache if needed. */
+	fatbuf = get_fat_window(mydata, bufnum, &win);
+	if (!fatbuf)
+		return -1;
 
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
+	/* Mark the sectors holding the entry as dirty */
+	switch (mydata->fatsize) {
+	case 32:
+		first = offset * 4;
+		last = first + 3;
+		break;
+	case 16:
+		first = offset * 2;
+		last = first + 1;
+		break;
+	default:
+		first = ((offset * 3) / 4) * 2;
+		last = first + ((offset & 0x3) == 1 || (offset & 0x3) == 2 ?
+				3 : 1);
+		break;
 	}
+	mydata->fat_dirty[win] |= 1U << (first / mydata->sect_size);
+	mydata->fat_dirty[win] |= 1U << (last / mydata->sect_size);
 
-	/* Mark as dirty */
-	mydata->fat_dirty = 1;
+	/* Keep the free cluster bitmap in sync */
+	if (mydata->freemap && entry < mydata->max_clust)
+		set_freemap(mydata, entry, entry_value != 0);
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
 	case 32:
-		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		((__u32 *)fatbuf)[offset] = cpu_to_le32(entry_value);
 		break;
 	case 16:
-		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		((__u16 *)fatbuf)[offset] = cpu_to_le16(entry_value);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
@@ -426,33 +592,33 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		switch (offset & 0x3) {
 		case 0:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff;
-			((__u16 *)mydata->fatbuf)[off16] |= val1;
+			((__u16 *)fatbuf)[off16] &= ~0xfff;
+			((__u16 *)fatbuf)[off16] |= val1;
 			break;
 		case 1:
 			val1 = cpu_to_le16(entry_value) & 0xf;
 			val2 = (cpu_to_le16(entry_value) >> 4) & 0xff;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xf000;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 12);
+			((__u16 *)fatbuf)[off16] &= ~0xf000;
+			((__u16 *)fatbuf)[off16] |= (val1 << 12);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xff;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xff;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 2:
 			val1 = cpu_to_le16(entry_value) & 0xff;
 			val2 = (cpu_to_le16(entry_value) >> 8) & 0xf;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xff00;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 8);
+			((__u16 *)fatbuf)[off16] &= ~0xff00;
+			((__u16 *)fatbuf)[off16] |= (val1 << 8);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xf;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xf;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 3:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff0;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 4);
+			((__u16 *)fatbuf)[off16] &= ~0xfff0;
+			((__u16 *)fatbuf)[off16] |= (val1 << 4);
 			break;
 		default:
 			break;
@@ -472,17 +638,18 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
  */
 static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	__u32 next_entry;
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
-		}
-		next_entry++;
+	next_entry = find_free_clust(mydata, entry + 1);
+	if (!next_entry)
+		next_entry = find_free_clust(mydata, 2);
+	if (!next_entry) {
+		debug("error: no free cluster left\n");
+		return 0;
 	}
+
+	/* found free entry, link to entry */
+	set_fatent_value(mydata, entry, next_entry);
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -553,18 +720,18 @@ set_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find the first empty cluster, preferring one that starts a free run
+ * long enough to hold 'size' bytes
  */
-static int find_empty_cluster(fsdata *mydata)
+static int find_empty_cluster(fsdata *mydata, loff_t size)
 {
-	__u32 fat_val, entry = 3;
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 count, entry;
 
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
-	}
+	count = div_u64(size + bytesperclust - 1, bytesperclust);
+	entry = find_free_extent(mydata, count ? count : 1);
+	if (!entry)
+		return -1;
 
 	return entry;
 }
@@ -582,7 +749,11 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 		printf("error: wrinting directory entry\n");
 		return;
 	}
-	dir_newclust = find_empty_cluster(mydata);
+	dir_newclust = find_empty_cluster(mydata, 0);
+	if (dir_newclust < 0) {
+		printf("error: no free cluster for directory\n");
+		return;
+	}
 	set_fatent_value(mydata, dir_curclust, dir_newclust);
 	if (mydata->fatsize == 32)
 		set_fatent_value(mydata, dir_newclust, 0xffffff8);
@@ -956,11 +1127,12 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	if (fat_cache_init(mydata))
+		return -1;
+
+	if (build_freemap(mydata)) {
+		free(mydata->freemap);
+		free(mydata->fatbuf);
 		return -1;
 	}
 
@@ -1008,7 +1180,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 			if (!size)
 				set_start_cluster(mydata, retdent, 0);
 		} else if (size) {
-			ret = start_cluster = find_empty_cluster(mydata);
+			ret = start_cluster = find_empty_cluster(mydata, size);
 			if (ret < 0) {
 				printf("Error: finding empty cluster\n");
 				goto exit;
@@ -1028,7 +1200,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		fill_dir_slot(mydata, &empty_dentptr, filename);
 
 		if (size) {
-			ret = start_cluster = find_empty_cluster(mydata);
+			ret = start_cluster = find_empty_cluster(mydata, size);
 			if (ret < 0) {
 				printf("Error: finding empty cluster\n");
 				goto exit;
@@ -1071,6 +1243,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		printf("Error: writing directory entry\n");
 
 exit:
+	free(mydata->freemap);
 	free(mydata->fatbuf);
 	return ret;
 }
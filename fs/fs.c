@@ -7,11 +7,16 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <bootm.h>
+#include <decomp_stream.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <hash.h>
+#include <job.h>
+#include <malloc.h>
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
@@ -26,6 +31,26 @@ static int fs_dev_part;
 static disk_partition_t fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+/*
+ * The filesystem found by the last probe, kept mounted after each operation
+ * when its type allows so that the next command on the same partition can
+ * skip the probe and reuse what the filesystem holds in memory. It is
+ * released on a write, when the device is rescanned or written behind our
+ * back (see fs_invalidate()) and by fs_umount().
+ */
+static struct {
+	struct blk_desc *desc;
+	int if_type;
+	int devnum;
+	int part;
+	lbaint_t start;
+	lbaint_t size;
+	int fstype;		/* FS_TYPE_ANY when nothing is mounted */
+	bool stale;
+} fs_mount = {
+	.fstype = FS_TYPE_ANY,
+};
+
 static inline int fs_probe_unsupported(struct blk_desc *fs_dev_desc,
 				      disk_partition_t *fs_partition)
 {
@@ -118,6 +143,12 @@ struct fstype_info {
 	 * filesystem.
 	 */
 	bool null_dev_desc_ok;
+	/*
+	 * Can the filesystem stay mounted between operations? Its state must
+	 * survive .close() not being called, and is only valid for the device
+	 * and partition of the last .probe().
+	 */
+	bool keep_mounted;
 	int (*probe)(struct blk_desc *fs_dev_desc,
 		     disk_partition_t *fs_partition);
 	int (*ls)(const char *dirname);
@@ -151,6 +182,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_FAT,
 		.name = "fat",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
 		.ls = fs_ls_generic,
@@ -173,6 +205,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_EXT,
 		.name = "ext4",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
 		.ls = ext4fs_ls,
@@ -266,6 +299,53 @@ static struct fstype_info *fs_get_info(int fstype)
 	return info;
 }
 
+/* Is the filesystem kept mounted the one on fs_dev_desc/fs_partition? */
+static bool fs_mount_match(int part, int fstype)
+{
+	if (!fs_get_info(fs_mount.fstype)->keep_mounted || fs_mount.stale)
+		return false;
+	if (fstype != FS_TYPE_ANY && fstype != fs_mount.fstype)
+		return false;
+
+	return fs_dev_desc && fs_dev_desc == fs_mount.desc &&
+		fs_dev_desc->if_type == fs_mount.if_type &&
+		fs_dev_desc->devnum == fs_mount.devnum &&
+		part == fs_mount.part &&
+		fs_partition.start == fs_mount.start &&
+		fs_partition.size == fs_mount.size;
+}
+
+static void fs_mount_set(int part)
+{
+	fs_mount.desc = fs_dev_desc;
+	fs_mount.if_type = fs_dev_desc ? fs_dev_desc->if_type : IF_TYPE_UNKNOWN;
+	fs_mount.devnum = fs_dev_desc ? fs_dev_desc->devnum : -1;
+	fs_mount.part = part;
+	fs_mount.start = fs_partition.start;
+	fs_mount.size = fs_partition.size;
+	fs_mount.fstype = fs_type;
+	fs_mount.stale = false;
+}
+
+void fs_umount(void)
+{
+	struct fstype_info *info = fs_get_info(fs_mount.fstype);
+
+	/* Mark it gone first: .close() may land back here */
+	fs_mount.fstype = FS_TYPE_ANY;
+	fs_mount.stale = false;
+	fs_type = FS_TYPE_ANY;
+
+	info->close();
+}
+
+void fs_invalidate(int if_type, int devnum)
+{
+	if (fs_mount.fstype != FS_TYPE_ANY && fs_mount.if_type == if_type &&
+	    fs_mount.devnum == devnum)
+		fs_mount.stale = true;
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -292,6 +372,13 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (fs_mount_match(part, fstype)) {
+		fs_type = fs_mount.fstype;
+		fs_dev_part = part;
+		return 0;
+	}
+	fs_umount();
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -303,6 +390,7 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_mount_set(part);
 			return 0;
 		}
 	}
@@ -324,9 +412,18 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (fs_mount_match(part, FS_TYPE_ANY)) {
+		fs_type = fs_mount.fstype;
+		fs_dev_part = part;
+		return 0;
+	}
+	fs_umount();
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
+			fs_dev_part = part;
+			fs_mount_set(part);
 			return 0;
 		}
 	}
@@ -336,9 +433,10 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 
 static void fs_close(void)
 {
-	struct fstype_info *info = fs_get_info(fs_type);
+	struct fstype_info *info = fs_get_info(fs_mount.fstype);
 
-	info->close();
+	if (!info->keep_mounted || fs_mount.stale)
+		fs_umount();
 
 	fs_type = FS_TYPE_ANY;
 }
@@ -413,6 +511,183 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return ret;
 }
 
+#ifdef CONFIG_HASH
+/*
+ * fs_read_hash() reads this much at a time, so that each piece is hashed
+ * while it is still in the cache
+ */
+#define FS_HASH_CHUNK	(256 << 10)
+
+int fs_read_hash(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread, struct hash_algo *algo, void *ctx)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	uint8_t digest[HASH_MAX_DIGEST_SIZE];
+	loff_t size, want, chunk, got;
+	char *buf;
+	int ret;
+
+	*actread = 0;
+	ret = info->size(filename, &size);
+	if (ret) {
+		printf("** Unable to read file %s **\n", filename);
+		goto out;
+	}
+	if (offset > size) {
+		printf("** %s shorter than offset **\n", filename);
+		ret = -1;
+		goto out;
+	}
+	want = size - offset;
+	if (len && len < want)
+		want = len;
+
+	buf = map_sysmem(addr, want);
+	while (*actread < want) {
+		chunk = min(want - *actread, (loff_t)FS_HASH_CHUNK);
+		ret = info->read(filename, buf + *actread, offset + *actread,
+				 chunk, &got);
+		if (ret)
+			break;
+		*actread += got;
+		/* This releases the context if it fails */
+		if (algo->hash_update(algo, ctx, buf + *actread - got, got,
+				      got < chunk || *actread == want)) {
+			unmap_sysmem(buf);
+			fs_close();
+			return -1;
+		}
+		if (got < chunk)
+			break;
+	}
+	unmap_sysmem(buf);
+
+	if (ret == 0 && len && *actread != len)
+		printf("** %s shorter than offset + len **\n", filename);
+out:
+	if (ret)
+		algo->hash_finish(algo, ctx, digest, sizeof(digest));
+	fs_close();
+
+	return ret;
+}
+#endif
+
+#ifdef CONFIG_DECOMP_STREAM
+/* fs_read_decomp() reads this much at a time into each of its two buffers */
+#define FS_DECOMP_CHUNK	(256 << 10)
+
+struct fs_decomp_piece {
+	struct decomp_stream *ds;
+	const void *buf;
+	loff_t len;
+};
+
+static int fs_decomp_piece(void *arg)
+{
+	struct fs_decomp_piece *piece = arg;
+
+	return decomp_stream_feed(piece->ds, piece->buf, piece->len);
+}
+
+int fs_read_decomp(const char *filename, ulong addr, ulong size,
+		   loff_t offset, loff_t len, loff_t *actread, ulong *outlen)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_decomp_piece piece;
+	struct decomp_stream ds;
+	struct job job;
+	loff_t fsize, want, chunk, got;
+	bool started = false, busy = false;
+	char *buf[2];
+	void *dst;
+	int cur = 0;
+	int ret, err;
+
+	*actread = 0;
+	*outlen = 0;
+	ret = info->size(filename, &fsize);
+	if (ret) {
+		printf("** Unable to read file %s **\n", filename);
+		goto out;
+	}
+	if (offset >= fsize) {
+		printf("** %s shorter than offset **\n", filename);
+		ret = -1;
+		goto out;
+	}
+	want = fsize - offset;
+	if (len && len < want)
+		want = len;
+
+	buf[0] = malloc(2 * FS_DECOMP_CHUNK);
+	if (!buf[0]) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	buf[1] = buf[0] + FS_DECOMP_CHUNK;
+
+	/*
+	 * Read each piece into one buffer while the piece in the other is
+	 * decompressed, on another CPU if there is one
+	 */
+	dst = map_sysmem(addr, size);
+	while (*actread < want) {
+		chunk = min(want - *actread, (loff_t)FS_DECOMP_CHUNK);
+		ret = info->read(filename, buf[cur], offset + *actread, chunk,
+				 &got);
+		if (ret)
+			break;
+		*actread += got;
+		if (busy) {
+			busy = false;
+			ret = job_wait(&job);
+			if (ret)
+				break;
+		}
+		if (!started) {
+			ret = decomp_stream_start(&ds, dst, size, buf[cur], got);
+			if (ret)
+				break;
+			started = true;
+		} else {
+			piece.ds = &ds;
+			piece.buf = buf[cur];
+			piece.len = got;
+			job_submit(&job, fs_decomp_piece, &piece);
+			busy = true;
+		}
+		if (got < chunk)
+			break;
+		cur = !cur;
+	}
+	if (busy) {
+		err = job_wait(&job);
+		if (!ret)
+			ret = err;
+	}
+	if (started) {
+		err = decomp_stream_end(&ds);
+		if (!ret)
+			ret = err;
+		*outlen = ds.out;
+	} else if (!ret) {
+		ret = -EINVAL;
+	}
+	unmap_sysmem(dst);
+	free(buf[0]);
+
+	if (ret == -ENOBUFS)
+		printf("** %s does not fit in %#lx bytes **\n", filename, size);
+	else if (ret)
+		printf("** Unable to decompress %s (err=%d) **\n", filename, ret);
+out:
+	fs_close();
+
+	return ret;
+}
+#endif
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
@@ -428,7 +703,8 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	/* Whatever the filesystem cached may no longer match the disk */
+	fs_umount();
 
 	return ret;
 }
@@ -517,6 +793,34 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int ret;
 	unsigned long time;
 	char *ep;
+#ifdef CONFIG_HASH
+	struct hash_algo *algo = NULL;
+	uint8_t digest[HASH_MAX_DIGEST_SIZE];
+	void *ctx;
+
+	if (argc >= 3 && !strcmp(argv[1], "-h")) {
+		if (hash_progressive_lookup_algo(argv[2], &algo)) {
+			printf("Unknown hash algorithm '%s'\n", argv[2]);
+			return CMD_RET_USAGE;
+		}
+		argc -= 2;
+		argv += 2;
+	}
+#endif
+#ifdef CONFIG_DECOMP_STREAM
+	bool decomp = false;
+	ulong outlen;
+
+	if (argc >= 2 && !strcmp(argv[1], "-d")) {
+		decomp = true;
+		argc--;
+		argv++;
+	}
+#ifdef CONFIG_HASH
+	if (decomp && algo)
+		return CMD_RET_USAGE;
+#endif
+#endif
 
 	if (argc < 2)
 		return CMD_RET_USAGE;
@@ -556,6 +860,23 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		pos = 0;
 
 	time = get_timer(0);
+#ifdef CONFIG_DECOMP_STREAM
+	if (decomp) {
+		ret = fs_read_decomp(filename, addr, CONFIG_SYS_BOOTM_LEN, pos,
+				     bytes, &len_read, &outlen);
+	} else
+#endif
+#ifdef CONFIG_HASH
+	if (algo) {
+		if (algo->hash_init(algo, &ctx))
+			return 1;
+		ret = fs_read_hash(filename, addr, pos, bytes, &len_read, algo,
+				   ctx);
+		if (ret)
+			return 1;
+		ret = algo->hash_finish(algo, ctx, digest, sizeof(digest));
+	} else
+#endif
 	ret = fs_read(filename, addr, pos, bytes, &len_read);
 	time = get_timer(time);
 	if (ret < 0)
@@ -570,8 +891,27 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	puts("\n");
 
 	env_set_hex("fileaddr", addr);
+#ifdef CONFIG_DECOMP_STREAM
+	if (decomp) {
+		printf("Uncompressed size: %lu = 0x%lX\n", outlen, outlen);
+		env_set_hex("filesize", outlen);
+		return 0;
+	}
+#endif
 	env_set_hex("filesize", len_read);
 
+#ifdef CONFIG_HASH
+	if (algo) {
+		char hex[HASH_MAX_DIGEST_SIZE * 2 + 1];
+		int i;
+
+		for (i = 0; i < algo->digest_size; i++)
+			sprintf(hex + i * 2, "%02x", digest[i]);
+		printf("%s ==> %s\n", algo->name, hex);
+		env_set("filehash", hex);
+	}
+#endif
+
 	return 0;
 }
 
@@ -668,6 +1008,16 @@ int do_fs_uuid(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return CMD_RET_SUCCESS;
 }
 
+int do_fs_umount(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (argc != 1)
+		return CMD_RET_USAGE;
+
+	fs_umount();
+
+	return CMD_RET_SUCCESS;
+}
+
 int do_fs_type(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct fstype_info *info;
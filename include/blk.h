@@ -85,6 +85,8 @@ struct blk_desc {
 		uint32_t mbr_sig;	/* MBR integer signature */
 		efi_guid_t guid_sig;	/* GPT GUID Signature */
 	};
+	unsigned int	part_gen;	/* bumped when the partitions may change */
+	struct part_cache *part_cache;	/* decoded partition table, or NULL */
 #if CONFIG_IS_ENABLED(BLK)
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -145,6 +147,41 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_readahead() - decide how far to read ahead of a cache miss
+ *
+ * Once a device is being read sequentially in small pieces, the blocks
+ * following a miss are worth fetching in the same transfer and handing to
+ * blkcache_fill_ahead().
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number of the missed read
+ * @param blkcnt - number of blocks of the missed read
+ *
+ * @return - number of blocks to read after start + blkcnt, 0 for none
+ */
+lbaint_t blkcache_readahead(int iftype, int dev,
+			    lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * blkcache_fill_ahead() - make blocks read ahead available to the
+ * block cache
+ *
+ * Unlike blkcache_fill(), the range may be bigger than an entry; it is
+ * split up and counted as read ahead in the statistics.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks available
+ * @param blksz - size in bytes of each block
+ * @param buf - buffer containing data to cache
+ */
+void blkcache_fill_ahead(int iftype, int dev,
+			 lbaint_t start, lbaint_t blkcnt,
+			 unsigned long blksz, void const *buffer);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -162,6 +199,13 @@ void blkcache_invalidate(int iftype, int dev);
  */
 void blkcache_configure(unsigned blocks, unsigned entries);
 
+/**
+ * blkcache_configure_readahead() - configure read-ahead
+ *
+ * @param blocks - maximum blocks read ahead of a sequential miss, 0 for none
+ */
+void blkcache_configure_readahead(unsigned blocks);
+
 /*
  * statistics of the block cache
  */
@@ -171,6 +215,20 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned max_prefetch;
+};
+
+/*
+ * statistics of the block cache for one device
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned entries; /* current entry count */
+	unsigned prefetched; /* blocks read ahead */
+	unsigned prefetch_used; /* blocks read ahead and then read */
 };
 
 /**
@@ -180,6 +238,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of one device and reset them
+ *
+ * @param idx - index of the device in the cache, from 0
+ * @param stats - statistics are copied here
+ *
+ * @return - 0 if ok, -ENOENT past the last device
+ */
+int blkcache_dev_stats(int idx, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -193,6 +261,17 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline lbaint_t blkcache_readahead(int iftype, int dev,
+					  lbaint_t start, lbaint_t blkcnt)
+{
+	return 0;
+}
+
+static inline void blkcache_fill_ahead(int iftype, int dev,
+				       lbaint_t start, lbaint_t blkcnt,
+				       unsigned long blksz,
+				       void const *buffer) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -440,6 +519,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->part_gen++;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -447,6 +527,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->part_gen++;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -15,6 +15,11 @@
 #define BOOTM_ERR_OVERLAP		(-2)
 #define BOOTM_ERR_UNIMPLEMENTED	(-3)
 
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
 /*
  *  Continue booting an OS image; caller already has:
  *  - copied image header to global variable `header'
@@ -67,10 +72,13 @@ void arch_preboot_os(void);
  * @image_buf:	Address to decompress from
  * @image_len:	Number of bytes in @image_buf to decompress
  * @unc_len:	Available space for decompression
+ * @hashed:	true if the image data has already been checked against a
+ *		hash, so that checksums in the compressed stream need not be
+ * @load_end:	Returns the end address of the decompressed data
  * @return 0 if OK, -ve on error (BOOTM_ERR_...)
  */
 int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		       void *load_buf, void *image_buf, ulong image_len,
-		       uint unc_len, ulong *load_end);
+		       uint unc_len, bool hashed, ulong *load_end);
 
 #endif
@@ -643,7 +643,9 @@ void gzwrite_progress_finish(int retcode,
  * @param	src		compressed image address
  * @param	len		compressed image length in bytes
  * @param	dev		block device descriptor
- * @param	szwritebuf	bytes per write (pad to erase size)
+ * @param	szwritebuf	bytes per write (pad to erase size); on MMC,
+ *				writes of zeroes covering whole erase
+ *				groups become erases
  * @param	startoffs	offset in bytes of first write
  * @param	szexpected	expected uncompressed length
  *				may be zero to use gzip trailer
@@ -657,6 +659,34 @@ int gzwrite(unsigned char *src, int len,
 
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
+/*
+ * As ulz4fn(), which checks the block and content checksums the frame
+ * carries; @verify false skips them when a hash already covers the data
+ */
+int ulz4fn_verify(const void *src, size_t srcn, void *dst, size_t *dstn,
+		  bool verify);
+/*
+ * Find the length of the frame at @src, and the size it decompresses to,
+ * -1ULL if its header does not say
+ */
+int ulz4fn_frame_info(const void *src, size_t srcn, size_t *framen,
+		      u64 *content);
+
+/* lib/zstd.c */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+/*
+ * As zstd_decompress(), using @work, of zstd_work_size() bytes, instead of
+ * allocating memory
+ */
+int zstd_decompress_work(const void *src, size_t srcn, void *dst,
+			 size_t *dstn, void *work);
+size_t zstd_work_size(void);
+/*
+ * Find the length of the (possibly skippable) frame at @src, and the size
+ * it decompresses to, -1ULL if its header does not say
+ */
+int zstd_frame_info(const void *src, size_t srcn, size_t *framen,
+		    u64 *content);
 
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
@@ -38,6 +38,12 @@
 /* USB */
 #define CONFIG_USB_EHCI_EXYNOS
 
+/* Put fragmented packets back together, for bigger NFS reads */
+#define CONFIG_IP_DEFRAG
+
+/* Ask for the file size, so TFTP blocks can be received in place */
+#define CONFIG_TFTP_TSIZE
+
 /* select serial console configuration */
 #define CONFIG_SERIAL2
 
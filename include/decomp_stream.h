@@ -0,0 +1,90 @@
+/*
+ * Decompression of data which arrives a piece at a time
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _DECOMP_STREAM_H
+#define _DECOMP_STREAM_H
+
+/**
+ * struct decomp_stream - A compressed image being decompressed as it loads
+ *
+ * This lets a loader decompress each piece of an image as soon as it has
+ * read it, rather than reading the whole image to memory first.
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @state:	Decompressor state, private to the decompressor
+ * @dst:	Where to put the decompressed data
+ * @size:	Space at @dst
+ * @out:	Number of bytes written to @dst so far
+ * @done:	true once the end of the compressed data has been seen
+ * @err:	First error from the decompressor, 0 if none
+ */
+struct decomp_stream {
+	int comp;
+	void *state;
+	void *dst;
+	size_t size;
+	size_t out;
+	bool done;
+	int err;
+};
+
+/**
+ * decomp_stream_start() - Start decompressing
+ *
+ * The compression type comes from the magic number at the start of the
+ * data, so @len must cover at least the compressed data's header. This
+ * allocates everything the decompressor needs and then decompresses @src.
+ * On error there is nothing to free.
+ *
+ * @ds:		Stream to set up
+ * @dst:	Where to put the decompressed data
+ * @size:	Space at @dst
+ * @src:	First piece of compressed data
+ * @len:	Length of @src
+ * @return 0 if OK, -EPROTONOSUPPORT if the data is not in a format that
+ *	can be decompressed a piece at a time, other -ve on error
+ */
+int decomp_stream_start(struct decomp_stream *ds, void *dst, size_t size,
+			const void *src, size_t len);
+
+/**
+ * decomp_stream_feed() - Decompress the next piece of compressed data
+ *
+ * This does not allocate memory or print, so it may run as a job on another
+ * CPU (see job.h) while the caller reads the next piece. Data after the end
+ * of the compressed data is ignored.
+ *
+ * @ds:		Stream to add to
+ * @src:	Next piece of compressed data, which may be reused on return
+ * @len:	Length of @src
+ * @return 0 if OK, -ENOBUFS if there is not enough space at @dst, other -ve
+ *	if the data is corrupt
+ */
+int decomp_stream_feed(struct decomp_stream *ds, const void *src, size_t len);
+
+/**
+ * decomp_stream_end() - Finish decompressing
+ *
+ * This frees the decompressor's state, whether or not all went well.
+ * @ds->out then gives the decompressed size.
+ *
+ * @ds:		Stream to finish
+ * @return 0 if OK, -EINVAL if the compressed data stopped early, other -ve
+ *	on an earlier error
+ */
+int decomp_stream_end(struct decomp_stream *ds);
+
+/* Decompressors, used by the functions above */
+int gunzip_stream_start(struct decomp_stream *ds);
+int gunzip_stream_feed(struct decomp_stream *ds, const void *src, size_t len);
+void gunzip_stream_end(struct decomp_stream *ds);
+
+int ulz4_stream_start(struct decomp_stream *ds, const void *src, size_t len,
+		      size_t *used);
+int ulz4_stream_feed(struct decomp_stream *ds, const void *src, size_t len);
+void ulz4_stream_end(struct decomp_stream *ds);
+
+#endif /* _DECOMP_STREAM_H */
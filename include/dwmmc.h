@@ -9,6 +9,7 @@
 #define __DWMMC_HW_H
 
 #include <asm/io.h>
+#include <bouncebuf.h>
 #include <mmc.h>
 
 #define DWMCI_CTRL		0x000
@@ -166,6 +167,16 @@ struct dwmci_host {
 	void (*clksel)(struct dwmci_host *host);
 	void (*board_init)(struct dwmci_host *host);
 
+	/**
+	 * Find a working sample point for HS200, using mmc_send_tuning()
+	 * with @opcode to check each candidate
+	 *
+	 * @host:	DWMMC host
+	 * @opcode:	Tuning command to send
+	 * @return 0 if a working setting was found, -ve on error
+	 */
+	int (*execute_tuning)(struct dwmci_host *host, u32 opcode);
+
 	/**
 	 * Get / set a particular MMC clock frequency
 	 *
@@ -186,6 +197,14 @@ struct dwmci_host {
 
 	/* use fifo mode to read and write data */
 	bool fifo_mode;
+
+	/* most blocks in one transfer, 0 for CONFIG_SYS_MMC_MAX_BLK_COUNT */
+	unsigned int b_max;
+	/* IDMAC descriptor ring, grown to fit the largest transfer so far */
+	struct dwmci_idmac *idmac;
+	unsigned int idmac_count;
+	/* buffer of the transfer in progress */
+	struct bounce_buffer bbstate;
 };
 
 struct dwmci_idmac {
@@ -31,6 +31,7 @@
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
@@ -78,6 +79,44 @@ struct ext4_extent_header {
 	__le32	eh_generation;	/* generation of the tree */
 };
 
+/*
+ * Hashed directory (htree) on-disk structures. Block 0 of an indexed
+ * directory holds fake "." and ".." entries followed by struct dx_root_info
+ * and an array of struct dx_entry. Interior nodes start with a fake empty
+ * dirent covering the whole block, then the entries. The first entry of
+ * each array stores the limit/count pair in place of its hash.
+ */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define EXT2_FLAGS_SIGNED_HASH		0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+#define EXT4_HTREE_LEVEL		3
+
+struct dx_root_info {
+	__le32	reserved_zero;
+	__u8	hash_version;
+	__u8	info_length;	/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+struct dx_countlimit {
+	__le16	limit;
+	__le16	count;
+};
+
+struct dx_entry {
+	__le32	hash;
+	__le32	block;
+};
+
 struct ext_filesystem {
 	/* Total Sector of partition */
 	uint64_t total_sect;
@@ -146,6 +185,10 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock);
+long int read_allocated_extent(struct ext2fs_node *node, int fileblock,
+			       int *count);
+int ext4fs_dirhash(const char *name, int len, int version,
+		   const __u32 *seed, __u32 *hash);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -125,8 +125,13 @@ struct bpb {
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
-#define FATBUFBLOCKS	6
+/*
+ * Must be a multiple of 3 so that no FAT12 entry straddles two windows,
+ * and no more than 32 as modified sectors are tracked in a 32-bit mask
+ */
+#define FATBUFBLOCKS	24
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+#define FATCACHEWINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -263,18 +268,24 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT cache, fatbufwins windows of FATBUFSIZE */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u32	fat_dirty[FATCACHEWINDOWS];	/* Modified sectors in window */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufnum[FATCACHEWINDOWS];	/* FAT window held, -1 if none */
+	__u32	fatbuflru[FATCACHEWINDOWS];	/* Last use of each window */
+	__u32	fatbuftick;	/* Use counter for LRU replacement */
+	int	fatbufwins;	/* Number of windows allocated in fatbuf */
+	int	fatbufcur;	/* Most recently used window */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
+	__u32	*freemap;	/* Bitmap of clusters in use, for writing */
+	__u32	max_clust;	/* Number of FAT entries covered by freemap */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
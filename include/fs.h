@@ -76,6 +76,47 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+struct hash_algo;
+
+/*
+ * fs_read_hash - Read a file like fs_read(), hashing it as it is read
+ *
+ * The file is read in pieces and each piece is passed to the progressive
+ * hash @algo as soon as it lands, so the data is hashed while it is still
+ * in the cache instead of in a second pass over memory.
+ *
+ * @filename: Name of file to read from
+ * @addr: The address to read into
+ * @offset: The offset in file to read from
+ * @len: The number of bytes to read. Maybe 0 to read entire file
+ * @actread: Returns the actual number of bytes read
+ * @algo: Progressive hash algorithm, see hash_progressive_lookup_algo()
+ * @ctx: Context from @algo->hash_init(). On success the caller finishes
+ *	it, on error it has been released
+ * @return 0 if ok with valid *actread, non-zero on error conditions
+ */
+int fs_read_hash(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread, struct hash_algo *algo, void *ctx);
+
+/*
+ * fs_read_decomp - Read a compressed file, decompressing it as it is read
+ *
+ * The file is read in pieces. Each piece is decompressed, on another CPU if
+ * there is one, while the next is read. The file must be gzip- or, with
+ * CONFIG_LZ4, LZ4-compressed.
+ *
+ * @filename: Name of file to read from
+ * @addr: The address to decompress to
+ * @size: Space at @addr
+ * @offset: The offset in file to read from
+ * @len: The number of bytes to read. Maybe 0 to read entire file
+ * @actread: Returns the actual number of bytes read
+ * @outlen: Returns the number of bytes decompressed
+ * @return 0 if ok, -ve on error
+ */
+int fs_read_decomp(const char *filename, ulong addr, ulong size,
+		   loff_t offset, loff_t len, loff_t *actread, ulong *outlen);
+
 /*
  * fs_write - Write file to the partition previously set by fs_set_blk_dev()
  * Note that not all filesystem types support offset!=0.
@@ -90,6 +131,31 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite);
 
+#ifndef CONFIG_SPL_BUILD
+/*
+ * fs_umount - Release the filesystem kept mounted between commands
+ *
+ * The filesystem found by fs_set_blk_dev() stays mounted after each
+ * operation, so that later commands on the same partition need not probe
+ * it again. This drops it, along with anything the filesystem cached.
+ */
+void fs_umount(void);
+
+/*
+ * fs_invalidate - Note that the contents of a block device have changed
+ *
+ * A filesystem kept mounted on the device is released before its next
+ * use. This is safe to call from inside a filesystem operation.
+ *
+ * @if_type: Interface type of the device (IF_TYPE_...)
+ * @devnum: Device number
+ */
+void fs_invalidate(int if_type, int devnum);
+#else
+static inline void fs_umount(void) {}
+static inline void fs_invalidate(int if_type, int devnum) {}
+#endif
+
 /*
  * Directory entry types, matches the subset of DT_x in posix readdir()
  * which apply to u-boot.
@@ -174,4 +240,9 @@ int do_fs_uuid(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
  */
 int do_fs_type(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 
+/*
+ * Release the filesystem kept mounted by the previous commands.
+ */
+int do_fs_umount(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+
 #endif /* _FS_H */
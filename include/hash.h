@@ -72,6 +72,70 @@ struct hash_algo {
 			   int size);
 };
 
+/* The most algorithms a struct hash_multi can run at once */
+#define HASH_MULTI_MAX		4
+
+/* hash_multi_update() hands each algorithm this much at a time */
+#define HASH_MULTI_CHUNK	(16 << 10)
+
+/**
+ * struct hash_multi - Several progressive hashes of the same data
+ *
+ * @count:	Number of algorithms added
+ * @algo:	The algorithms
+ * @ctx:	Their contexts, NULL once an update has failed
+ */
+struct hash_multi {
+	int count;
+	struct hash_algo *algo[HASH_MULTI_MAX];
+	void *ctx[HASH_MULTI_MAX];
+};
+
+/**
+ * hash_multi_init() - Start a multi-algorithm hash with no algorithms
+ *
+ * @hm:		Multi-algorithm hash to set up
+ */
+void hash_multi_init(struct hash_multi *hm);
+
+/**
+ * hash_multi_add() - Add an algorithm to a multi-algorithm hash
+ *
+ * This must be done before the first hash_multi_update().
+ *
+ * @hm:		Multi-algorithm hash
+ * @algo_name:	Name of an algorithm with progressive support
+ * @return index of the algorithm's digest in hash_multi_finish()'s output,
+ * -EPROTONOSUPPORT for an unknown algorithm, -ENOSPC if there are already
+ * HASH_MULTI_MAX algorithms, -ENOMEM if its context cannot be created
+ */
+int hash_multi_add(struct hash_multi *hm, const char *algo_name);
+
+/**
+ * hash_multi_update() - Hash a buffer with every algorithm, in one pass
+ *
+ * The buffer is handed to each algorithm in turn in HASH_MULTI_CHUNK
+ * pieces, so it is read from memory once rather than once per algorithm.
+ *
+ * @hm:		Multi-algorithm hash
+ * @buf:	Data to hash
+ * @size:	Number of bytes to hash
+ * @is_last:	1 if this is the last update; 0 otherwise
+ * @return 0 if ok, -EIO if an algorithm has failed
+ */
+int hash_multi_update(struct hash_multi *hm, const void *buf,
+		      unsigned int size, int is_last);
+
+/**
+ * hash_multi_finish() - Get the digests and release the contexts
+ *
+ * @hm:		Multi-algorithm hash
+ * @output:	One digest per algorithm, in the order they were added
+ * @return 0 if ok, -EIO if an algorithm has failed
+ */
+int hash_multi_finish(struct hash_multi *hm,
+		      uint8_t output[][HASH_MAX_DIGEST_SIZE]);
+
 #ifndef USE_HOSTCC
 /**
  * hash_command: Process a hash command for a particular algorithm
@@ -21,6 +21,7 @@
 
 /* Define this to avoid #ifdefs later on */
 struct lmb;
+struct fit_verify_job;
 
 #ifdef USE_HOSTCC
 #include <sys/types.h>
@@ -287,6 +288,7 @@ enum {
 	IH_COMP_LZMA,			/* lzma  Compression Used	*/
 	IH_COMP_LZO,			/* lzo   Compression Used	*/
 	IH_COMP_LZ4,			/* lz4   Compression Used	*/
+	IH_COMP_ZSTD,			/* zstd  Compression Used	*/
 
 	IH_COMP_COUNT,
 };
@@ -375,6 +377,7 @@ typedef struct bootm_headers {
 #endif
 
 	int		verify;		/* env_get("verify")[0] != 'n' */
+	int		verify_os_later; /* check OS hashes in bootm_load_os() */
 
 #define	BOOTM_STATE_START	(0x00000001)
 #define	BOOTM_STATE_FINDOS	(0x00000002)
@@ -1000,6 +1003,31 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 			      const char *engine_id);
 
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * fit_image_verify_start() - Start working out an image's hashes on a job
+ *
+ * This lets the hashes be worked out on another CPU while the boot CPU
+ * carries on, as long as nothing changes the image data until
+ * fit_image_verify_finish().
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @noffset:	Component image node offset
+ * @return the job, or NULL if the hashes cannot be worked out this way, in
+ * which case use fit_image_verify()
+ */
+struct fit_verify_job *fit_image_verify_start(const void *fit, int noffset);
+
+/**
+ * fit_image_verify_finish() - Check the hashes worked out by a job
+ *
+ * This waits for the job to finish, then checks the hashes and prints the
+ * result like fit_image_verify(). The job is freed.
+ *
+ * @vj:		Job from fit_image_verify_start()
+ * @return 1 if all hashes are valid, 0 otherwise
+ */
+int fit_image_verify_finish(struct fit_verify_job *vj);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
 int fit_image_check_os(const void *fit, int noffset, uint8_t os);
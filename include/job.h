@@ -0,0 +1,135 @@
+/*
+ * Job queue for running work on other CPUs
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _JOB_H
+#define _JOB_H
+
+/**
+ * struct job - A piece of work that may run on another CPU
+ *
+ * Jobs are submitted by the boot CPU only. A job's function may run on any
+ * CPU, so it must not print, allocate memory, use devices or submit jobs
+ * of its own: it should only read and write the memory it is given.
+ *
+ * @func:	Function to run
+ * @arg:	Argument to pass to it
+ * @ret:	What it returned, once @done
+ * @done:	Non-zero once it has finished
+ * @next:	Next job waiting to be handed to a CPU
+ */
+struct job {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+	int done;
+	struct job *next;
+};
+
+#if defined(CONFIG_JOBS) && !defined(USE_HOSTCC) && !defined(CONFIG_SPL_BUILD)
+
+/**
+ * job_workers() - Get the number of CPUs which run jobs for the boot CPU
+ *
+ * The first call starts them.
+ *
+ * @return number of other CPUs running jobs, 0 if jobs run on the boot CPU
+ */
+int job_workers(void);
+
+/**
+ * job_submit() - Start a job
+ *
+ * The job is handed to an idle CPU, queued until one is free, or run
+ * before returning if there are no other CPUs. The job must stay in place
+ * until job_wait() returns.
+ *
+ * @job:	Job to start
+ * @func:	Function to run
+ * @arg:	Argument to pass to it
+ */
+void job_submit(struct job *job, int (*func)(void *arg), void *arg);
+
+/**
+ * job_wait() - Wait for a job to finish
+ *
+ * While waiting, the boot CPU runs jobs that are still queued.
+ *
+ * @job:	Job to wait for
+ * @return what the job's function returned
+ */
+int job_wait(struct job *job);
+
+/**
+ * job_stop_workers() - Stop the CPUs which run jobs
+ *
+ * This is called before handing over to an operating system, which expects
+ * to find the other CPUs as the boot ROM left them. Jobs not yet finished
+ * are run first. If there is work later, the CPUs are started again.
+ */
+void job_stop_workers(void);
+
+/**
+ * job_worker() - Run jobs for the boot CPU
+ *
+ * This is the main loop of each CPU started by arch_job_start_workers(). It
+ * returns only when job_stop_workers() is called.
+ *
+ * @cpu:	Number of the worker, from 0 to one less than the number started
+ */
+void job_worker(int cpu);
+
+/**
+ * arch_job_start_workers() - Start CPUs to run jobs
+ *
+ * Each CPU started calls job_worker() with its number.
+ *
+ * @max:	Most CPUs to start
+ * @return number of CPUs started
+ */
+int arch_job_start_workers(int max);
+
+/**
+ * arch_job_stop_workers() - Give back the CPUs started to run jobs
+ *
+ * This is called once each of them has returned from job_worker(), and
+ * should leave them as the boot ROM did.
+ *
+ * @count:	Number of CPUs started
+ */
+void arch_job_stop_workers(int count);
+
+/* Wait for another CPU to signal, or just pause if that is not possible */
+void arch_job_idle(void);
+
+/* Wake any CPUs waiting in arch_job_idle() */
+void arch_job_notify(void);
+
+#else
+
+static inline int job_workers(void)
+{
+	return 0;
+}
+
+static inline void job_stop_workers(void)
+{
+}
+
+static inline void job_submit(struct job *job, int (*func)(void *arg),
+			      void *arg)
+{
+	job->ret = func(arg);
+	job->done = 1;
+}
+
+static inline int job_wait(struct job *job)
+{
+	return job->ret;
+}
+
+#endif
+
+#endif /* _JOB_H */
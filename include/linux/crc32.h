@@ -6,10 +6,14 @@
 #define _LINUX_CRC32_H
 
 #include <linux/types.h>
+#include <u-boot/crc.h>
 /* #include <linux/bitrev.h> */
 
-extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
-/* extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len); */
+/* The kernel's crc32_le() is the U-Boot one without the final inversion */
+static inline u32 crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_no_comp(crc, p, len);
+}
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
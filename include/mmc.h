@@ -58,8 +58,12 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_CMD23		(1 << 6)	/* host can do CMD23 transfers */
+#define MMC_MODE_HS200		(1 << 7)	/* HS200, 1.8V I/O */
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_SCR_CMD23	0x00000002	/* SCR CMD_SUPPORT: SET_BLOCK_COUNT */
+#define SD_SCR_ERASED_ONES	0x00800000	/* SCR DATA_STAT_AFTER_ERASE */
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -82,6 +86,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -125,6 +130,10 @@
 #define MMC_SECURE_TRIM1_ARG	0x80000001
 #define MMC_SECURE_TRIM2_ARG	0x80008000
 
+/* CMD23 argument */
+#define MMC_SBC_MAX_BLOCKS	0xffff
+#define MMC_SBC_RELIABLE_WRITE	(1U << 31)
+
 #define MMC_STATUS_MASK		(~0x0206BF7F)
 #define MMC_STATUS_SWITCH_ERROR	(1 << 7)
 #define MMC_STATUS_RDY_FOR_DATA (1 << 8)
@@ -181,12 +190,14 @@
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
 #define EXT_CSD_HS_TIMING		185	/* R/W */
 #define EXT_CSD_REV			192	/* RO */
 #define EXT_CSD_CARD_TYPE		196	/* RO */
 #define EXT_CSD_SEC_CNT			212	/* RO, 4 bytes */
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
+#define EXT_CSD_REL_WR_SEC_C		222	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
@@ -205,6 +216,12 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)	/* Card can run at */
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)	/* 200MHz SDR */
+
+#define EXT_CSD_TIMING_LEGACY	0	/* HS_TIMING values */
+#define EXT_CSD_TIMING_HS	1
+#define EXT_CSD_TIMING_HS200	2
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -235,6 +252,7 @@
 #define EXT_CSD_ENH_GP(x)	(1 << ((x)+1))	/* GP part (x+1) is enhanced */
 
 #define EXT_CSD_HS_CTRL_REL	(1 << 0)	/* host controlled WR_REL_SET */
+#define EXT_CSD_EN_REL_WR	(1 << 2)	/* enhanced reliable write */
 
 #define EXT_CSD_WR_DATA_REL_USR		(1 << 0)	/* user data area WR_REL */
 #define EXT_CSD_WR_DATA_REL_GP(x)	(1 << ((x)+1))	/* GP part (x+1) WR_REL */
@@ -268,6 +286,14 @@
 /* Maximum block size for MMC */
 #define MMC_MAX_BLOCK_LEN	512
 
+#define MMC_HS200_MAX_DTR	200000000
+
+#define MMC_TUNING_BLK_4BIT_SIZE	64
+#define MMC_TUNING_BLK_8BIT_SIZE	128
+
+extern const u8 tuning_blk_pattern_4bit[MMC_TUNING_BLK_4BIT_SIZE];
+extern const u8 tuning_blk_pattern_8bit[MMC_TUNING_BLK_8BIT_SIZE];
+
 /* The number of MMC physical partitions.  These consist of:
  * boot partitions (2), general purpose partitions (4) in MMC v4.4.
  */
@@ -361,6 +387,43 @@ struct dm_mmc_ops {
 	 * @return 0 if write-enabled, 1 if write-protected, -ve on error
 	 */
 	int (*get_wp)(struct udevice *dev);
+
+	/**
+	 * execute_tuning() - Find the sampling point for the current timing
+	 *
+	 * This is optional. It is called once the card is in HS200 mode and
+	 * should try the sampling phases the host has, using
+	 * mmc_send_tuning() to check each, and keep the best one.
+	 *
+	 * @dev:	Device to tune
+	 * @opcode:	Tuning command (MMC_CMD_SEND_TUNING_BLOCK_HS200)
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*execute_tuning)(struct udevice *dev, uint opcode);
+
+	/**
+	 * start_cmd() - Send a command but do not wait for its data
+	 *
+	 * This is optional. It works like send_cmd() but returns once the
+	 * response is in, with the data still moving. The transfer is ended
+	 * with wait_data(), before any other command is sent.
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to send/receive
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*start_cmd)(struct udevice *dev, struct mmc_cmd *cmd,
+			 struct mmc_data *data);
+
+	/**
+	 * wait_data() - Wait for the data of start_cmd() to be transferred
+	 *
+	 * @dev:	Device which received the command
+	 * @data:	Data passed to start_cmd()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*wait_data)(struct udevice *dev, struct mmc_data *data);
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -370,11 +433,19 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 int dm_mmc_set_ios(struct udevice *dev);
 int dm_mmc_get_cd(struct udevice *dev);
 int dm_mmc_get_wp(struct udevice *dev);
+int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
+int dm_mmc_start_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+		     struct mmc_data *data);
+int dm_mmc_wait_data(struct udevice *dev, struct mmc_data *data);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
 int mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
+int mmc_execute_tuning(struct mmc *mmc, uint opcode);
+int mmc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+		  struct mmc_data *data);
+int mmc_wait_data(struct mmc *mmc, struct mmc_data *data);
 
 #else
 struct mmc_ops {
@@ -384,6 +455,10 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
+	int (*start_cmd)(struct mmc *mmc,
+			 struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*wait_data)(struct mmc *mmc, struct mmc_data *data);
 };
 #endif
 
@@ -406,6 +481,23 @@ struct sd_ssr {
 	unsigned int erase_offset;	/* In milliseconds */
 };
 
+/* Bus timing the card has been switched to, for the host's set_ios() */
+enum mmc_timing {
+	MMC_TIMING_LEGACY,
+	MMC_TIMING_HS,		/* SD high speed or MMC 26/52MHz SDR */
+	MMC_TIMING_DDR52,
+	MMC_TIMING_HS200,
+};
+
+/* A read queued with mmc_bread_submit() */
+struct mmc_async_read {
+	struct mmc_data data;
+	lbaint_t blkcnt;	/* blocks being read, 0 if none */
+	bool sbc;		/* announced with CMD23, so no CMD12 */
+	bool in_flight;		/* the host is still moving the data */
+	int ret;		/* result, once !in_flight */
+};
+
 /*
  * With CONFIG_DM_MMC enabled, struct mmc can be accessed from the MMC device
  * with mmc_get_mmc_dev().
@@ -434,11 +526,15 @@ struct mmc {
 	u8 part_support;
 	u8 part_attr;
 	u8 wr_rel_set;
+	u8 wr_rel_param;
+	u8 rel_wr_sec_c;	/* legacy reliable write size, in sectors */
+	u8 reliable_write;	/* 1 to write with reliable write requests */
 	u8 part_config;
 	uint tran_speed;
 	uint read_bl_len;
 	uint write_bl_len;
 	uint erase_grp_size;	/* in 512-byte sectors */
+	u8 erased_zero;		/* 1 if erased blocks read back as zeroes */
 	uint hc_wp_grp_size;	/* in 512-byte sectors */
 	struct sd_ssr	ssr;	/* SD status register */
 	u64 capacity;
@@ -455,6 +551,8 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	enum mmc_timing timing;
+	struct mmc_async_read async;
 #if CONFIG_IS_ENABLED(DM_MMC)
 	struct udevice *dev;	/* Device for this MMC controller */
 #endif
@@ -540,6 +638,71 @@ int mmc_set_part_conf(struct mmc *mmc, u8 ack, u8 part_num, u8 access);
 int mmc_set_boot_bus_width(struct mmc *mmc, u8 width, u8 reset, u8 mode);
 /* Function to modify the RST_n_FUNCTION field of EXT_CSD */
 int mmc_set_rst_n_function(struct mmc *mmc, u8 enable);
+
+/**
+ * mmc_send_tuning() - read the tuning block and check it
+ *
+ * This is for the execute_tuning() method of host drivers, to test a
+ * sampling phase.
+ *
+ * @mmc:	MMC device
+ * @opcode:	Tuning command (MMC_CMD_SEND_TUNING_BLOCK_HS200)
+ * @return 0 if the block was received intact, -ve otherwise
+ */
+int mmc_send_tuning(struct mmc *mmc, uint opcode);
+
+/**
+ * mmc_set_reliable_write() - write the card with reliable write requests
+ *
+ * A reliable write either completes or leaves the old data in place, even
+ * across a power failure. This needs CMD23 support from the host and an
+ * eMMC card; writes are slower, so it is meant for small critical updates.
+ *
+ * @mmc:	MMC device
+ * @enable:	true to use reliable writes, false to go back to normal ones
+ * @return 0 if OK, -EOPNOTSUPP if the card or host cannot do it
+ */
+int mmc_set_reliable_write(struct mmc *mmc, bool enable);
+
+/**
+ * mmc_bread_submit() - start reading blocks without waiting for them
+ *
+ * The read goes on while the caller works on something else, such as the
+ * data from the previous read. It must be ended with mmc_bread_complete()
+ * before @dst is used. Only one read can be queued per device; any other
+ * command or bus change sent to the device waits for it to finish first.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @dst:	Buffer for the data
+ * @return number of blocks queued, which may be less than @blkcnt if the
+ *	host cannot do so many at once, or -ve on error (-EBUSY if a read
+ *	is already queued)
+ */
+long mmc_bread_submit(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt, void *dst);
+
+/**
+ * mmc_bread_complete() - wait for the read queued by mmc_bread_submit()
+ *
+ * @block_dev:	Block device being read
+ * @return number of blocks read, or -ve on error (-ENOENT if no read is
+ *	queued)
+ */
+long mmc_bread_complete(struct blk_desc *block_dev);
+
+/**
+ * mmc_erase_zero_grp() - find out whether erasing blocks zeroes them
+ *
+ * This lets a caller erase a run of zero blocks rather than write it, for
+ * example when flashing an image with large empty areas.
+ *
+ * @block_dev:	Block device to check
+ * @return erase group size in blocks if erased blocks read back as zeroes,
+ *	0 if they do not or the device cannot be found
+ */
+lbaint_t mmc_erase_zero_grp(struct blk_desc *block_dev);
 /* Functions to read / write the RPMB partition */
 int mmc_rpmb_set_key(struct mmc *mmc, void *key);
 int mmc_rpmb_get_counter(struct mmc *mmc, unsigned long *counter);
@@ -28,12 +28,22 @@
 
 #ifdef CONFIG_SYS_RX_ETH_BUFFER
 # define PKTBUFSRX	CONFIG_SYS_RX_ETH_BUFFER
-#else
+#elif defined(CONFIG_SPL_BUILD)
 # define PKTBUFSRX	4
+#else
+/* Enough to hold a TFTP window or TCP burst arriving back to back */
+# define PKTBUFSRX	16
 #endif
 
 #define PKTALIGN	ARCH_DMA_MINALIGN
 
+#ifdef CONFIG_IP_DEFRAG
+/* The biggest IP packet that fragments are put back together into */
+#ifndef CONFIG_NET_MAXDEFRAG
+#define CONFIG_NET_MAXDEFRAG 16384
+#endif
+#endif
+
 /* ARP hardware address length */
 #define ARP_HLEN 6
 /*
@@ -83,6 +93,32 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/**
+ * struct eth_rx_split - Where a protocol wants the data of a packet to go
+ *
+ * A protocol which knows the headers of the next packet it expects, and
+ * where the data in it is to be stored, can ask for that packet to be split
+ * on receive. This saves copying the data out of the packet buffer. See
+ * eth_set_rx_split().
+ *
+ * @hdr_len: Number of bytes at the start of the packet, up to the data, which
+ *	     are received into the packet buffer as usual
+ * @dst: Where the bytes after @hdr_len are received
+ * @len: Most bytes that may be received at @dst
+ * @match: Check the headers of a split packet, returning true if it is the
+ *	   one expected. If not, the packet is put back together and handled
+ *	   like any other
+ * @placed: Set while a matching packet is handled, so that the protocol
+ *	    knows that its data is at @dst already
+ */
+struct eth_rx_split {
+	int hdr_len;
+	void *dst;
+	int len;
+	bool (*match)(uchar *pkt, int len);
+	bool placed;
+};
+
 #ifdef CONFIG_DM_ETH
 /**
  * struct eth_pdata - Platform data for Ethernet MAC controllers
@@ -107,6 +143,28 @@ enum eth_recv_flags {
 	ETH_RECV_CHECK_DEVICE		= 1 << 0,
 };
 
+/**
+ * struct eth_rx_stats - How packets came in from an Ethernet device
+ *
+ * Each call to eth_rx() is a poll. It handles up to CONFIG_NET_RX_BUDGET
+ * packets, checking the device again while packets keep arriving.
+ *
+ * @polls: Number of polls
+ * @busy_polls: Polls which handled at least one packet
+ * @packets: Number of packets handled
+ * @checks: Number of times the device was checked for new packets
+ * @max_batch: Most packets handled in one poll
+ * @budget_hit: Polls which stopped at the budget, with packets maybe waiting
+ */
+struct eth_rx_stats {
+	ulong polls;
+	ulong busy_polls;
+	ulong packets;
+	ulong checks;
+	ulong max_batch;
+	ulong budget_hit;
+};
+
 /**
  * struct eth_ops - functions of Ethernet MAC controllers
  *
@@ -116,10 +174,19 @@ enum eth_recv_flags {
  *	 packet buffer in the packetp parameter. If not, return an error or 0 to
  *	 indicate that the hardware receive FIFO is empty. If 0 is returned, the
  *	 network stack will not process the empty packet, but free_pkt() will be
- *	 called if supplied
+ *	 called if supplied. recv is called repeatedly in one poll: the first
+ *	 call, and any after a call which drained the packets found by the
+ *	 previous device check, have ETH_RECV_CHECK_DEVICE set. Without it the
+ *	 driver should return only packets it already holds, e.g. the rest of
+ *	 a USB transfer carrying several, and -EAGAIN once there are none
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
+ * recv_split: Like recv, but for a packet longer than split->hdr_len, put the
+ *	       bytes after that at split->dst rather than in the packet
+ *	       buffer. Packets with more than split->len such bytes are
+ *	       received whole, though split->dst may have been written. Only
+ *	       called while a protocol has asked for splitting - optional
  * stop: Stop the hardware from looking for packets - may be called even if
  *	 state == PASSIVE
  * mcast: Join or leave a multicast group (for TFTP) - optional
@@ -137,6 +204,8 @@ struct eth_ops {
 	int (*start)(struct udevice *dev);
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
+	int (*recv_split)(struct udevice *dev, int flags, uchar **packetp,
+			  const struct eth_rx_split *split);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
 	void (*stop)(struct udevice *dev);
 #ifdef CONFIG_MCAST_TFTP
@@ -160,6 +229,27 @@ unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
 int eth_init_state_only(void); /* Set active state */
 void eth_halt_state_only(void); /* Set passive state */
+
+/**
+ * eth_set_rx_split() - Ask for the packet expected next to be split
+ *
+ * If the driver supports it, packets received from now on are split as
+ * @split says until one of them matches. After that no more are split until
+ * this is called again. Packets which do not match may still have written
+ * their data at @split->dst, so nothing of value may be kept there. Drivers
+ * without a recv_split() operation receive every packet whole.
+ *
+ * @split:	How to split the packet, or NULL to stop splitting
+ */
+void eth_set_rx_split(struct eth_rx_split *split);
+
+/**
+ * eth_get_rx_stats() - Get the receive statistics of a device
+ *
+ * @dev:	Ethernet device
+ * @return the statistics, which the caller may clear
+ */
+struct eth_rx_stats *eth_get_rx_stats(struct udevice *dev);
 #endif
 
 #ifndef CONFIG_DM_ETH
@@ -218,6 +308,11 @@ static __always_inline void eth_halt_state_only(void)
 	eth_get_dev()->state = ETH_STATE_PASSIVE;
 }
 
+/* Only driver model Ethernet can split packets */
+static inline void eth_set_rx_split(struct eth_rx_split *split)
+{
+}
+
 /*
  * Set the hardware address for an ethernet interface based on 'eth%daddr'
  * environment variable (or just 'ethaddr' if eth_number is 0).
@@ -353,6 +448,7 @@ struct vlan_ethernet_hdr {
 #define PROT_PPP_SES	0x8864		/* PPPoE session messages	*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -538,7 +634,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL
+	TFTPSRV, TFTPPUT, LINKLOCAL, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -673,9 +769,29 @@ static inline void net_send_packet(uchar *pkt, int len)
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit "net_tx_packet" as IP packet, performing ARP request if needed
+ *  (ether will be populated)
+ *
+ * @param ether Raw packet buffer
+ * @param dest IP address to send the datagram to
+ * @param proto IP protocol number (IPPROTO_...)
+ * @param payload_len Length of data after the IP header, which the caller
+ *	has put in place
+ */
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int proto,
+		       int payload_len);
+
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
+/*
+ * Processes a packet received split as @split asked, with the bytes after
+ * @split->hdr_len at @split->dst
+ */
+void net_process_split_packet(uchar *in_packet, int len,
+			      struct eth_rx_split *split);
+
 #ifdef CONFIG_NETCONSOLE
 void nc_start(void);
 int nc_input_packet(uchar *pkt, struct in_addr src_ip, unsigned dest_port,
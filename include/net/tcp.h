@@ -0,0 +1,132 @@
+/*
+ * Minimal TCP client, for loading files over HTTP
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	Internet Protocol (IP) + TCP header, without TCP options.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* sequence number		*/
+	u32		tcp_ack;	/* acknowledgement number	*/
+	u8		tcp_hlen;	/* header length, in words << 4	*/
+	u8		tcp_flags;	/* TCP_FIN etc.			*/
+	u16		tcp_win;	/* receive window		*/
+	u16		tcp_xsum;	/* checksum			*/
+	u16		tcp_urg;	/* urgent pointer		*/
+} __attribute__((packed));
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/**
+ * enum tcp_event - Things that happen to a connection
+ *
+ * @TCP_EVENT_CONNECTED:	The handshake is done and data may be sent
+ * @TCP_EVENT_CLOSED:		The peer has closed the connection, after
+ *				sending all of its data
+ * @TCP_EVENT_RESET:		The peer has reset the connection
+ * @TCP_EVENT_TIMEOUT:		The peer has stopped answering
+ */
+enum tcp_event {
+	TCP_EVENT_CONNECTED,
+	TCP_EVENT_CLOSED,
+	TCP_EVENT_RESET,
+	TCP_EVENT_TIMEOUT,
+};
+
+/**
+ * tcp_rx_handler - Called with data received in order
+ *
+ * @data:	Next bytes from the peer, valid only until return
+ * @len:	Number of bytes
+ */
+typedef void tcp_rx_handler(const uchar *data, unsigned int len);
+
+/**
+ * tcp_event_handler - Called when the state of the connection changes
+ *
+ * After any event but TCP_EVENT_CONNECTED the connection is closed.
+ *
+ * @event:	What happened
+ */
+typedef void tcp_event_handler(enum tcp_event event);
+
+/**
+ * tcp_connect() - Open a connection
+ *
+ * Only one connection is open at a time, from a net_loop() protocol's start
+ * function. This sends a SYN and returns; @event is called once the peer
+ * answers. The TCP code takes over the net_loop() timeout handler until the
+ * connection is closed.
+ *
+ * @dest:	IP address of the peer
+ * @dport:	TCP port to connect to
+ * @rx:		Called with each piece of data received
+ * @event:	Called when the connection opens or closes
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_handler *rx,
+		tcp_event_handler *event);
+
+/**
+ * tcp_send() - Send data on the open connection
+ *
+ * The data is copied and resent until the peer has it.
+ *
+ * @data:	Data to send
+ * @len:	Number of bytes
+ * @return 0 if OK, -ENOTCONN if the connection is not open, -ENOSPC if
+ *	there is no room to hold @data until it is acknowledged
+ */
+int tcp_send(const void *data, unsigned int len);
+
+/**
+ * tcp_close() - Close the connection
+ *
+ * This sends a FIN and stops calling the handlers. It does nothing if the
+ * connection is closed already.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_stop() - Forget the connection
+ *
+ * Unlike tcp_close() this sends nothing; the handlers are not called again
+ * and the peer's segments are ignored. net_loop() uses it so that a
+ * connection left open when it stopped early does not live on into the
+ * next one.
+ */
+void tcp_stop(void);
+
+/**
+ * tcp_receive() - Handle a TCP segment
+ *
+ * @ip:		IP packet holding the segment, with a valid IP header
+ * @len:	Length of the IP packet
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, unsigned int len);
+
+#endif /* __TCP_H__ */
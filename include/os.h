@@ -163,6 +163,31 @@ void *os_realloc(void *ptr, size_t length);
  */
 void os_usleep(unsigned long usec);
 
+/**
+ * Start a thread of the os
+ *
+ * The thread runs until the program exits; U-Boot uses them to stand in
+ * for secondary CPUs.
+ *
+ * @func:	Function for the thread to run
+ * @arg:	Argument to pass to it
+ * @return 0 if OK, -1 on error
+ */
+int os_thread_create(void *(*func)(void *arg), void *arg);
+
+/**
+ * Wait for os_event_signal() to be called
+ *
+ * This returns at once if it has been called since this thread last
+ * returned from here, much like the ARM wfe instruction.
+ */
+void os_event_wait(void);
+
+/**
+ * Wake every thread waiting in os_event_wait()
+ */
+void os_event_signal(void);
+
 /**
  * Gets a monotonic increasing number of nano seconds from the OS
  *
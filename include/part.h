@@ -106,6 +106,14 @@ int part_get_info_whole_disk(struct blk_desc *dev_desc, disk_partition_t *info);
 
 void part_print(struct blk_desc *dev_desc);
 void part_init(struct blk_desc *dev_desc);
+/**
+ * part_cache_free() - drop the cached partition table of a device
+ *
+ * The cache is rebuilt on the next lookup. This only needs to be called when
+ * the device goes away; changes to the partitions are picked up through
+ * dev_desc->part_gen.
+ */
+void part_cache_free(struct blk_desc *dev_desc);
 void dev_print(struct blk_desc *dev_desc);
 
 /**
@@ -229,6 +237,7 @@ static inline int part_get_info_whole_disk(struct blk_desc *dev_desc,
 { return -1; }
 static inline void part_print(struct blk_desc *dev_desc) {}
 static inline void part_init(struct blk_desc *dev_desc) {}
+static inline void part_cache_free(struct blk_desc *dev_desc) {}
 static inline void dev_print(struct blk_desc *dev_desc) {}
 static inline int blk_get_device_by_str(const char *ifname, const char *dev_str,
 					struct blk_desc **dev_desc)
@@ -274,6 +283,22 @@ struct part_driver {
 	int (*get_info)(struct blk_desc *dev_desc, int part,
 			disk_partition_t *info);
 
+	/**
+	 * get_info_all() - Get information about all partitions at once
+	 *
+	 * This is optional. It is used to fill the partition cache with a
+	 * single pass over the table; tables of drivers without it are not
+	 * cached. It must not print anything for unused entries.
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @info:	Returns partition information for partitions 1 to
+	 *		@count, with blksz set to 0 for unused entries
+	 * @count:	Number of entries in @info (max_entries)
+	 * @return 0 if OK, -ve if there is no valid partition table
+	 */
+	int (*get_info_all)(struct blk_desc *dev_desc, disk_partition_t *info,
+			    int count);
+
 	/**
 	 * print() - Print partition information
 	 *
@@ -78,6 +78,20 @@ int usb_ether_deregister(struct ueth_data *ueth);
  */
 int usb_ether_receive(struct ueth_data *ueth, int rxsize);
 
+/**
+ * usb_ether_receive_more() - receive more data after what is held
+ *
+ * This is for devices that may split a packet across bulk transfers. Bytes
+ * not yet passed to usb_ether_advance_rxbuf() are kept, and the new data is
+ * stored straight after them.
+ *
+ * @ueth:	USB Ethernet device
+ * @rxsize:	Maximum size to receive
+ * @return 0 if data was received, -EAGAIN if not, -ENOSPC if there is no room
+ * for @rxsize bytes after those held, other -ve on error
+ */
+int usb_ether_receive_more(struct ueth_data *ueth, int rxsize);
+
 /**
  * usb_ether_get_rx_bytes() - obtain bytes from the internal packet buffer
  *
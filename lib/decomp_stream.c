@@ -0,0 +1,82 @@
+/*
+ * Decompression of data which arrives a piece at a time
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <decomp_stream.h>
+#include <errno.h>
+#include <image.h>
+#include <asm/unaligned.h>
+
+#define GZIP_MAGIC	0x8b1f
+#define LZ4F_MAGIC	0x184d2204
+
+int decomp_stream_start(struct decomp_stream *ds, void *dst, size_t size,
+			const void *src, size_t len)
+{
+	size_t used = 0;
+	int ret;
+
+	memset(ds, '\0', sizeof(*ds));
+	ds->dst = dst;
+	ds->size = size;
+
+	if (len >= 2 && get_unaligned_le16(src) == GZIP_MAGIC) {
+		ds->comp = IH_COMP_GZIP;
+		ret = gunzip_stream_start(ds);
+	} else if (IS_ENABLED(CONFIG_LZ4) && len >= 4 &&
+		   get_unaligned_le32(src) == LZ4F_MAGIC) {
+		ds->comp = IH_COMP_LZ4;
+		ret = ulz4_stream_start(ds, src, len, &used);
+	} else {
+		return -EPROTONOSUPPORT;
+	}
+	if (ret) {
+		ds->comp = IH_COMP_NONE;
+		return ret;
+	}
+
+	ret = decomp_stream_feed(ds, src + used, len - used);
+	if (ret)
+		decomp_stream_end(ds);
+
+	return ret;
+}
+
+int decomp_stream_feed(struct decomp_stream *ds, const void *src, size_t len)
+{
+	if (ds->err || ds->done)
+		return ds->err;
+
+	switch (ds->comp) {
+	case IH_COMP_GZIP:
+		ds->err = gunzip_stream_feed(ds, src, len);
+		break;
+	case IH_COMP_LZ4:
+		ds->err = ulz4_stream_feed(ds, src, len);
+		break;
+	}
+
+	return ds->err;
+}
+
+int decomp_stream_end(struct decomp_stream *ds)
+{
+	switch (ds->comp) {
+	case IH_COMP_GZIP:
+		gunzip_stream_end(ds);
+		break;
+	case IH_COMP_LZ4:
+		ulz4_stream_end(ds);
+		break;
+	default:
+		return -EINVAL;
+	}
+	ds->comp = IH_COMP_NONE;
+	if (ds->err)
+		return ds->err;
+
+	return ds->done ? 0 : -EINVAL;
+}
@@ -10,9 +10,12 @@
 #include <command.h>
 #include <console.h>
 #include <image.h>
+#include <job.h>
 #include <malloc.h>
+#include <mmc.h>
 #include <memalign.h>
 #include <u-boot/zlib.h>
+#include <decomp_stream.h>
 #include <div64.h>
 
 #define HEADER0			'\x1f'
@@ -114,6 +117,75 @@ void gzwrite_progress_finish(int returnval,
 	}
 }
 
+/*
+ * gzwrite() inflates each chunk, on another CPU if there is one, while the
+ * chunk before it is written
+ */
+struct gzwrite_inflate {
+	z_stream s;
+	unsigned char *buf;	/* where to put the next chunk */
+	unsigned long size;	/* size of a chunk */
+	unsigned long filled;	/* bytes inflated into @buf */
+	unsigned crc;		/* crc32 of all output so far */
+	bool check_zero;	/* work out @zero */
+	bool zero;		/* @buf is all zeroes */
+	int r;			/* what inflate() returned */
+};
+
+static bool gzwrite_is_zero(const unsigned char *buf, unsigned long len)
+{
+	const ulong *p = (const ulong *)buf;
+	unsigned long i;
+
+	for (i = 0; i < len / sizeof(ulong); i++) {
+		if (p[i])
+			return false;
+	}
+	for (i *= sizeof(ulong); i < len; i++) {
+		if (buf[i])
+			return false;
+	}
+
+	return true;
+}
+
+static int gzwrite_inflate(void *arg)
+{
+	struct gzwrite_inflate *gi = arg;
+
+	gi->s.avail_out = gi->size;
+	gi->s.next_out = gi->buf;
+	gi->r = inflate(&gi->s, Z_SYNC_FLUSH);
+	if (gi->r != Z_OK && gi->r != Z_STREAM_END)
+		return gi->r;
+	gi->filled = gi->size - gi->s.avail_out;
+	gi->crc = crc32(gi->crc, gi->buf, gi->filled);
+	gi->zero = gi->check_zero && gzwrite_is_zero(gi->buf, gi->filled);
+
+	return 0;
+}
+
+/* Blocks per erase group if erasing zeroes blocks on @dev, else 0 */
+static lbaint_t gzwrite_erase_grp(struct blk_desc *dev)
+{
+#if defined(CONFIG_MMC) && !defined(CONFIG_SPL_BUILD)
+	if (dev->if_type == IF_TYPE_MMC)
+		return mmc_erase_zero_grp(dev);
+#endif
+	return 0;
+}
+
+/* Erase a run of zero chunks put off by gzwrite() */
+static int gzwrite_erase(struct blk_desc *dev, lbaint_t start, lbaint_t cnt)
+{
+	if (cnt && blk_derase(dev, start, cnt) != cnt) {
+		printf("gzwrite: erase failed at block " LBAF "\n", start);
+		return -1;
+	}
+
+	return 0;
+}
+
 int gzwrite(unsigned char *src, int len,
 	    struct blk_desc *dev,
 	    unsigned long szwritebuf,
@@ -121,15 +193,18 @@ int gzwrite(unsigned char *src, int len,
 	    u64 szexpected)
 {
 	int i, flags;
-	z_stream s;
+	struct gzwrite_inflate gi;
+	struct job job;
 	int r = 0;
-	unsigned char *writebuf;
-	unsigned crc = 0;
+	unsigned char *writebuf[2];
+	int cur = 0;
 	u64 totalfilled = 0;
 	lbaint_t blksperbuf, outblock;
+	lbaint_t erase_grp, erasestart = 0, erasecnt = 0;
 	u32 expected_crc;
 	u32 payload_size;
 	int iteration = 0;
+	bool last;
 
 	if (!szwritebuf ||
 	    (szwritebuf % dev->blksz) ||
@@ -190,81 +265,135 @@ int gzwrite(unsigned char *src, int len,
 		return -1;
 	}
 
+	writebuf[0] = malloc_cache_aligned(2 * szwritebuf);
+	if (!writebuf[0]) {
+		printf("%s: cannot allocate %lu bytes\n", __func__,
+		       2 * szwritebuf);
+		return -1;
+	}
+	writebuf[1] = writebuf[0] + szwritebuf;
+
 	gzwrite_progress_init(szexpected);
 
-	s.zalloc = gzalloc;
-	s.zfree = gzfree;
+	memset(&gi, '\0', sizeof(gi));
+	gi.s.zalloc = gzalloc;
+	gi.s.zfree = gzfree;
 
-	r = inflateInit2(&s, -MAX_WBITS);
+	r = inflateInit2(&gi.s, -MAX_WBITS);
 	if (r != Z_OK) {
 		printf("Error: inflateInit2() returned %d\n", r);
+		free(writebuf[0]);
 		return -1;
 	}
 
-	s.next_in = src + i;
-	s.avail_in = payload_size+8;
-	writebuf = (unsigned char *)malloc_cache_aligned(szwritebuf);
+	gi.s.next_in = src + i;
+	gi.s.avail_in = payload_size+8;
+	gi.size = szwritebuf;
+
+	/*
+	 * Chunks of zeroes which cover whole erase groups are erased rather
+	 * than written, if erasing leaves zeroes behind
+	 */
+	erase_grp = gzwrite_erase_grp(dev);
+	gi.check_zero = erase_grp != 0;
+
+	/*
+	 * The first chunk is inflated here, since that allocates inflate's
+	 * window and jobs must not call malloc()
+	 */
+	gi.buf = writebuf[cur];
+	r = gzwrite_inflate(&gi);
 
 	/* decompress until deflate stream ends or end of file */
-	do {
-		if (s.avail_in == 0) {
+	for (;;) {
+		unsigned long blocks_written;
+		unsigned long numfilled;
+		lbaint_t writeblocks;
+		bool zero;
+
+		if (r) {
+			printf("Error: inflate() returned %d\n", r);
+			goto out;
+		}
+		numfilled = gi.filled;
+		zero = gi.zero;
+		totalfilled += numfilled;
+		last = gi.r == Z_STREAM_END || gi.s.avail_out;
+		if (last && gi.r != Z_STREAM_END)
 			printf("%s: weird termination with result %d\n",
-			       __func__, r);
-			break;
+			       __func__, gi.r);
+
+		/* Inflate the next chunk while this one is written */
+		if (!last) {
+			gi.buf = writebuf[!cur];
+			job_submit(&job, gzwrite_inflate, &gi);
 		}
 
-		/* run inflate() on input until output buffer not full */
-		do {
-			unsigned long blocks_written;
-			int numfilled;
-			lbaint_t writeblocks;
-
-			s.avail_out = szwritebuf;
-			s.next_out = writebuf;
-			r = inflate(&s, Z_SYNC_FLUSH);
-			if ((r != Z_OK) &&
-			    (r != Z_STREAM_END)) {
-				printf("Error: inflate() returned %d\n", r);
-				goto out;
-			}
-			numfilled = szwritebuf - s.avail_out;
-			crc = crc32(crc, writebuf, numfilled);
-			totalfilled += numfilled;
-			if (numfilled < szwritebuf) {
-				writeblocks = (numfilled+dev->blksz-1)
-						/ dev->blksz;
-				memset(writebuf+numfilled, 0,
-				       dev->blksz-(numfilled%dev->blksz));
-			} else {
-				writeblocks = blksperbuf;
-			}
+		if (numfilled < szwritebuf) {
+			writeblocks = (numfilled+dev->blksz-1)
+					/ dev->blksz;
+			memset(writebuf[cur]+numfilled, 0,
+			       dev->blksz-(numfilled%dev->blksz));
+		} else {
+			writeblocks = blksperbuf;
+		}
 
-			gzwrite_progress(iteration++,
-					 totalfilled,
-					 szexpected);
-			blocks_written = blk_dwrite(dev, outblock,
-						    writeblocks, writebuf);
-			outblock += blocks_written;
-			if (ctrlc()) {
-				puts("abort\n");
-				goto out;
+		gzwrite_progress(iteration++,
+				 totalfilled,
+				 szexpected);
+		if (zero && writeblocks &&
+		    !(outblock % erase_grp) && !(writeblocks % erase_grp)) {
+			/* Put off erasing, to erase the whole run at once */
+			if (!erasecnt)
+				erasestart = outblock;
+			erasecnt += writeblocks;
+			blocks_written = writeblocks;
+		} else {
+			r = gzwrite_erase(dev, erasestart, erasecnt);
+			erasecnt = 0;
+			blocks_written = r ? 0 : blk_dwrite(dev, outblock,
+							    writeblocks,
+							    writebuf[cur]);
+			if (!r && blocks_written != writeblocks) {
+				printf("%s: write failed at block " LBAF "\n",
+				       __func__, outblock + blocks_written);
+				r = -1;
 			}
-			WATCHDOG_RESET();
-		} while (s.avail_out == 0);
-		/* done when inflate() says it's done */
-	} while (r != Z_STREAM_END);
+		}
+		outblock += blocks_written;
+		if (!r && ctrlc()) {
+			puts("abort\n");
+			r = -1;
+		}
+		WATCHDOG_RESET();
+
+		if (r) {
+			if (!last)
+				job_wait(&job);
+			goto out;
+		}
+		if (last)
+			break;
+		r = job_wait(&job);
+		cur = !cur;
+	}
+	/* done when inflate() says it's done */
+	if (gzwrite_erase(dev, erasestart, erasecnt)) {
+		r = -1;
+		goto out;
+	}
 
 	if ((szexpected != totalfilled) ||
-	    (crc != expected_crc))
+	    (gi.crc != expected_crc))
 		r = -1;
 	else
 		r = 0;
 
 out:
 	gzwrite_progress_finish(r, totalfilled, szexpected,
-				expected_crc, crc);
-	free(writebuf);
-	inflateEnd(&s);
+				expected_crc, gi.crc);
+	free(writebuf[0]);
+	inflateEnd(&gi.s);
 
 	return r;
 }
@@ -306,3 +435,92 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 
 	return err;
 }
+
+#ifdef CONFIG_DECOMP_STREAM
+/*
+ * Enough for inflate's state and a 32KB window. Taking these from here
+ * rather than malloc() lets gunzip_stream_feed() run as a job.
+ */
+#define GUNZIP_STREAM_ARENA	(48 << 10)
+
+struct gunzip_stream {
+	z_stream s;
+	size_t used;
+	u8 arena[GUNZIP_STREAM_ARENA] __aligned(ZALLOC_ALIGNMENT);
+};
+
+static void *gunzip_stream_alloc(void *x, unsigned items, unsigned size)
+{
+	struct gunzip_stream *gs = x;
+	size_t len = ALIGN((size_t)items * size, ZALLOC_ALIGNMENT);
+	void *p;
+
+	if (len > sizeof(gs->arena) - gs->used)
+		return NULL;
+	p = gs->arena + gs->used;
+	gs->used += len;
+
+	return p;
+}
+
+static void gunzip_stream_free(void *x, void *addr, unsigned nb)
+{
+}
+
+int gunzip_stream_start(struct decomp_stream *ds)
+{
+	struct gunzip_stream *gs;
+
+	gs = malloc(sizeof(*gs));
+	if (!gs)
+		return -ENOMEM;
+	memset(&gs->s, '\0', sizeof(gs->s));
+	gs->used = 0;
+	gs->s.zalloc = gunzip_stream_alloc;
+	gs->s.zfree = gunzip_stream_free;
+	gs->s.opaque = gs;
+
+	/* Let inflate() parse the gzip header and check the trailer */
+	if (inflateInit2(&gs->s, 16 + MAX_WBITS) != Z_OK) {
+		free(gs);
+		return -ENOMEM;
+	}
+	ds->state = gs;
+
+	return 0;
+}
+
+int gunzip_stream_feed(struct decomp_stream *ds, const void *src, size_t len)
+{
+	struct gunzip_stream *gs = ds->state;
+	z_stream *s = &gs->s;
+	int r;
+
+	s->next_in = (unsigned char *)src;
+	s->avail_in = len;
+	s->next_out = ds->dst + ds->out;
+	s->avail_out = ds->size - ds->out;
+	while (s->avail_in && !ds->done) {
+		r = inflate(s, Z_NO_FLUSH);
+		ds->out = s->next_out - (unsigned char *)ds->dst;
+		if (r == Z_STREAM_END)
+			ds->done = true;
+		else if (r == Z_BUF_ERROR)
+			return -ENOBUFS;	/* no space left to inflate to */
+		else if (r == Z_MEM_ERROR)
+			return -ENOMEM;
+		else if (r != Z_OK)
+			return -EPROTO;
+	}
+
+	return 0;
+}
+
+void gunzip_stream_end(struct decomp_stream *ds)
+{
+	struct gunzip_stream *gs = ds->state;
+
+	inflateEnd(&gs->s);
+	free(gs);
+}
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Job queue for running work on other CPUs
+ *
+ * Only the boot CPU submits jobs, so there is no locking: each worker has
+ * a slot which the boot CPU fills when it is empty and the worker empties
+ * when the job is done. Jobs that find every worker busy wait on a list
+ * which only the boot CPU looks at. Nothing here needs atomic
+ * read-modify-write instructions, which may not work with the caches off.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <job.h>
+
+#define JOB_MAX_WORKERS		8
+
+static struct job *job_slot[JOB_MAX_WORKERS];
+static struct job *job_pending;
+static struct job **job_pending_tail = &job_pending;
+static int job_worker_count = -1;
+
+/* Put in a worker's slot to make it return from job_worker() */
+static struct job job_stop;
+
+__weak int arch_job_start_workers(int max)
+{
+	return 0;
+}
+
+__weak void arch_job_stop_workers(int count)
+{
+}
+
+__weak void arch_job_idle(void)
+{
+}
+
+__weak void arch_job_notify(void)
+{
+}
+
+static void job_run(struct job *job)
+{
+	job->ret = job->func(job->arg);
+	__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+}
+
+void job_worker(int cpu)
+{
+	struct job *job;
+
+	for (;;) {
+		job = __atomic_load_n(&job_slot[cpu], __ATOMIC_ACQUIRE);
+		if (!job) {
+			arch_job_idle();
+			continue;
+		}
+		if (job == &job_stop) {
+			__atomic_store_n(&job_slot[cpu], NULL,
+					 __ATOMIC_RELEASE);
+			arch_job_notify();
+			return;
+		}
+		/* The boot CPU may reuse the job once it is done */
+		job_run(job);
+		__atomic_store_n(&job_slot[cpu], NULL, __ATOMIC_RELEASE);
+		arch_job_notify();
+	}
+}
+
+int job_workers(void)
+{
+	if (job_worker_count < 0) {
+		job_worker_count = arch_job_start_workers(JOB_MAX_WORKERS);
+		debug("%s: %d workers\n", __func__, job_worker_count);
+	}
+
+	return job_worker_count;
+}
+
+static struct job *job_pop(void)
+{
+	struct job *job = job_pending;
+
+	if (job) {
+		job_pending = job->next;
+		if (!job_pending)
+			job_pending_tail = &job_pending;
+	}
+
+	return job;
+}
+
+/* Hand waiting jobs to idle workers */
+static void job_dispatch(void)
+{
+	bool sent = false;
+	int cpu;
+
+	for (cpu = 0; cpu < job_worker_count && job_pending; cpu++) {
+		if (__atomic_load_n(&job_slot[cpu], __ATOMIC_ACQUIRE))
+			continue;
+		__atomic_store_n(&job_slot[cpu], job_pop(), __ATOMIC_RELEASE);
+		sent = true;
+	}
+	if (sent)
+		arch_job_notify();
+}
+
+void job_submit(struct job *job, int (*func)(void *arg), void *arg)
+{
+	job->func = func;
+	job->arg = arg;
+	job->ret = 0;
+	job->done = 0;
+	job->next = NULL;
+
+	if (job_workers() <= 0) {
+		job_run(job);
+		return;
+	}
+	*job_pending_tail = job;
+	job_pending_tail = &job->next;
+	job_dispatch();
+}
+
+int job_wait(struct job *job)
+{
+	struct job *other;
+
+	while (!__atomic_load_n(&job->done, __ATOMIC_ACQUIRE)) {
+		job_dispatch();
+		/* With every worker busy, run the next job here */
+		other = job_pop();
+		if (other)
+			job_run(other);
+		else
+			arch_job_idle();
+	}
+
+	return job->ret;
+}
+
+void job_stop_workers(void)
+{
+	struct job *job;
+	int cpu;
+
+	if (job_worker_count <= 0)
+		return;
+
+	/* Run anything still waiting, and let the workers finish theirs */
+	while ((job = job_pop()))
+		job_run(job);
+	for (cpu = 0; cpu < job_worker_count; cpu++) {
+		while (__atomic_load_n(&job_slot[cpu], __ATOMIC_ACQUIRE))
+			arch_job_idle();
+		__atomic_store_n(&job_slot[cpu], &job_stop, __ATOMIC_RELEASE);
+	}
+	arch_job_notify();
+
+	/* Each worker empties its slot as it leaves job_worker() */
+	for (cpu = 0; cpu < job_worker_count; cpu++) {
+		while (__atomic_load_n(&job_slot[cpu], __ATOMIC_ACQUIRE))
+			arch_job_idle();
+	}
+	arch_job_stop_workers(job_worker_count);
+	debug("%s: %d workers stopped\n", __func__, job_worker_count);
+
+	/* They are started again if there is more work */
+	job_worker_count = -1;
+}
@@ -6,12 +6,22 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <decomp_stream.h>
+#include <malloc.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
+#include <asm/unaligned.h>
 
-static u16 LZ4_readLE16(const void *src) { return le16_to_cpu(*(u16 *)src); }
-static void LZ4_copy4(void *dst, const void *src) { *(u32 *)dst = *(u32 *)src; }
-static void LZ4_copy8(void *dst, const void *src) { *(u64 *)dst = *(u64 *)src; }
+/*
+ * The copies may be unaligned. __builtin_memcpy() lets the compiler use
+ * wide accesses where the CPU allows unaligned ones, and keeps them safe
+ * where it does not (ARMv7 U-Boot traps unaligned accesses).
+ */
+static u16 LZ4_readLE16(const void *src) { return get_unaligned_le16(src); }
+static void LZ4_copy2(void *dst, const void *src) { __builtin_memcpy(dst, src, 2); }
+static void LZ4_copy4(void *dst, const void *src) { __builtin_memcpy(dst, src, 4); }
+static void LZ4_copy8(void *dst, const void *src) { __builtin_memcpy(dst, src, 8); }
+static void LZ4_copy16(void *dst, const void *src) { __builtin_memcpy(dst, src, 16); }
 
 typedef  uint8_t BYTE;
 typedef uint16_t U16;
@@ -21,7 +31,7 @@ typedef uint64_t U64;
 
 #define FORCE_INLINE static inline __attribute__((always_inline))
 
-/* Unaltered (except removing unrelated code) from github.com/Cyan4973/lz4. */
+/* From github.com/lz4/lz4, cut down to the block decoder used here. */
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 #define LZ4F_MAGIC 0x184D2204
@@ -63,12 +73,67 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
-int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+#define XXH32_P1	2654435761U
+#define XXH32_P2	2246822519U
+#define XXH32_P3	3266489917U
+#define XXH32_P4	668265263U
+#define XXH32_P5	374761393U
+
+static inline u32 xxh32_rol(u32 val, int shift)
+{
+	return (val << shift) | (val >> (32 - shift));
+}
+
+static inline u32 xxh32_round(u32 acc, u32 val)
+{
+	return xxh32_rol(acc + val * XXH32_P2, 13) * XXH32_P1;
+}
+
+/* XXH32 with a zero seed, which frames use for their block and content checksums */
+static u32 xxh32(const u8 *p, size_t len)
+{
+	const u8 *end = p + len;
+	u32 h;
+
+	if (len >= 16) {
+		u32 v1 = XXH32_P1 + XXH32_P2, v2 = XXH32_P2, v3 = 0;
+		u32 v4 = -XXH32_P1;
+
+		for (; end - p >= 16; p += 16) {
+			v1 = xxh32_round(v1, get_unaligned_le32(p));
+			v2 = xxh32_round(v2, get_unaligned_le32(p + 4));
+			v3 = xxh32_round(v3, get_unaligned_le32(p + 8));
+			v4 = xxh32_round(v4, get_unaligned_le32(p + 12));
+		}
+		h = xxh32_rol(v1, 1) + xxh32_rol(v2, 7) + xxh32_rol(v3, 12) +
+			xxh32_rol(v4, 18);
+	} else {
+		h = XXH32_P5;
+	}
+	h += len;
+
+	for (; end - p >= 4; p += 4)
+		h = xxh32_rol(h + get_unaligned_le32(p) * XXH32_P3, 17) *
+			XXH32_P4;
+	for (; p < end; p++)
+		h = xxh32_rol(h + *p * XXH32_P5, 11) * XXH32_P1;
+
+	h ^= h >> 15;
+	h *= XXH32_P2;
+	h ^= h >> 13;
+	h *= XXH32_P3;
+	h ^= h >> 16;
+
+	return h;
+}
+
+int ulz4fn_verify(const void *src, size_t srcn, void *dst, size_t *dstn,
+		  bool verify)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
-	int has_block_checksum;
+	int has_block_checksum, has_content_checksum;
 	int ret;
 	*dstn = 0;
 
@@ -79,13 +144,15 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 			return -EINVAL;	/* input overrun */
 
 		/* We assume there's always only a single, standard frame. */
-		if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+		if (get_unaligned_le32(&h->magic) != LZ4F_MAGIC ||
+		    h->version != 1)
 			return -EPROTONOSUPPORT;	/* unknown format */
 		if (h->reserved0 || h->reserved1 || h->reserved2)
 			return -EINVAL;	/* reserved must be zero */
 		if (!h->independent_blocks)
 			return -EPROTONOSUPPORT; /* we can't support this yet */
 		has_block_checksum = h->has_block_checksum;
+		has_content_checksum = h->has_content_checksum;
 
 		in += sizeof(*h);
 		if (h->has_content_size)
@@ -96,7 +163,11 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	while (1) {
 		struct lz4_block_header b;
 
-		b.raw = le32_to_cpu(*(u32 *)in);
+		if (in - src + sizeof(b) > srcn) {
+			ret = -EINVAL;		/* input overrun */
+			break;
+		}
+		b.raw = get_unaligned_le32(in);
 		in += sizeof(struct lz4_block_header);
 
 		if (in - src + b.size > srcn) {
@@ -109,6 +180,18 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 			break;
 		}
 
+		/* Check the block before in-place decompression overwrites it */
+		if (has_block_checksum && verify) {
+			if (in - src + b.size + sizeof(u32) > srcn) {
+				ret = -EINVAL;	/* input overrun */
+				break;
+			}
+			if (get_unaligned_le32(in + b.size) != xxh32(in, b.size)) {
+				ret = -EBADMSG;	/* block checksum mismatch */
+				break;
+			}
+		}
+
 		if (b.not_compressed) {
 			size_t size = min((ptrdiff_t)b.size, end - out);
 			memcpy(out, in, size);
@@ -118,10 +201,8 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 				break;
 			}
 		} else {
-			/* constant folding essential, do not touch params! */
 			ret = LZ4_decompress_generic(in, out, b.size,
-					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
+						     end - out);
 			if (ret < 0) {
 				ret = -EPROTO;	/* decompression error */
 				break;
@@ -134,6 +215,211 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 			in += sizeof(u32);
 	}
 
+	if (!ret && has_content_checksum && verify) {
+		if (in - src + sizeof(u32) > srcn)
+			ret = -EINVAL;	/* input overrun */
+		else if (get_unaligned_le32(in) != xxh32(dst, out - dst))
+			ret = -EBADMSG;	/* content checksum mismatch */
+	}
+
 	*dstn = out - dst;
 	return ret;
 }
+
+int ulz4fn_frame_info(const void *src, size_t srcn, size_t *framen,
+		      u64 *content)
+{
+	const struct lz4_frame_header *h = src;
+	const void *in = src;
+	struct lz4_block_header b;
+
+	if (srcn < sizeof(*h) + sizeof(u8))
+		return -EINVAL;	/* input overrun */
+	if (get_unaligned_le32(&h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+
+	in += sizeof(*h);
+	*content = -1ULL;
+	if (h->has_content_size) {
+		if (srcn < sizeof(*h) + sizeof(u64) + sizeof(u8))
+			return -EINVAL;
+		*content = get_unaligned_le64(in);
+		in += sizeof(u64);
+	}
+	in += sizeof(u8);
+
+	do {
+		if (in - src + sizeof(b) > srcn)
+			return -EINVAL;
+		b.raw = get_unaligned_le32(in);
+		in += sizeof(b);
+		if (!b.size)
+			break;
+		in += b.size;
+		if (h->has_block_checksum)
+			in += sizeof(u32);
+	} while (in - src <= srcn);
+	if (h->has_content_checksum)
+		in += sizeof(u32);
+	if (in - src > srcn)
+		return -EINVAL;
+	*framen = in - src;
+
+	return 0;
+}
+
+int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	return ulz4fn_verify(src, srcn, dst, dstn, true);
+}
+
+#ifdef CONFIG_DECOMP_STREAM
+enum {
+	ULZ4_BLOCK_HEADER,
+	ULZ4_BLOCK,
+	ULZ4_CONTENT_CHECKSUM,
+};
+
+/*
+ * A frame being decompressed a piece at a time. Each block is decompressed
+ * straight from the input if it is all there, else it is first gathered
+ * in @buf, which is big enough for the largest block the frame allows.
+ */
+struct ulz4_stream {
+	int step;		/* what the next item is (ULZ4_...) */
+	bool has_block_checksum;
+	bool has_content_checksum;
+	struct lz4_block_header block;	/* header of the block in @buf */
+	size_t max_block;
+	size_t need;		/* size of the next item */
+	size_t have;		/* bytes of it gathered in @buf */
+	u8 buf[];
+};
+
+int ulz4_stream_start(struct decomp_stream *ds, const void *src, size_t len,
+		      size_t *used)
+{
+	const struct lz4_frame_header *h = src;
+	struct ulz4_stream *ls;
+	size_t max_block;
+
+	if (len < sizeof(*h) + sizeof(u8))
+		return -EINVAL;	/* input overrun */
+	if (get_unaligned_le32(&h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if (h->reserved0 || h->reserved1 || h->reserved2)
+		return -EINVAL;	/* reserved must be zero */
+	if (!h->independent_blocks || h->max_block_size < 4)
+		return -EPROTONOSUPPORT;
+	*used = sizeof(*h) + (h->has_content_size ? sizeof(u64) : 0) +
+		sizeof(u8);
+	if (len < *used)
+		return -EINVAL;	/* input overrun */
+
+	/* 64KB, 256KB, 1MB or 4MB */
+	max_block = 1 << (2 * h->max_block_size + 8);
+	ls = malloc(sizeof(*ls) + max_block + sizeof(u32));
+	if (!ls)
+		return -ENOMEM;
+	ls->step = ULZ4_BLOCK_HEADER;
+	ls->has_block_checksum = h->has_block_checksum;
+	ls->has_content_checksum = h->has_content_checksum;
+	ls->max_block = max_block;
+	ls->need = sizeof(struct lz4_block_header);
+	ls->have = 0;
+	ds->state = ls;
+
+	return 0;
+}
+
+static int ulz4_stream_item(struct decomp_stream *ds, struct ulz4_stream *ls,
+			    const u8 *item)
+{
+	struct lz4_block_header b;
+	size_t space = ds->size - ds->out;
+	int ret;
+
+	switch (ls->step) {
+	case ULZ4_BLOCK_HEADER:
+		b.raw = get_unaligned_le32(item);
+		if (!b.size) {
+			if (ls->has_content_checksum) {
+				ls->step = ULZ4_CONTENT_CHECKSUM;
+				ls->need = sizeof(u32);
+			} else {
+				ds->done = true;
+			}
+			break;
+		}
+		if (b.size > ls->max_block)
+			return -EINVAL;	/* block too big for the frame */
+		ls->block = b;
+		ls->step = ULZ4_BLOCK;
+		ls->need = b.size + (ls->has_block_checksum ? sizeof(u32) : 0);
+		break;
+	case ULZ4_BLOCK:
+		b = ls->block;
+		if (ls->has_block_checksum &&
+		    get_unaligned_le32(item + b.size) != xxh32(item, b.size))
+			return -EBADMSG;	/* block checksum mismatch */
+		if (b.not_compressed) {
+			if (b.size > space)
+				return -ENOBUFS;	/* output overrun */
+			memcpy(ds->dst + ds->out, item, b.size);
+			ds->out += b.size;
+		} else {
+			ret = LZ4_decompress_generic((const char *)item,
+						     ds->dst + ds->out,
+						     b.size, space);
+			if (ret < 0)
+				return -EPROTO;	/* decompression error */
+			ds->out += ret;
+		}
+		ls->step = ULZ4_BLOCK_HEADER;
+		ls->need = sizeof(struct lz4_block_header);
+		break;
+	case ULZ4_CONTENT_CHECKSUM:
+		if (get_unaligned_le32(item) != xxh32(ds->dst, ds->out))
+			return -EBADMSG;	/* content checksum mismatch */
+		ds->done = true;
+		break;
+	}
+
+	return 0;
+}
+
+int ulz4_stream_feed(struct decomp_stream *ds, const void *src, size_t len)
+{
+	struct ulz4_stream *ls = ds->state;
+	const u8 *in = src, *end = in + len;
+	const u8 *item;
+	size_t take;
+	int ret;
+
+	while (in < end && !ds->done) {
+		if (!ls->have && end - in >= ls->need) {
+			item = in;
+			in += ls->need;
+		} else {
+			take = min((size_t)(end - in), ls->need - ls->have);
+			memcpy(ls->buf + ls->have, in, take);
+			ls->have += take;
+			in += take;
+			if (ls->have < ls->need)
+				break;
+			item = ls->buf;
+			ls->have = 0;
+		}
+		ret = ulz4_stream_item(ds, ls, item);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void ulz4_stream_end(struct decomp_stream *ds)
+{
+	free(ds->state);
+}
+#endif
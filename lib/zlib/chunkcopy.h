@@ -0,0 +1,110 @@
+/* chunkcopy.h -- match copies for the chunked inflate_fast()
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/*
+   The copies below move CHUNKCOPY_CHUNK_SIZE bytes at a time. Chunks are
+   moved with __builtin_memcpy() so that the compiler picks the widest
+   access the target allows: a single load and store where unaligned
+   accesses are fine, and a byte or word sequence without a loop where
+   they trap (ARMv7 U-Boot runs with alignment checking enabled).
+
+   chunkcopy_core() and chunkcopy_lapped() may write up to
+   CHUNKCOPY_CHUNK_SIZE - 1 bytes past the end of the copy. The bytes they
+   write there are junk to be overwritten by later output, so the caller
+   must have that much output space to spare (see INFLATE_FAST_MIN_OUTPUT).
+ */
+
+typedef uint64_t z_chunk_t;
+
+local inline z_chunk_t loadchunk(const unsigned char FAR *s)
+{
+    z_chunk_t c;
+
+    __builtin_memcpy(&c, s, sizeof(c));
+    return c;
+}
+
+local inline void storechunk(unsigned char FAR *d, z_chunk_t c)
+{
+    __builtin_memcpy(d, &c, sizeof(c));
+}
+
+/*
+   Copy len (> 0) bytes from from to out, where out - from is at least
+   CHUNKCOPY_CHUNK_SIZE. The first chunk is bumped by the remainder so that
+   the rest is a whole number of chunks. Returns out + len.
+ */
+local inline unsigned char FAR *chunkcopy_core(unsigned char FAR *out,
+                                               const unsigned char FAR *from,
+                                               unsigned len)
+{
+    unsigned bump = (--len % CHUNKCOPY_CHUNK_SIZE) + 1;
+
+    storechunk(out, loadchunk(from));
+    out += bump;
+    from += bump;
+    len /= CHUNKCOPY_CHUNK_SIZE;
+    while (len-- > 0) {
+        storechunk(out, loadchunk(from));
+        out += CHUNKCOPY_CHUNK_SIZE;
+        from += CHUNKCOPY_CHUNK_SIZE;
+    }
+    return out;
+}
+
+/*
+   Copy exactly len bytes from the sliding window to out. This neither
+   reads past the end of the window nor writes past out + len.
+ */
+local inline unsigned char FAR *chunkcopy_window(unsigned char FAR *out,
+                                                 const unsigned char FAR *from,
+                                                 unsigned len)
+{
+    while (len >= CHUNKCOPY_CHUNK_SIZE) {
+        storechunk(out, loadchunk(from));
+        out += CHUNKCOPY_CHUNK_SIZE;
+        from += CHUNKCOPY_CHUNK_SIZE;
+        len -= CHUNKCOPY_CHUNK_SIZE;
+    }
+    while (len--)
+        *out++ = *from++;
+    return out;
+}
+
+/*
+   Copy len (> 0) bytes from dist bytes back in the output to out, where
+   the two may overlap. Distances shorter than a chunk repeat a pattern:
+   the chunk is filled with the dist bytes before out, then stored every
+   step bytes, step being the largest multiple of dist in a chunk.
+   Returns out + len.
+ */
+local inline unsigned char FAR *chunkcopy_lapped(unsigned char FAR *out,
+                                                 unsigned dist, unsigned len)
+{
+    static const unsigned char step[CHUNKCOPY_CHUNK_SIZE] = {
+        0, 8, 8, 6, 8, 5, 6, 7
+    };
+    unsigned char pat[CHUNKCOPY_CHUNK_SIZE];
+    z_chunk_t c;
+    unsigned i;
+
+    if (dist >= CHUNKCOPY_CHUNK_SIZE)
+        return chunkcopy_core(out, out - dist, len);
+
+    for (i = 0; i < CHUNKCOPY_CHUNK_SIZE; i++)
+        pat[i] = i < dist ? out[(int)i - (int)dist] : pat[i - dist];
+    c = loadchunk(pat);
+    while (len > step[dist]) {
+        storechunk(out, c);
+        out += step[dist];
+        len -= step[dist];
+    }
+    storechunk(out, c);
+    return out + len;
+}
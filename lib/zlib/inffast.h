@@ -9,3 +9,13 @@
  */
 
 void inflate_fast OF((z_streamp strm, unsigned start));
+
+/* U-Boot: the chunked inflate_fast() reads and writes further ahead */
+#ifdef CONFIG_ZLIB_INFLATE_CHUNK
+#  define CHUNKCOPY_CHUNK_SIZE 8
+#  define INFLATE_FAST_MIN_INPUT (8 + sizeof(unsigned long))
+#  define INFLATE_FAST_MIN_OUTPUT (258 + CHUNKCOPY_CHUNK_SIZE)
+#else
+#  define INFLATE_FAST_MIN_INPUT 6
+#  define INFLATE_FAST_MIN_OUTPUT 258
+#endif
@@ -0,0 +1,1085 @@
+/*
+ * Zstandard (RFC 8878) decompression
+ *
+ * A single-pass decoder for whole frames held in memory, written for
+ * loading images: the output buffer is the history window, so there is no
+ * sliding window or streaming state. Dictionaries are not supported.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/errno.h>
+#include <asm/unaligned.h>
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_SKIP_MAGIC		0x184d2a50	/* low 4 bits are free */
+#define ZSTD_SKIP_MASK		0xfffffff0
+
+#define ZSTD_BLOCK_MAX		(128 << 10)
+
+enum {
+	BLOCK_RAW,
+	BLOCK_RLE,
+	BLOCK_COMPRESSED,
+	BLOCK_RESERVED,
+};
+
+enum {
+	LIT_RAW,
+	LIT_RLE,
+	LIT_COMPRESSED,
+	LIT_TREELESS,
+};
+
+enum {
+	SEQ_PREDEFINED,
+	SEQ_RLE,
+	SEQ_COMPRESSED,
+	SEQ_REPEAT,
+};
+
+#define HUF_MAX_BITS		11
+#define HUF_MAX_SYMBS		256
+#define HUF_WEIGHT_LOG		6
+
+#define FSE_MAX_LOG		9
+#define FSE_MAX_SYMBS		256
+
+#define LL_MAX_CODE		35
+#define ML_MAX_CODE		52
+#define OF_MAX_CODE		31
+
+/* A decoding table for Finite State Entropy */
+struct fse_entry {
+	u16 base;		/* next state, before adding the bits read */
+	u8 symbol;
+	u8 bits;
+};
+
+struct fse_table {
+	int log;
+	struct fse_entry entry[1 << FSE_MAX_LOG];
+};
+
+/* A single-lookup Huffman decoding table */
+struct huf_entry {
+	u8 symbol;
+	u8 bits;
+};
+
+struct huf_table {
+	int max_bits;
+	struct huf_entry entry[1 << HUF_MAX_BITS];
+};
+
+enum {
+	SEQ_LL,
+	SEQ_OF,
+	SEQ_ML,
+	SEQ_COUNT,
+};
+
+struct zstd_ctx {
+	/* Output of the frame being decoded, which is also its history */
+	u8 *frame;
+	u8 *out;
+	u8 *out_end;
+
+	u32 rep[3];			/* repeat offsets */
+	bool have_huf;
+	bool have_seq[SEQ_COUNT];
+	struct huf_table huf;
+	struct fse_table seq[SEQ_COUNT];
+
+	u8 lit[ZSTD_BLOCK_MAX];
+};
+
+/* How each sequence table is coded and its predefined distribution */
+static const struct {
+	int max_log;
+	int max_code;
+	int default_log;
+	int default_count;
+} seq_info[SEQ_COUNT] = {
+	[SEQ_LL] = { 9, LL_MAX_CODE, 6, 36 },
+	[SEQ_OF] = { 8, OF_MAX_CODE, 5, 29 },
+	[SEQ_ML] = { 9, ML_MAX_CODE, 6, 53 },
+};
+
+static const s16 ll_default[36] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+
+static const s16 of_default[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+static const s16 ml_default[53] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+static const s16 *const seq_default[SEQ_COUNT] = {
+	[SEQ_LL] = ll_default,
+	[SEQ_OF] = of_default,
+	[SEQ_ML] = ml_default,
+};
+
+static const u32 ll_base[LL_MAX_CODE + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048,
+	4096, 8192, 16384, 32768, 65536,
+};
+
+static const u8 ll_bits[LL_MAX_CODE + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16,
+};
+
+static const u32 ml_base[ML_MAX_CODE + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027,
+	2051, 4099, 8195, 16387, 32771, 65539,
+};
+
+static const u8 ml_bits[ML_MAX_CODE + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16,
+};
+
+static inline int highbit(u32 val)
+{
+	return 31 - __builtin_clz(val);
+}
+
+/*
+ * Bit streams. Table descriptions are read forwards from bit 0; Huffman
+ * and FSE data are read backwards from a marker bit in the last byte.
+ * Either way @pos is a bit position in @src, which is @len bytes long.
+ */
+struct bits {
+	const u8 *src;
+	size_t len;
+	long pos;
+};
+
+/* Get up to 57 bits from bit @pos on, with zeroes past the end */
+static inline u64 bits_peek(const struct bits *bs, long pos)
+{
+	size_t byte = pos >> 3;
+	u64 val;
+	int i;
+
+	if (byte + 8 <= bs->len) {
+		val = get_unaligned_le64(bs->src + byte);
+	} else {
+		val = 0;
+		for (i = 0; byte + i < bs->len; i++)
+			val |= (u64)bs->src[byte + i] << (i * 8);
+	}
+
+	return val >> (pos & 7);
+}
+
+static inline u32 bits_mask(int n)
+{
+	return n >= 32 ? ~0U : (1U << n) - 1;
+}
+
+static inline u32 bits_read(struct bits *bs, int n)
+{
+	u32 val = bits_peek(bs, bs->pos) & bits_mask(n);
+
+	bs->pos += n;
+
+	return val;
+}
+
+/* Start reading @len bytes at @src backwards */
+static int bits_init_back(struct bits *bs, const u8 *src, size_t len)
+{
+	if (!len || !src[len - 1])
+		return -EPROTO;
+	bs->src = src;
+	bs->len = len;
+	bs->pos = len * 8 - 8 + highbit(src[len - 1]);
+
+	return 0;
+}
+
+/* Read @n bits backwards; once past the start the missing bits are zero */
+static inline u32 bits_read_back(struct bits *bs, int n)
+{
+	long pos = bs->pos - n;
+
+	bs->pos = pos;
+	if (pos >= 0)
+		return bits_peek(bs, pos) & bits_mask(n);
+	if (pos + n <= 0)
+		return 0;
+
+	return (bits_peek(bs, 0) & bits_mask(n + pos)) << -pos;
+}
+
+/* Build a decoding table from a normalised distribution */
+static int fse_build_table(struct fse_table *table, const s16 *norm,
+			   int nsymbs, int log)
+{
+	u16 next[FSE_MAX_SYMBS];
+	int size = 1 << log;
+	int high = size - 1;
+	int step = (size >> 1) + (size >> 3) + 3;
+	int pos = 0;
+	int s, i;
+
+	/* Symbols with a "less than one" probability go at the top */
+	for (s = 0; s < nsymbs; s++) {
+		if (norm[s] == -1) {
+			table->entry[high--].symbol = s;
+			next[s] = 1;
+		}
+	}
+
+	for (s = 0; s < nsymbs; s++) {
+		if (norm[s] <= 0)
+			continue;
+		next[s] = norm[s];
+		for (i = 0; i < norm[s]; i++) {
+			table->entry[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+	if (pos)
+		return -EPROTO;
+
+	for (i = 0; i < size; i++) {
+		struct fse_entry *e = &table->entry[i];
+		int n = next[e->symbol]++;
+
+		e->bits = log - highbit(n);
+		e->base = (n << e->bits) - size;
+	}
+	table->log = log;
+
+	return 0;
+}
+
+/* A table which always gives @symbol and reads no bits */
+static void fse_rle_table(struct fse_table *table, u8 symbol)
+{
+	table->log = 0;
+	table->entry[0].symbol = symbol;
+	table->entry[0].bits = 0;
+	table->entry[0].base = 0;
+}
+
+/*
+ * Read an FSE table description from @bs and build the decoding table.
+ * @max_symbs is the size of the alphabet.
+ */
+static int fse_read_table(struct fse_table *table, struct bits *bs,
+			  int max_log, int max_symbs)
+{
+	s16 norm[FSE_MAX_SYMBS];
+	int log, remaining, symb = 0;
+
+	log = bits_read(bs, 4) + 5;
+	if (log > max_log)
+		return -EPROTO;
+
+	remaining = 1 << log;
+	while (remaining > 0 && symb < max_symbs) {
+		int nbits = highbit(remaining + 1) + 1;
+		u32 val = bits_peek(bs, bs->pos) & bits_mask(nbits);
+		u32 low_mask = bits_mask(nbits - 1);
+		u32 threshold = bits_mask(nbits) - (remaining + 1);
+		int proba;
+
+		if ((val & low_mask) < threshold) {
+			val &= low_mask;
+			bs->pos += nbits - 1;
+		} else {
+			if (val > low_mask)
+				val -= threshold;
+			bs->pos += nbits;
+		}
+
+		proba = (int)val - 1;
+		remaining -= proba < 0 ? -proba : proba;
+		norm[symb++] = proba;
+
+		/* A zero is followed by 2-bit counts of further zeroes */
+		if (!proba) {
+			int repeat, i;
+
+			do {
+				repeat = bits_read(bs, 2);
+				for (i = 0; i < repeat; i++) {
+					if (symb >= max_symbs)
+						return -EPROTO;
+					norm[symb++] = 0;
+				}
+			} while (repeat == 3);
+		}
+	}
+	if (remaining || bs->pos > (long)bs->len * 8)
+		return -EPROTO;
+	bs->pos = (bs->pos + 7) & ~7;
+
+	return fse_build_table(table, norm, symb, log);
+}
+
+static inline u8 fse_symbol(const struct fse_table *table, u32 state)
+{
+	return table->entry[state].symbol;
+}
+
+static inline u32 fse_update(const struct fse_table *table, u32 state,
+			     struct bits *bs)
+{
+	const struct fse_entry *e = &table->entry[state];
+
+	return e->base + bits_read_back(bs, e->bits);
+}
+
+/* Build the Huffman table from the weights of all but the last symbol */
+static int huf_build_table(struct huf_table *huf, u8 *weights, int n)
+{
+	u32 rank_idx[HUF_MAX_BITS + 1];
+	u8 bits[HUF_MAX_SYMBS];
+	u32 total = 0, left;
+	int max_bits, i, b;
+
+	for (i = 0; i < n; i++) {
+		if (weights[i] > HUF_MAX_BITS)
+			return -EPROTO;
+		if (weights[i])
+			total += 1 << (weights[i] - 1);
+	}
+	if (!total)
+		return -EPROTO;
+
+	/* The last weight makes the total up to the next power of two */
+	max_bits = highbit(total) + 1;
+	left = (1 << max_bits) - total;
+	if (max_bits > HUF_MAX_BITS || (left & (left - 1)))
+		return -EPROTO;
+	weights[n++] = highbit(left) + 1;
+
+	memset(rank_idx, '\0', sizeof(rank_idx));
+	for (i = 0; i < n; i++) {
+		bits[i] = weights[i] ? max_bits + 1 - weights[i] : 0;
+		rank_idx[bits[i]]++;
+	}
+
+	/* Codes are assigned from the longest to the shortest */
+	for (b = max_bits, left = 0; b >= 1; b--) {
+		u32 count = rank_idx[b];
+
+		rank_idx[b] = left;
+		left += count << (max_bits - b);
+	}
+
+	for (i = 0; i < n; i++) {
+		u32 len;
+
+		b = bits[i];
+		if (!b)
+			continue;
+		len = 1 << (max_bits - b);
+		while (len--) {
+			huf->entry[rank_idx[b]].symbol = i;
+			huf->entry[rank_idx[b]++].bits = b;
+		}
+	}
+	huf->max_bits = max_bits;
+
+	return 0;
+}
+
+/* Read a Huffman tree description, returning the number of bytes used */
+static int huf_read_table(struct huf_table *huf, const u8 *src, size_t len)
+{
+	u8 weights[HUF_MAX_SYMBS];
+	int hdr, n = 0;
+	int ret;
+
+	if (!len)
+		return -EPROTO;
+	hdr = src[0];
+	if (hdr >= 128) {
+		/* Weights stored directly, four bits each */
+		n = hdr - 127;
+		if (1 + (n + 1) / 2 > len)
+			return -EPROTO;
+		for (ret = 0; ret < n; ret++) {
+			u8 byte = src[1 + ret / 2];
+
+			weights[ret] = ret & 1 ? byte & 0xf : byte >> 4;
+		}
+		len = 1 + (n + 1) / 2;
+	} else {
+		/* Weights compressed with FSE, using two interleaved states */
+		struct fse_table table;
+		struct bits bs = { src + 1, hdr, 0 };
+		u32 s1, s2;
+
+		if (1 + hdr > len)
+			return -EPROTO;
+		ret = fse_read_table(&table, &bs, HUF_WEIGHT_LOG,
+				     HUF_MAX_BITS + 1);
+		if (ret)
+			return ret;
+		ret = bits_init_back(&bs, src + 1 + bs.pos / 8,
+				     hdr - bs.pos / 8);
+		if (ret)
+			return ret;
+
+		s1 = bits_read_back(&bs, table.log);
+		s2 = bits_read_back(&bs, table.log);
+		for (;;) {
+			if (n + 3 > HUF_MAX_SYMBS)
+				return -EPROTO;
+			weights[n++] = fse_symbol(&table, s1);
+			s1 = fse_update(&table, s1, &bs);
+			if (bs.pos < 0) {
+				weights[n++] = fse_symbol(&table, s2);
+				break;
+			}
+			weights[n++] = fse_symbol(&table, s2);
+			s2 = fse_update(&table, s2, &bs);
+			if (bs.pos < 0) {
+				weights[n++] = fse_symbol(&table, s1);
+				break;
+			}
+		}
+		len = 1 + hdr;
+	}
+	if (n >= HUF_MAX_SYMBS)
+		return -EPROTO;
+
+	ret = huf_build_table(huf, weights, n);
+	if (ret)
+		return ret;
+
+	return len;
+}
+
+/* Decode one Huffman stream which must give exactly @count symbols */
+static int huf_decode_stream(const struct huf_table *huf, u8 *out,
+			     size_t count, const u8 *src, size_t len)
+{
+	int max_bits = huf->max_bits;
+	u32 mask = bits_mask(max_bits);
+	struct bits bs;
+	u32 state;
+	int ret;
+
+	ret = bits_init_back(&bs, src, len);
+	if (ret)
+		return ret;
+
+	state = bits_read_back(&bs, max_bits);
+	while (count--) {
+		const struct huf_entry *e = &huf->entry[state];
+
+		*out++ = e->symbol;
+		state = ((state << e->bits) | bits_read_back(&bs, e->bits)) &
+			mask;
+	}
+	if (bs.pos != -max_bits)
+		return -EPROTO;
+
+	return 0;
+}
+
+/*
+ * Decode the literals section of a block. Raw literals are left in the
+ * input, others go to the context's buffer. Returns the bytes used.
+ */
+static int zstd_literals(struct zstd_ctx *ctx, const u8 *src, size_t len,
+			 const u8 **lit, size_t *lit_len)
+{
+	int type, fmt, hsize, ret;
+	size_t regen, csize;
+
+	if (!len)
+		return -EPROTO;
+	type = src[0] & 3;
+	fmt = (src[0] >> 2) & 3;
+
+	if (type == LIT_RAW || type == LIT_RLE) {
+		hsize = fmt == 1 ? 2 : fmt == 3 ? 3 : 1;
+		if (hsize > len)
+			return -EPROTO;
+		regen = src[0] >> (hsize == 1 ? 3 : 4);
+		if (hsize > 1)
+			regen |= src[1] << 4;
+		if (hsize > 2)
+			regen |= src[2] << 12;
+		if (regen > ZSTD_BLOCK_MAX)
+			return -EPROTO;
+		*lit_len = regen;
+
+		if (type == LIT_RAW) {
+			if (hsize + regen > len)
+				return -EPROTO;
+			*lit = src + hsize;
+			return hsize + regen;
+		}
+		if (hsize + 1 > len)
+			return -EPROTO;
+		memset(ctx->lit, src[hsize], regen);
+		*lit = ctx->lit;
+		return hsize + 1;
+	}
+
+	/* Huffman-coded, in one stream or four */
+	{
+		int sbits = fmt < 2 ? 10 : fmt == 2 ? 14 : 18;
+		u64 hdr = 0;
+		const u8 *p;
+		size_t rem;
+		int i;
+
+		hsize = fmt < 2 ? 3 : fmt == 2 ? 4 : 5;
+		if (hsize > len)
+			return -EPROTO;
+		for (i = 0; i < hsize; i++)
+			hdr |= (u64)src[i] << (i * 8);
+		regen = (hdr >> 4) & bits_mask(sbits);
+		csize = (hdr >> (4 + sbits)) & bits_mask(sbits);
+		if (regen > ZSTD_BLOCK_MAX || hsize + csize > len)
+			return -EPROTO;
+
+		p = src + hsize;
+		rem = csize;
+		if (type == LIT_COMPRESSED) {
+			ret = huf_read_table(&ctx->huf, p, rem);
+			if (ret < 0)
+				return ret;
+			ctx->have_huf = true;
+			p += ret;
+			rem -= ret;
+		} else if (!ctx->have_huf) {
+			return -EPROTO;
+		}
+
+		if (!fmt) {
+			ret = huf_decode_stream(&ctx->huf, ctx->lit, regen,
+						p, rem);
+		} else {
+			size_t seg = (regen + 3) / 4;
+			size_t size[4];
+			u8 *out = ctx->lit;
+
+			if (rem < 6 || regen < 3 * seg)
+				return -EPROTO;
+			size[0] = get_unaligned_le16(p);
+			size[1] = get_unaligned_le16(p + 2);
+			size[2] = get_unaligned_le16(p + 4);
+			p += 6;
+			rem -= 6;
+			if (size[0] + size[1] + size[2] > rem)
+				return -EPROTO;
+			size[3] = rem - size[0] - size[1] - size[2];
+
+			for (i = 0, ret = 0; i < 4 && !ret; i++) {
+				size_t count = i < 3 ? seg : regen - 3 * seg;
+
+				ret = huf_decode_stream(&ctx->huf, out, count,
+							p, size[i]);
+				out += count;
+				p += size[i];
+			}
+		}
+		if (ret)
+			return ret;
+		*lit = ctx->lit;
+		*lit_len = regen;
+
+		return hsize + csize;
+	}
+}
+
+/* Set up the table for one sequence field, returning the bytes used */
+static int zstd_seq_table(struct zstd_ctx *ctx, int field, int mode,
+			  const u8 *src, size_t len)
+{
+	struct fse_table *table = &ctx->seq[field];
+	struct bits bs = { src, len, 0 };
+	int ret = 0;
+
+	switch (mode) {
+	case SEQ_PREDEFINED:
+		ret = fse_build_table(table, seq_default[field],
+				      seq_info[field].default_count,
+				      seq_info[field].default_log);
+		break;
+	case SEQ_RLE:
+		if (!len || src[0] > seq_info[field].max_code)
+			return -EPROTO;
+		fse_rle_table(table, src[0]);
+		ret = 1;
+		break;
+	case SEQ_COMPRESSED:
+		ret = fse_read_table(table, &bs, seq_info[field].max_log,
+				     seq_info[field].max_code + 1);
+		if (!ret)
+			ret = bs.pos / 8;
+		break;
+	case SEQ_REPEAT:
+		if (!ctx->have_seq[field])
+			return -EPROTO;
+		break;
+	}
+	if (ret >= 0)
+		ctx->have_seq[field] = true;
+
+	return ret;
+}
+
+/* Copy @len literals then a match of @ml bytes at @offset back */
+static int zstd_exec(struct zstd_ctx *ctx, const u8 **lit, const u8 *lit_end,
+		     u32 ll, u32 offset, u32 ml)
+{
+	u8 *out = ctx->out;
+	const u8 *match;
+
+	if (ll > lit_end - *lit)
+		return -EPROTO;
+	if (ll + ml > ctx->out_end - out)
+		return -ENOBUFS;
+	memcpy(out, *lit, ll);
+	*lit += ll;
+	out += ll;
+
+	if (!offset || offset > out - ctx->frame)
+		return -EPROTO;
+	match = out - offset;
+	if (offset >= ml) {
+		memcpy(out, match, ml);
+		out += ml;
+	} else {
+		while (ml--)
+			*out++ = *match++;
+	}
+	ctx->out = out;
+
+	return 0;
+}
+
+static int zstd_sequences(struct zstd_ctx *ctx, const u8 *src, size_t len,
+			  const u8 *lit, size_t lit_len)
+{
+	const u8 *lit_end = lit + lit_len;
+	const u8 *end = src + len;
+	u32 ll_state = 0, of_state = 0, ml_state = 0;
+	struct bits bs = { NULL, 0, 0 };
+	int nbseq, modes, field, ret, i;
+
+	if (!len)
+		return -EPROTO;
+	nbseq = src[0];
+	if (nbseq < 128) {
+		src++;
+	} else if (nbseq < 255) {
+		if (len < 2)
+			return -EPROTO;
+		nbseq = ((nbseq - 128) << 8) + src[1];
+		src += 2;
+	} else {
+		if (len < 3)
+			return -EPROTO;
+		nbseq = src[1] + (src[2] << 8) + 0x7f00;
+		src += 3;
+	}
+
+	if (nbseq) {
+		if (src >= end || (*src & 3))
+			return -EPROTO;
+		modes = *src++;
+		for (field = 0; field < SEQ_COUNT; field++) {
+			ret = zstd_seq_table(ctx, field,
+					     (modes >> (6 - field * 2)) & 3,
+					     src, end - src);
+			if (ret < 0)
+				return ret;
+			src += ret;
+		}
+
+		ret = bits_init_back(&bs, src, end - src);
+		if (ret)
+			return ret;
+		ll_state = bits_read_back(&bs, ctx->seq[SEQ_LL].log);
+		of_state = bits_read_back(&bs, ctx->seq[SEQ_OF].log);
+		ml_state = bits_read_back(&bs, ctx->seq[SEQ_ML].log);
+	}
+
+	for (i = 0; i < nbseq; i++) {
+		int of_code = fse_symbol(&ctx->seq[SEQ_OF], of_state);
+		int ml_code = fse_symbol(&ctx->seq[SEQ_ML], ml_state);
+		int ll_code = fse_symbol(&ctx->seq[SEQ_LL], ll_state);
+		u32 offset, ml, ll;
+
+		offset = (1U << of_code) + bits_read_back(&bs, of_code);
+		ml = ml_base[ml_code] + bits_read_back(&bs, ml_bits[ml_code]);
+		ll = ll_base[ll_code] + bits_read_back(&bs, ll_bits[ll_code]);
+
+		if (offset > 3) {
+			offset -= 3;
+			ctx->rep[2] = ctx->rep[1];
+			ctx->rep[1] = ctx->rep[0];
+			ctx->rep[0] = offset;
+		} else {
+			/* A repeat offset, shifted by one with no literals */
+			int idx = offset - 1 + !ll;
+
+			if (!idx) {
+				offset = ctx->rep[0];
+			} else {
+				offset = idx < 3 ? ctx->rep[idx] :
+					 ctx->rep[0] - 1;
+				if (idx > 1)
+					ctx->rep[2] = ctx->rep[1];
+				ctx->rep[1] = ctx->rep[0];
+				ctx->rep[0] = offset;
+			}
+		}
+
+		if (i + 1 < nbseq) {
+			ll_state = fse_update(&ctx->seq[SEQ_LL], ll_state, &bs);
+			ml_state = fse_update(&ctx->seq[SEQ_ML], ml_state, &bs);
+			of_state = fse_update(&ctx->seq[SEQ_OF], of_state, &bs);
+		}
+
+		ret = zstd_exec(ctx, &lit, lit_end, ll, offset, ml);
+		if (ret)
+			return ret;
+	}
+	if (nbseq && bs.pos)
+		return -EPROTO;
+
+	/* Whatever literals are left follow the last sequence */
+	lit_len = lit_end - lit;
+	if (lit_len > ctx->out_end - ctx->out)
+		return -ENOBUFS;
+	memcpy(ctx->out, lit, lit_len);
+	ctx->out += lit_len;
+
+	return 0;
+}
+
+static int zstd_block(struct zstd_ctx *ctx, const u8 *src, size_t len)
+{
+	const u8 *lit = NULL;
+	size_t lit_len = 0;
+	int ret;
+
+	ret = zstd_literals(ctx, src, len, &lit, &lit_len);
+	if (ret < 0)
+		return ret;
+
+	return zstd_sequences(ctx, src + ret, len - ret, lit, lit_len);
+}
+
+#define XXH_P1	11400714785074694791ULL
+#define XXH_P2	14029467366897019727ULL
+#define XXH_P3	1609587929392839161ULL
+#define XXH_P4	9650029242287828579ULL
+#define XXH_P5	2870177450012600261ULL
+
+static inline u64 rol64(u64 val, int shift)
+{
+	return (val << shift) | (val >> (64 - shift));
+}
+
+static inline u64 xxh64_round(u64 acc, u64 val)
+{
+	return rol64(acc + val * XXH_P2, 31) * XXH_P1;
+}
+
+static inline u64 xxh64_merge(u64 acc, u64 val)
+{
+	return (acc ^ xxh64_round(0, val)) * XXH_P1 + XXH_P4;
+}
+
+/* XXH64 with a zero seed, which frames use as their content checksum */
+static u64 xxh64(const u8 *p, size_t len)
+{
+	const u8 *end = p + len;
+	u64 h;
+
+	if (len >= 32) {
+		u64 v1 = XXH_P1 + XXH_P2, v2 = XXH_P2, v3 = 0, v4 = -XXH_P1;
+
+		for (; end - p >= 32; p += 32) {
+			v1 = xxh64_round(v1, get_unaligned_le64(p));
+			v2 = xxh64_round(v2, get_unaligned_le64(p + 8));
+			v3 = xxh64_round(v3, get_unaligned_le64(p + 16));
+			v4 = xxh64_round(v4, get_unaligned_le64(p + 24));
+		}
+		h = rol64(v1, 1) + rol64(v2, 7) + rol64(v3, 12) +
+			rol64(v4, 18);
+		h = xxh64_merge(h, v1);
+		h = xxh64_merge(h, v2);
+		h = xxh64_merge(h, v3);
+		h = xxh64_merge(h, v4);
+	} else {
+		h = XXH_P5;
+	}
+	h += len;
+
+	for (; end - p >= 8; p += 8)
+		h = rol64(h ^ xxh64_round(0, get_unaligned_le64(p)), 27) *
+			XXH_P1 + XXH_P4;
+	if (end - p >= 4) {
+		h = rol64(h ^ (get_unaligned_le32(p) * XXH_P1), 23) * XXH_P2 +
+			XXH_P3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rol64(h ^ (*p * XXH_P5), 11) * XXH_P1;
+
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/* Decode the frame at @*inp, moving it on to what follows */
+static int zstd_frame(struct zstd_ctx *ctx, const u8 **inp, const u8 *end)
+{
+	static const u8 did_size[4] = { 0, 1, 2, 4 };
+	const u8 *in = *inp + 4;
+	int fcs_flag, single, checksum, fcs_size, hsize, last, i;
+	u64 fcs = 0;
+	u32 did = 0;
+	int ret;
+
+	if (in >= end)
+		return -EINVAL;
+	fcs_flag = *in >> 6;
+	single = (*in >> 5) & 1;
+	checksum = (*in >> 2) & 1;
+	if (*in & 0x08)
+		return -EPROTO;		/* reserved */
+	fcs_size = fcs_flag ? 1 << fcs_flag : single;
+	hsize = !single + did_size[*in & 3] + fcs_size;
+	in++;
+	if (hsize > end - in)
+		return -EINVAL;
+
+	/* The window size does not matter as the output is the window */
+	if (!single)
+		in++;
+	for (i = 0; i < did_size[*(*inp + 4) & 3]; i++)
+		did |= *in++ << (i * 8);
+	if (did)
+		return -EPROTONOSUPPORT;
+	for (i = 0; i < fcs_size; i++)
+		fcs |= (u64)*in++ << (i * 8);
+	if (fcs_size == 2)
+		fcs += 256;
+	if (fcs_size && fcs > ctx->out_end - ctx->out)
+		return -ENOBUFS;
+
+	ctx->frame = ctx->out;
+	ctx->rep[0] = 1;
+	ctx->rep[1] = 4;
+	ctx->rep[2] = 8;
+	ctx->have_huf = false;
+	memset(ctx->have_seq, '\0', sizeof(ctx->have_seq));
+
+	do {
+		u32 hdr, size;
+		int type;
+
+		if (end - in < 3)
+			return -EINVAL;
+		hdr = in[0] | in[1] << 8 | in[2] << 16;
+		in += 3;
+		last = hdr & 1;
+		type = (hdr >> 1) & 3;
+		size = hdr >> 3;
+		if (size > ZSTD_BLOCK_MAX)
+			return -EPROTO;
+
+		switch (type) {
+		case BLOCK_RAW:
+			if (size > end - in)
+				return -EINVAL;
+			if (size > ctx->out_end - ctx->out)
+				return -ENOBUFS;
+			memcpy(ctx->out, in, size);
+			ctx->out += size;
+			in += size;
+			break;
+		case BLOCK_RLE:
+			if (in >= end)
+				return -EINVAL;
+			if (size > ctx->out_end - ctx->out)
+				return -ENOBUFS;
+			memset(ctx->out, *in, size);
+			ctx->out += size;
+			in++;
+			break;
+		case BLOCK_COMPRESSED:
+			if (size > end - in)
+				return -EINVAL;
+			ret = zstd_block(ctx, in, size);
+			if (ret)
+				return ret;
+			in += size;
+			break;
+		default:
+			return -EPROTO;
+		}
+	} while (!last);
+
+	if (fcs_size && ctx->out - ctx->frame != fcs)
+		return -EPROTO;
+	if (checksum) {
+		if (end - in < 4)
+			return -EINVAL;
+		if (get_unaligned_le32(in) !=
+		    (u32)xxh64(ctx->frame, ctx->out - ctx->frame))
+			return -EBADMSG;
+		in += 4;
+	}
+	*inp = in;
+
+	return 0;
+}
+
+int zstd_frame_info(const void *src, size_t srcn, size_t *framen,
+		    u64 *content)
+{
+	static const u8 did_size[4] = { 0, 1, 2, 4 };
+	const u8 *in = src, *end = in + srcn;
+	int fcs_flag, single, fcs_size, i;
+	u32 magic, hdr, size;
+
+	if (srcn < 4)
+		return -EINVAL;
+	magic = get_unaligned_le32(in);
+	if ((magic & ZSTD_SKIP_MASK) == ZSTD_SKIP_MAGIC) {
+		if (srcn < 8 || get_unaligned_le32(in + 4) > srcn - 8)
+			return -EINVAL;
+		*framen = 8 + get_unaligned_le32(in + 4);
+		*content = 0;
+		return 0;
+	}
+	if (magic != ZSTD_MAGIC)
+		return -EPROTONOSUPPORT;
+	in += 4;
+
+	if (in >= end)
+		return -EINVAL;
+	fcs_flag = *in >> 6;
+	single = (*in >> 5) & 1;
+	fcs_size = fcs_flag ? 1 << fcs_flag : single;
+	if (!single + did_size[*in & 3] + fcs_size >= end - in)
+		return -EINVAL;
+	in += 1 + !single + did_size[*in & 3];
+	*content = fcs_size ? 0 : -1ULL;
+	for (i = 0; i < fcs_size; i++)
+		*content |= (u64)*in++ << (i * 8);
+	if (fcs_size == 2)
+		*content += 256;
+
+	do {
+		if (end - in < 3)
+			return -EINVAL;
+		hdr = in[0] | in[1] << 8 | in[2] << 16;
+		in += 3;
+		size = ((hdr >> 1) & 3) == BLOCK_RLE ? 1 : hdr >> 3;
+		if (size > end - in)
+			return -EINVAL;
+		in += size;
+	} while (!(hdr & 1));
+	if (*((const u8 *)src + 4) & 0x04) {
+		if (end - in < 4)
+			return -EINVAL;
+		in += 4;
+	}
+	*framen = in - (const u8 *)src;
+
+	return 0;
+}
+
+size_t zstd_work_size(void)
+{
+	return sizeof(struct zstd_ctx);
+}
+
+int zstd_decompress_work(const void *src, size_t srcn, void *dst,
+			 size_t *dstn, void *work)
+{
+	const u8 *in = src, *end = in + srcn;
+	struct zstd_ctx *ctx = work;
+	int ret = 0;
+
+	ctx->out = dst;
+	ctx->out_end = ctx->out + *dstn;
+
+	while (in < end) {
+		u32 magic;
+
+		if (end - in < 4) {
+			ret = -EINVAL;
+			break;
+		}
+		magic = get_unaligned_le32(in);
+		if ((magic & ZSTD_SKIP_MASK) == ZSTD_SKIP_MAGIC) {
+			if (end - in < 8 ||
+			    get_unaligned_le32(in + 4) > end - in - 8) {
+				ret = -EINVAL;
+				break;
+			}
+			in += 8 + get_unaligned_le32(in + 4);
+			continue;
+		}
+		if (magic != ZSTD_MAGIC) {
+			ret = -EPROTONOSUPPORT;
+			break;
+		}
+		ret = zstd_frame(ctx, &in, end);
+		if (ret)
+			break;
+	}
+
+	*dstn = ctx->out - (u8 *)dst;
+
+	return ret;
+}
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	void *work;
+	int ret;
+
+	work = malloc(zstd_work_size());
+	if (!work)
+		return -ENOMEM;
+	ret = zstd_decompress_work(src, srcn, dst, dstn, work);
+	free(work);
+
+	return ret;
+}
@@ -20,18 +20,22 @@ DECLARE_GLOBAL_DATA_PTR;
  * struct eth_device_priv - private structure for each Ethernet device
  *
  * @state: The state of the Ethernet MAC driver (defined by enum eth_state_t)
+ * @rx_stats: How packets have come in from the device
  */
 struct eth_device_priv {
 	enum eth_state_t state;
+	struct eth_rx_stats rx_stats;
 };
 
 /**
  * struct eth_uclass_priv - The structure attached to the uclass itself
  *
  * @current: The Ethernet device that the network functions are using
+ * @rx_split: How to split the packet expected next, or NULL
  */
 struct eth_uclass_priv {
 	struct udevice *current;
+	struct eth_rx_split *rx_split;
 };
 
 /* eth_errno - This stores the most recent failure code from DM functions */
@@ -314,6 +318,19 @@ void eth_halt(void)
 	eth_get_ops(current)->stop(current);
 	priv = current->uclass_priv;
 	priv->state = ETH_STATE_PASSIVE;
+	eth_set_rx_split(NULL);
+}
+
+void eth_set_rx_split(struct eth_rx_split *split)
+{
+	eth_get_uclass_priv()->rx_split = split;
+}
+
+struct eth_rx_stats *eth_get_rx_stats(struct udevice *dev)
+{
+	struct eth_device_priv *priv = dev_get_uclass_priv(dev);
+
+	return &priv->rx_stats;
 }
 
 int eth_is_active(struct udevice *dev)
@@ -347,13 +364,49 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+/*
+ * Receive a packet, split if a protocol has asked for that. If it was split
+ * but is not the packet expected, put it back together.
+ */
+static int eth_recv(struct udevice *dev, int flags, uchar **packetp,
+		    struct eth_rx_split **splitp)
+{
+	struct eth_uclass_priv *uc_priv = eth_get_uclass_priv();
+	struct eth_rx_split *split = uc_priv->rx_split;
+	struct eth_ops *ops = eth_get_ops(dev);
+	int ret;
+
+	*splitp = NULL;
+	if (!split || !ops->recv_split)
+		return ops->recv(dev, flags, packetp);
+
+	ret = ops->recv_split(dev, flags, packetp, split);
+	if (ret <= split->hdr_len || ret > split->hdr_len + split->len)
+		return ret;
+
+	if (!split->match(*packetp, ret)) {
+		memcpy(*packetp + split->hdr_len, split->dst,
+		       ret - split->hdr_len);
+		return ret;
+	}
+
+	/* The protocol asks again once it is ready for the next one */
+	uc_priv->rx_split = NULL;
+	*splitp = split;
+
+	return ret;
+}
+
 int eth_rx(void)
 {
+	struct eth_rx_split *split;
+	struct eth_rx_stats *stats;
 	struct udevice *current;
 	uchar *packet;
+	int count = 0;
+	int found = 0;
 	int flags;
 	int ret;
-	int i;
 
 	current = eth_get_dev();
 	if (!current)
@@ -362,17 +415,44 @@ int eth_rx(void)
 	if (!device_active(current))
 		return -EINVAL;
 
-	/* Process up to 32 packets at one time */
+	stats = eth_get_rx_stats(current);
+	stats->polls++;
+
+	/*
+	 * Process up to CONFIG_NET_RX_BUDGET packets at one time. When the
+	 * driver runs out of packets, check the device again if the last check
+	 * found any, since more are likely to be on the way.
+	 */
 	flags = ETH_RECV_CHECK_DEVICE;
-	for (i = 0; i < 32; i++) {
-		ret = eth_get_ops(current)->recv(current, flags, &packet);
+	while (count < CONFIG_NET_RX_BUDGET) {
+		if (flags & ETH_RECV_CHECK_DEVICE) {
+			stats->checks++;
+			found = 0;
+		}
+		ret = eth_recv(current, flags, &packet, &split);
 		flags = 0;
-		if (ret > 0)
+		if (split)
+			net_process_split_packet(packet, ret, split);
+		else if (ret > 0)
 			net_process_received_packet(packet, ret);
 		if (ret >= 0 && eth_get_ops(current)->free_pkt)
 			eth_get_ops(current)->free_pkt(current, packet, ret);
-		if (ret <= 0)
+		if (ret > 0) {
+			count++;
+			found++;
+		} else if (found && (!ret || ret == -EAGAIN)) {
+			flags = ETH_RECV_CHECK_DEVICE;
+		} else {
 			break;
+		}
+	}
+
+	if (count) {
+		stats->busy_polls++;
+		stats->packets += count;
+		stats->max_batch = max_t(ulong, stats->max_batch, count);
+		if (count == CONFIG_NET_RX_BUDGET)
+			stats->budget_hit++;
 	}
 	if (ret == -EAGAIN)
 		ret = 0;
@@ -472,6 +552,8 @@ static int eth_post_probe(struct udevice *dev)
 			ops->send += gd->reloc_off;
 		if (ops->recv)
 			ops->recv += gd->reloc_off;
+		if (ops->recv_split)
+			ops->recv_split += gd->reloc_off;
 		if (ops->free_pkt)
 			ops->free_pkt += gd->reloc_off;
 		if (ops->stop)
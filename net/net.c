@@ -78,6 +78,15 @@
  *			- own IP address
  *	We want:	- network time
  *	Next step:	none
+ *
+ * WGET:
+ *
+ *	Prerequisites:	- own ethernet address
+ *			- own IP address
+ *			- HTTP server IP address
+ *			- name of the file to load
+ *	We want:	- load the file
+ *	Next step:	none
  */
 
 
@@ -87,6 +96,7 @@
 #include <environment.h>
 #include <errno.h>
 #include <net.h>
+#include <net/tcp.h>
 #include <net/tftp.h>
 #if defined(CONFIG_LED_STATUS)
 #include <miiphy.h>
@@ -107,6 +117,7 @@
 #if defined(CONFIG_CMD_SNTP)
 #include "sntp.h"
 #endif
+#include "wget.h"
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -344,6 +355,9 @@ static void net_init_loop(void)
 {
 	if (eth_get_dev())
 		memcpy(net_ethaddr, eth_get_ethaddr(), 6);
+#if defined(CONFIG_PROT_TCP)
+	tcp_stop();
+#endif
 
 	return;
 }
@@ -353,6 +367,10 @@ static void net_clear_handlers(void)
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
 	net_set_timeout_handler(0, NULL);
+	eth_set_rx_split(NULL);
+#if defined(CONFIG_PROT_TCP)
+	tcp_stop();
+#endif
 }
 
 static void net_cleanup_loop(void)
@@ -484,6 +502,11 @@ restart:
 			nfs_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			cdp_start();
@@ -776,6 +799,33 @@ void net_set_timeout_handler(ulong iv, thand_f *f)
 	}
 }
 
+/* Send the frame in net_tx_packet, or hold it until ARP has found @ether */
+static int net_send_ip_frame(uchar *ether, struct in_addr dest, int len)
+{
+	/* if MAC address was not discovered yet, do an ARP request */
+	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
+		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
+
+		/* save the ip and eth addr for the packet to send after arp */
+		net_arp_wait_packet_ip = dest;
+		arp_wait_packet_ethaddr = ether;
+
+		/* size of the waiting packet */
+		arp_wait_tx_packet_size = len;
+
+		/* and do the ARP request */
+		arp_wait_try = 1;
+		arp_wait_timer_start = get_timer(0);
+		arp_request();
+		return 1;	/* waiting */
+	} else {
+		debug_cond(DEBUG_DEV_PKT, "sending IP to %pI4/%pM\n",
+			   &dest, ether);
+		net_send_packet(net_tx_packet, len);
+		return 0;	/* transmitted */
+	}
+}
+
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		int payload_len)
 {
@@ -803,28 +853,28 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 	net_set_udp_header(pkt, dest, dport, sport, payload_len);
 	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 
-	/* if MAC address was not discovered yet, do an ARP request */
-	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
-		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
+	return net_send_ip_frame(ether, dest, pkt_hdr_size + payload_len);
+}
 
-		/* save the ip and eth addr for the packet to send after arp */
-		net_arp_wait_packet_ip = dest;
-		arp_wait_packet_ethaddr = ether;
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int proto,
+		       int payload_len)
+{
+	struct ip_hdr *ip;
+	int eth_hdr_size;
 
-		/* size of the waiting packet */
-		arp_wait_tx_packet_size = pkt_hdr_size + payload_len;
+	assert(net_tx_packet != NULL);
+	if (net_tx_packet == NULL)
+		return -1;
 
-		/* and do the ARP request */
-		arp_wait_try = 1;
-		arp_wait_timer_start = get_timer(0);
-		arp_request();
-		return 1;	/* waiting */
-	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
-			   &dest, ether);
-		net_send_packet(net_tx_packet, pkt_hdr_size + payload_len);
-		return 0;	/* transmitted */
-	}
+	eth_hdr_size = net_set_ether(net_tx_packet, ether, PROT_IP);
+	ip = (struct ip_hdr *)(net_tx_packet + eth_hdr_size);
+	net_set_ip_header((uchar *)ip, dest, net_ip);
+	ip->ip_len = htons(IP_HDR_SIZE + payload_len);
+	ip->ip_p   = proto;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	return net_send_ip_frame(ether, dest,
+				 eth_hdr_size + IP_HDR_SIZE + payload_len);
 }
 
 #ifdef CONFIG_IP_DEFRAG
@@ -833,9 +883,6 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
  * to the algorithm in RFC815. It returns NULL or the pointer to
  * a complete packet, in static storage
  */
-#ifndef CONFIG_NET_MAXDEFRAG
-#define CONFIG_NET_MAXDEFRAG 16384
-#endif
 #define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG)
 
 #define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE)
@@ -1026,6 +1073,43 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
+#ifdef CONFIG_UDP_CHECKSUM
+/*
+ * Add @len bytes to a ones' complement sum of 16-bit words. @odd says that
+ * the first byte is the low byte of a word, the bytes before it having been
+ * summed already.
+ */
+static ulong net_sum_bytes(ulong xsum, const uchar *p, int len, bool odd)
+{
+	if (odd && len > 0) {
+		xsum += *p++;
+		len--;
+	}
+	while (len > 1) {
+		xsum += (p[0] << 8) | p[1];
+		p += 2;
+		len -= 2;
+	}
+	if (len > 0)
+		xsum += *p << 8;
+
+	return xsum;
+}
+#endif
+
+/* The split of the packet being processed, if it was received split */
+static struct eth_rx_split *net_rx_placed;
+
+void net_process_split_packet(uchar *in_packet, int len,
+			      struct eth_rx_split *split)
+{
+	net_rx_placed = split;
+	split->placed = true;
+	net_process_received_packet(in_packet, len);
+	split->placed = false;
+	net_rx_placed = NULL;
+}
+
 void net_process_received_packet(uchar *in_packet, int len)
 {
 	struct ethernet_hdr *et;
@@ -1208,6 +1292,11 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_PROT_TCP)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_tcp_hdr *)ip, len);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1219,8 +1308,9 @@ void net_process_received_packet(uchar *in_packet, int len)
 #ifdef CONFIG_UDP_CHECKSUM
 		if (ip->udp_xsum != 0) {
 			ulong   xsum;
-			ushort *sumptr;
-			ushort  sumlen;
+			uchar  *sumptr;
+			int     sumlen;
+			int     hdrlen;
 
 			xsum  = ip->ip_p;
 			xsum += (ntohs(ip->udp_len));
@@ -1230,21 +1320,23 @@ void net_process_received_packet(uchar *in_packet, int len)
 			xsum += (ntohl(ip->ip_dst.s_addr) >>  0) & 0x0000ffff;
 
 			sumlen = ntohs(ip->udp_len);
-			sumptr = (ushort *)&(ip->udp_src);
-
-			while (sumlen > 1) {
-				ushort sumdata;
-
-				sumdata = *sumptr++;
-				xsum += ntohs(sumdata);
-				sumlen -= 2;
-			}
-			if (sumlen > 0) {
-				ushort sumdata;
-
-				sumdata = *(unsigned char *)sumptr;
-				sumdata = (sumdata << 8) & 0xff00;
-				xsum += sumdata;
+			sumptr = (uchar *)&ip->udp_src;
+
+			if (net_rx_placed) {
+				/* Only the headers are in the packet buffer */
+				hdrlen = in_packet + net_rx_placed->hdr_len -
+					sumptr;
+				if (hdrlen > sumlen ||
+				    sumlen - hdrlen > net_rx_placed->len)
+					return;
+				xsum = net_sum_bytes(xsum, sumptr, hdrlen,
+						     false);
+				xsum = net_sum_bytes(xsum, net_rx_placed->dst,
+						     sumlen - hdrlen,
+						     hdrlen & 1);
+			} else {
+				xsum = net_sum_bytes(xsum, sumptr, sumlen,
+						     false);
 			}
 			while ((xsum >> 16) != 0) {
 				xsum = (xsum & 0x0000ffff) +
@@ -1309,6 +1401,9 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 		/* Fall through */
 	case TFTPGET:
@@ -45,12 +45,48 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* RPC and NFS headers before the data in a READ reply, at most */
+#define NFS_READ_HDR_SIZE	128
+/* A '#' is printed for every this many bytes read */
+#define NFS_HASH_BYTES		(NFS_READ_SIZE / 2 * 10)
+/*
+ * A READ is taken as lost once this many sent after it have been answered,
+ * or fewer if the window is small. The server may answer a few out of order
+ * when it has several threads.
+ */
+#define NFS_READ_REORDER	3U
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * Up to CONFIG_NFS_READ_WINDOW READ requests are kept in flight, so that a
+ * round trip is not spent on each one. Replies are matched to requests by
+ * their RPC id, and may come in any order. The window starts at one
+ * request and grows by one each time a window full of replies arrives
+ * without loss. It halves, to no less than two, when a READ is lost, and
+ * goes back to one on a timeout.
+ */
+struct nfs_read_slot {
+	unsigned long id;	/* RPC id of the request, 0 if free */
+	ulong offset;		/* file offset requested */
+	unsigned int len;	/* number of bytes requested */
+	unsigned int seq;	/* order the request was sent in */
+	unsigned int later;	/* replies to requests sent after it */
+};
+
+static struct nfs_read_slot nfs_read_slots[CONFIG_NFS_READ_WINDOW];
+static unsigned int nfs_read_size;	/* bytes asked for in each READ */
+static unsigned int nfs_read_window;	/* READs allowed in flight */
+static unsigned int nfs_read_in_flight;	/* READs in flight */
+static unsigned int nfs_read_acked;	/* replies since the window grew */
+static unsigned int nfs_read_seq;	/* last sequence number sent */
+static unsigned int nfs_read_recover_seq; /* last seq sent at a loss */
+static ulong nfs_read_next;		/* offset of the next new READ */
+static ulong nfs_read_end;		/* file size, once known */
+static ulong nfs_read_bytes;		/* bytes received so far */
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -386,6 +422,132 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+static void nfs_read_send(struct nfs_read_slot *slot)
+{
+	slot->seq = ++nfs_read_seq;
+	slot->later = 0;
+	nfs_read_req(slot->offset, slot->len);
+	slot->id = rpc_id;
+}
+
+static void nfs_read_free(struct nfs_read_slot *slot)
+{
+	slot->id = 0;
+	nfs_read_in_flight--;
+}
+
+static void nfs_read_cancel(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + ARRAY_SIZE(nfs_read_slots); slot++) {
+		if (slot->id)
+			nfs_read_free(slot);
+	}
+}
+
+/*
+ * Resend the READs in flight, if @resend, then send new ones until the
+ * window is full or the end of the file is reached
+ */
+static void nfs_read_fill(bool resend)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + ARRAY_SIZE(nfs_read_slots); slot++) {
+		if (slot->id) {
+			if (resend)
+				nfs_read_send(slot);
+			continue;
+		}
+		if (nfs_read_in_flight >= nfs_read_window ||
+		    nfs_read_next >= nfs_read_end)
+			continue;
+		slot->offset = nfs_read_next;
+		slot->len = nfs_read_size;
+		nfs_read_next += nfs_read_size;
+		nfs_read_in_flight++;
+		nfs_read_send(slot);
+	}
+}
+
+static void nfs_read_start(void)
+{
+	nfs_read_size = NFS_READ_SIZE;
+#ifdef CONFIG_IP_DEFRAG
+	/* A reply may come in fragments, as long as they fit back together */
+	while (nfs_read_size * 2 <= (supported_nfs_versions & NFSV2_FLAG ?
+				     NFS2_MAXDATA : NFS3_MAXDATA) &&
+	       nfs_read_size * 2 + NFS_READ_HDR_SIZE + IP_UDP_HDR_SIZE <=
+	       CONFIG_NET_MAXDEFRAG)
+		nfs_read_size *= 2;
+#endif
+	debug("NFS read size %u, window %d\n", nfs_read_size,
+	      CONFIG_NFS_READ_WINDOW);
+
+	nfs_read_cancel();
+	nfs_read_window = 1;
+	nfs_read_acked = 0;
+	nfs_read_recover_seq = nfs_read_seq;
+	nfs_read_next = 0;
+	nfs_read_end = ~0UL;
+	nfs_read_bytes = 0;
+}
+
+/* Resend a lost READ, halving the window unless it was cut for this loss */
+static void nfs_read_lost(struct nfs_read_slot *slot)
+{
+	debug("NFS READ at %lx lost\n", slot->offset);
+	if ((int)(slot->seq - nfs_read_recover_seq) > 0) {
+		nfs_read_window = max(nfs_read_window / 2, 2U);
+		nfs_read_acked = 0;
+		nfs_read_recover_seq = nfs_read_seq;
+	}
+	nfs_read_send(slot);
+}
+
+static struct nfs_read_slot *nfs_read_find(unsigned long id)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + ARRAY_SIZE(nfs_read_slots); slot++) {
+		if (slot->id && slot->id == id)
+			return slot;
+	}
+
+	return NULL;
+}
+
+/*
+ * Note that the READ sent as @seq has been answered. Grow the window, drop
+ * READs past the end of the file and resend any lost before this one.
+ */
+static void nfs_read_answered(unsigned int seq)
+{
+	unsigned int reorder = clamp(nfs_read_window - 1, 1U, NFS_READ_REORDER);
+	struct nfs_read_slot *slot;
+
+	if (++nfs_read_acked >= nfs_read_window) {
+		nfs_read_acked = 0;
+		if (nfs_read_window < ARRAY_SIZE(nfs_read_slots))
+			nfs_read_window++;
+	}
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + ARRAY_SIZE(nfs_read_slots); slot++) {
+		if (!slot->id)
+			continue;
+		if (slot->offset >= nfs_read_end)
+			nfs_read_free(slot);
+		else if ((int)(seq - slot->seq) > 0 &&
+			 ++slot->later >= reorder)
+			nfs_read_lost(slot);
+	}
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -416,7 +578,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_fill(true);
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -652,19 +814,38 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
+static void nfs_show_progress(unsigned int len)
+{
+	ulong hash;
+
+	/* One '#' for every NFS_HASH_BYTES, whatever order they come in */
+	for (hash = roundup(nfs_read_bytes, NFS_HASH_BYTES);
+	     hash < nfs_read_bytes + len; hash += NFS_HASH_BYTES) {
+		if (hash && !(hash % (NFS_HASH_BYTES * HASHES_PER_LINE)))
+			puts("\n\t ");
+		putc('#');
+	}
+	nfs_read_bytes += len;
+}
+
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot;
+	ulong end = ~0UL;
+	unsigned int seq;
 	int rlen;
+	int eof = 0;
 	uchar *data_ptr;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	/* Only the headers are copied, the data is stored from the packet */
+	memset(&rpc_pkt.u.data[0], '\0', NFS_READ_HDR_SIZE);
+	memcpy(&rpc_pkt.u.data[0], pkt, min(len, (unsigned)NFS_READ_HDR_SIZE));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	slot = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -678,32 +859,54 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
+		/* file size, from the attributes */
+		end = ntohl(rpc_pkt.u.reply.data[6]);
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
 		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
+		/* file size, if the attributes are there and it is < 4GB */
+		if (nfsv3_data_offset > 1 && !rpc_pkt.u.reply.data[7])
+			end = ntohl(rpc_pkt.u.reply.data[8]);
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = ntohl(rpc_pkt.u.reply.data[2 + nfsv3_data_offset]);
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
 		data_ptr = (uchar *)
 			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
 	}
+	data_ptr = pkt + (data_ptr - &rpc_pkt.u.data[0]);
 
-	if (store_block(data_ptr, nfs_offset, rlen))
+	if (rlen < 0 || rlen > slot->len || data_ptr + rlen > pkt + len) {
+		puts("*** ERROR: Bad NFS READ reply\n");
+		return -9999;
+	}
+
+	nfs_show_progress(rlen);
+
+	if (store_block(data_ptr, slot->offset, rlen))
 			return -9999;
 
+	if (eof || !rlen)
+		end = min(end, slot->offset + rlen);
+	nfs_read_end = min(nfs_read_end, end);
+
+	seq = slot->seq;
+	if (rlen < slot->len && slot->offset + rlen < nfs_read_end) {
+		/* The server sent less than asked for, so ask for the rest */
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_send(slot);
+	} else {
+		nfs_read_free(slot);
+	}
+	nfs_read_answered(seq);
+
 	return rlen;
 }
 
@@ -720,6 +923,12 @@ static void nfs_timeout_handler(void)
 		net_set_timeout_handler(nfs_timeout +
 					NFS_TIMEOUT * nfs_timeout_count,
 					nfs_timeout_handler);
+		if (nfs_state == STATE_READ_REQ) {
+			/* Start again from one READ, resending all in flight */
+			nfs_read_window = 1;
+			nfs_read_acked = 0;
+			nfs_read_recover_seq = nfs_read_seq;
+		}
 		nfs_send();
 	}
 }
@@ -735,6 +944,10 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	if (dest != nfs_our_port)
 		return;
 
+	/* Other than READ replies, the whole packet is copied to an rpc_t */
+	if (nfs_state != STATE_READ_REQ && len > sizeof(struct rpc_t))
+		return;
+
 	switch (nfs_state) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
 		if (rpc_lookup_reply(PROG_MOUNT, pkt, len) == -NFS_RPC_DROP)
@@ -796,8 +1009,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_start();
 			nfs_send();
 		}
 		break;
@@ -822,19 +1034,27 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
+		if (rlen >= 0) {
+			/* Only give up after NFS_RETRY_COUNT timeouts in a row */
+			nfs_timeout_count = 0;
+			if (nfs_read_in_flight || nfs_read_next < nfs_read_end) {
+				nfs_read_fill(false);
+				break;
+			}
+			nfs_download_state = NETLOOP_SUCCESS;
+			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
+			nfs_read_cancel();
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
+			debug("NFS READ error (%d)\n", rlen);
+			nfs_read_cancel();
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
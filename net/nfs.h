@@ -39,10 +39,13 @@
 /*
  * Block size used for NFS read accesses.  A RPC reply packet (including  all
  * headers) must fit within a single Ethernet frame to avoid fragmentation.
- * However, if CONFIG_IP_DEFRAG is set, a bigger value could be used.  In any
- * case, most NFS servers are optimized for a power of 2.
+ * However, if CONFIG_IP_DEFRAG is set, a bigger value is used, up to what
+ * fits in CONFIG_NET_MAXDEFRAG.  In any case, most NFS servers are optimized
+ * for a power of 2.
  */
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#define NFS2_MAXDATA	8192	/* biggest NFSv2 read (rfc1094) */
+#define NFS3_MAXDATA	32768	/* biggest NFSv3 read we ask for */
 
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
@@ -0,0 +1,505 @@
+/*
+ * Minimal TCP client, for loading files over HTTP
+ *
+ * There is one connection at a time, opened from this end. Data from the
+ * peer is handed on as soon as it arrives in order. Segments which arrive
+ * early are kept in a buffer until the gap before them is filled; there is
+ * no SACK, so the peer learns of the gap from duplicate ACKs. In-order data
+ * is acknowledged every second segment, or after TCP_DELACK_MS.
+ *
+ * Either end closing the connection ends it here at once: our FIN is sent
+ * once and not resent, as net_loop() is about to finish anyway.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <asm/unaligned.h>
+
+#define TCP_MSS		1460	/* largest segment we take, for Ethernet */
+#define TCP_MSS_DEFAULT	536	/* peer's, if it does not say */
+#define TCP_RCV_WND	0xffff	/* receive window, without window scaling */
+#define TCP_OOO_SIZE	0x10000	/* early data buffer, must cover the window */
+#define TCP_OOO_RANGES	8	/* most separate runs of early data */
+#define TCP_TX_SIZE	2048	/* most data sent but not acknowledged */
+#define TCP_RTO		1000	/* first retransmission timeout in ms */
+#define TCP_DELACK_MS	40	/* longest an ACK is held back */
+#define TCP_IDLE_MS	30000	/* give up if nothing arrives for this long */
+
+#define TCP_OPT_END	0
+#define TCP_OPT_NOP	1
+#define TCP_OPT_MSS	2
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+};
+
+/* A run of early data, held in tcp_ooo_buf at its sequence number */
+struct tcp_range {
+	u32 start;
+	u32 end;
+};
+
+static enum tcp_state tcp_state;
+static struct in_addr tcp_dest;
+static uchar tcp_ethaddr[6];
+static int tcp_sport;
+static int tcp_dport;
+static tcp_rx_handler *tcp_rx_fn;
+static tcp_event_handler *tcp_event_fn;
+
+static u32 tcp_snd_una;		/* oldest sequence number not acknowledged */
+static u32 tcp_snd_nxt;		/* next sequence number to send */
+static u32 tcp_rcv_nxt;		/* next sequence number expected */
+static unsigned int tcp_peer_mss;
+
+/* Data not yet acknowledged, starting at tcp_snd_una once connected */
+static uchar tcp_tx_buf[TCP_TX_SIZE];
+static unsigned int tcp_tx_len;
+
+static ulong tcp_rto;		/* retransmission timeout in ms */
+static ulong tcp_rtx_time;	/* when the oldest unacknowledged was sent */
+static ulong tcp_rx_time;	/* when the last segment arrived */
+static unsigned int tcp_ack_pending;	/* segments not yet acknowledged */
+static ulong tcp_ack_time;	/* when the first of those arrived */
+
+static uchar *tcp_ooo_buf;
+static struct tcp_range tcp_ooo[TCP_OOO_RANGES];
+static int tcp_ooo_count;
+
+static void tcp_timeout_handler(void);
+
+static inline bool tcp_seq_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static unsigned int tcp_checksum(struct in_addr src, struct in_addr dest,
+				 const void *seg, unsigned int len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dest;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} ph;
+
+	ph.src = src;
+	ph.dest = dest;
+	ph.zero = 0;
+	ph.proto = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	return add_ip_checksums(sizeof(ph),
+				compute_ip_checksum(&ph, sizeof(ph)),
+				compute_ip_checksum(seg, len));
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const void *data,
+			     unsigned int len)
+{
+	struct ip_tcp_hdr *ip;
+	uchar *opt;
+	unsigned int hlen = TCP_HDR_SIZE;
+
+	ip = (struct ip_tcp_hdr *)(net_tx_packet + net_eth_hdr_size());
+	opt = (uchar *)(ip + 1);
+	if (flags & TCP_SYN) {
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		hlen += 4;
+	}
+	if (len)
+		memcpy((uchar *)ip + IP_HDR_SIZE + hlen, data, len);
+
+	ip->tcp_src = htons(tcp_sport);
+	ip->tcp_dst = htons(tcp_dport);
+	ip->tcp_seq = htonl(seq);
+	ip->tcp_ack = flags & TCP_ACK ? htonl(tcp_rcv_nxt) : 0;
+	ip->tcp_hlen = hlen << 2;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(TCP_RCV_WND);
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = tcp_checksum(net_ip, tcp_dest, &ip->tcp_src, hlen + len);
+
+	if (flags & TCP_ACK)
+		tcp_ack_pending = 0;
+	net_send_ip_packet(tcp_ethaddr, tcp_dest, IPPROTO_TCP, hlen + len);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+/* Send what is held from offset @off of tcp_tx_buf */
+static void tcp_output(unsigned int off)
+{
+	unsigned int len;
+	u8 flags;
+
+	while (off < tcp_tx_len) {
+		len = min(tcp_tx_len - off, tcp_peer_mss);
+		flags = TCP_ACK;
+		if (off + len == tcp_tx_len)
+			flags |= TCP_PSH;
+		tcp_send_segment(flags, tcp_snd_una + off, tcp_tx_buf + off,
+				 len);
+		off += len;
+	}
+}
+
+static void tcp_set_timer(void)
+{
+	ulong now = get_timer(0);
+	long wait;
+
+	wait = tcp_rx_time + TCP_IDLE_MS - now;
+	if (tcp_snd_una != tcp_snd_nxt)
+		wait = min(wait, (long)(tcp_rtx_time + tcp_rto - now));
+	if (tcp_ack_pending)
+		wait = min(wait, (long)(tcp_ack_time + TCP_DELACK_MS - now));
+
+	net_set_timeout_handler(max(wait, 1L), tcp_timeout_handler);
+}
+
+void tcp_stop(void)
+{
+	tcp_state = TCP_CLOSED;
+	net_set_timeout_handler(0, NULL);
+}
+
+/* Close the connection and tell the user why */
+static void tcp_end(enum tcp_event event)
+{
+	tcp_stop();
+	tcp_event_fn(event);
+}
+
+static void tcp_timeout_handler(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_ack_pending && now - tcp_ack_time >= TCP_DELACK_MS)
+		tcp_send_ack();
+
+	if (tcp_snd_una != tcp_snd_nxt && now - tcp_rtx_time >= tcp_rto) {
+		debug("TCP: resending from %u\n", tcp_snd_una);
+		tcp_rto *= 2;
+		tcp_rtx_time = now;
+		if (tcp_state == TCP_SYN_SENT)
+			tcp_send_segment(TCP_SYN, tcp_snd_una, NULL, 0);
+		else
+			tcp_output(0);
+	} else if (now - tcp_rx_time >= TCP_IDLE_MS) {
+		tcp_end(TCP_EVENT_TIMEOUT);
+		return;
+	}
+
+	tcp_set_timer();
+}
+
+static unsigned int tcp_get_mss(struct ip_tcp_hdr *ip, unsigned int hlen)
+{
+	const uchar *opt = (uchar *)(ip + 1);
+	const uchar *end = (uchar *)ip + IP_HDR_SIZE + hlen;
+	unsigned int mss;
+
+	while (opt < end && *opt != TCP_OPT_END) {
+		if (*opt == TCP_OPT_NOP) {
+			opt++;
+			continue;
+		}
+		if (end - opt < 2 || opt[1] < 2 || end - opt < opt[1])
+			break;
+		if (opt[0] == TCP_OPT_MSS && opt[1] == 4) {
+			mss = get_unaligned_be16(opt + 2);
+			return clamp(mss, 64U, (unsigned int)TCP_MSS);
+		}
+		opt += opt[1];
+	}
+
+	return TCP_MSS_DEFAULT;
+}
+
+static void tcp_ack_rcvd(u32 ack)
+{
+	unsigned int acked;
+
+	if (!tcp_seq_before(tcp_snd_una, ack) ||
+	    tcp_seq_before(tcp_snd_nxt, ack))
+		return;
+
+	acked = min(ack - tcp_snd_una, tcp_tx_len);
+	memmove(tcp_tx_buf, tcp_tx_buf + acked, tcp_tx_len - acked);
+	tcp_tx_len -= acked;
+	tcp_snd_una = ack;
+	tcp_rto = TCP_RTO;
+	tcp_rtx_time = get_timer(0);
+}
+
+static void tcp_deliver(const uchar *data, unsigned int len)
+{
+	tcp_rcv_nxt += len;
+	tcp_rx_fn(data, len);
+}
+
+static void tcp_ooo_store(u32 seq, const uchar *data, unsigned int len)
+{
+	u32 end = seq + len;
+	u32 limit = tcp_rcv_nxt + TCP_RCV_WND;
+	struct tcp_range *r;
+	unsigned int off, n;
+	int i;
+
+	if (!tcp_seq_before(seq, limit))
+		return;
+	if (tcp_seq_before(limit, end)) {
+		end = limit;
+		len = end - seq;
+	}
+
+	/* Find the first run which does not end before this data starts */
+	for (i = 0; i < tcp_ooo_count; i++) {
+		if (!tcp_seq_before(tcp_ooo[i].end, seq))
+			break;
+	}
+	r = &tcp_ooo[i];
+	if (i == tcp_ooo_count || tcp_seq_before(end, r->start)) {
+		if (tcp_ooo_count == TCP_OOO_RANGES)
+			return;
+		memmove(r + 1, r, (tcp_ooo_count - i) * sizeof(*r));
+		tcp_ooo_count++;
+		r->start = seq;
+		r->end = end;
+	} else {
+		if (tcp_seq_before(seq, r->start))
+			r->start = seq;
+		if (tcp_seq_before(r->end, end))
+			r->end = end;
+		/* Swallow the runs which this one now reaches */
+		while (i + 1 < tcp_ooo_count &&
+		       !tcp_seq_before(r->end, r[1].start)) {
+			if (tcp_seq_before(r->end, r[1].end))
+				r->end = r[1].end;
+			tcp_ooo_count--;
+			memmove(r + 1, r + 2,
+				(tcp_ooo_count - i - 1) * sizeof(*r));
+		}
+	}
+
+	off = seq & (TCP_OOO_SIZE - 1);
+	n = min(len, TCP_OOO_SIZE - off);
+	memcpy(tcp_ooo_buf + off, data, n);
+	memcpy(tcp_ooo_buf, data + n, len - n);
+}
+
+/* Hand on early data which the last segment has made contiguous */
+static void tcp_ooo_deliver(void)
+{
+	struct tcp_range *r = &tcp_ooo[0];
+	unsigned int off, len, n;
+
+	while (tcp_ooo_count && !tcp_seq_before(tcp_rcv_nxt, r->start)) {
+		if (tcp_seq_before(tcp_rcv_nxt, r->end)) {
+			off = tcp_rcv_nxt & (TCP_OOO_SIZE - 1);
+			len = r->end - tcp_rcv_nxt;
+			n = min(len, TCP_OOO_SIZE - off);
+			tcp_deliver(tcp_ooo_buf + off, n);
+			if (len > n && tcp_state != TCP_CLOSED)
+				tcp_deliver(tcp_ooo_buf, len - n);
+		}
+		if (tcp_state == TCP_CLOSED)
+			return;
+		tcp_ooo_count--;
+		memmove(r, r + 1, tcp_ooo_count * sizeof(*r));
+	}
+}
+
+static void tcp_data(u32 seq, const uchar *data, unsigned int len)
+{
+	u32 end = seq + len;
+
+	if (!tcp_seq_before(tcp_rcv_nxt, end)) {
+		/* Sent again, so our ACK was probably lost */
+		tcp_send_ack();
+		return;
+	}
+	if (tcp_seq_before(tcp_rcv_nxt, seq)) {
+		/* Early; the duplicate ACK tells the peer about the gap */
+		tcp_ooo_store(seq, data, len);
+		tcp_send_ack();
+		return;
+	}
+
+	data += tcp_rcv_nxt - seq;
+	tcp_deliver(data, end - tcp_rcv_nxt);
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (tcp_ooo_count) {
+		tcp_ooo_deliver();
+		if (tcp_state != TCP_CLOSED)
+			tcp_send_ack();
+	} else if (++tcp_ack_pending >= 2) {
+		tcp_send_ack();
+	} else {
+		tcp_ack_time = tcp_rx_time;
+	}
+}
+
+static void tcp_fin(u32 seq)
+{
+	if (seq != tcp_rcv_nxt) {
+		/* There is data missing before it */
+		tcp_send_ack();
+		return;
+	}
+
+	tcp_rcv_nxt++;
+	tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	tcp_end(TCP_EVENT_CLOSED);
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, unsigned int len)
+{
+	struct in_addr src = net_read_ip(&ip->ip_src);
+	unsigned int hlen, dlen;
+	const uchar *data;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_CLOSED || len < IP_TCP_HDR_SIZE)
+		return;
+	hlen = (ip->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || IP_HDR_SIZE + hlen > len)
+		return;
+	if (src.s_addr != tcp_dest.s_addr || ntohs(ip->tcp_src) != tcp_dport ||
+	    ntohs(ip->tcp_dst) != tcp_sport)
+		return;
+	if (tcp_checksum(src, net_read_ip(&ip->ip_dst), &ip->tcp_src,
+			 len - IP_HDR_SIZE)) {
+		debug("TCP: checksum bad\n");
+		return;
+	}
+
+	tcp_rx_time = get_timer(0);
+	flags = ip->tcp_flags;
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	data = (uchar *)ip + IP_HDR_SIZE + hlen;
+	dlen = len - IP_HDR_SIZE - hlen;
+
+	if (flags & TCP_RST) {
+		if (tcp_state == TCP_SYN_SENT ?
+		    (flags & TCP_ACK) && ack == tcp_snd_nxt :
+		    seq - tcp_rcv_nxt < TCP_RCV_WND)
+			tcp_end(TCP_EVENT_RESET);
+		return;
+	}
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if (!(flags & TCP_SYN) || !(flags & TCP_ACK) ||
+		    ack != tcp_snd_nxt)
+			return;
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_peer_mss = tcp_get_mss(ip, hlen);
+		tcp_rto = TCP_RTO;
+		tcp_state = TCP_ESTABLISHED;
+		tcp_send_ack();
+		tcp_event_fn(TCP_EVENT_CONNECTED);
+	} else if (flags & TCP_SYN) {
+		/* Our ACK of the peer's SYN was lost */
+		tcp_send_ack();
+	} else {
+		if (flags & TCP_ACK)
+			tcp_ack_rcvd(ack);
+		if (dlen)
+			tcp_data(seq, data, dlen);
+		if ((flags & TCP_FIN) && tcp_state != TCP_CLOSED)
+			tcp_fin(seq + dlen);
+	}
+
+	if (tcp_state != TCP_CLOSED)
+		tcp_set_timer();
+}
+
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_handler *rx,
+		tcp_event_handler *event)
+{
+	if (!tcp_ooo_buf) {
+		tcp_ooo_buf = malloc(TCP_OOO_SIZE);
+		if (!tcp_ooo_buf)
+			return -ENOMEM;
+	}
+
+	tcp_dest = dest;
+	tcp_dport = dport;
+	memset(tcp_ethaddr, 0, sizeof(tcp_ethaddr));
+	/* Move on from the last port, in case the peer still remembers it */
+	tcp_sport = 1024 + (tcp_sport + 1 + get_timer(0)) % 0xf000;
+	tcp_rx_fn = rx;
+	tcp_event_fn = event;
+
+	tcp_snd_una = get_ticks();
+	tcp_snd_nxt = tcp_snd_una + 1;
+	tcp_rcv_nxt = 0;
+	tcp_peer_mss = TCP_MSS_DEFAULT;
+	tcp_tx_len = 0;
+	tcp_ooo_count = 0;
+	tcp_ack_pending = 0;
+	tcp_rto = TCP_RTO;
+	tcp_rtx_time = get_timer(0);
+	tcp_rx_time = tcp_rtx_time;
+
+	tcp_state = TCP_SYN_SENT;
+	tcp_send_segment(TCP_SYN, tcp_snd_una, NULL, 0);
+	tcp_set_timer();
+
+	return 0;
+}
+
+int tcp_send(const void *data, unsigned int len)
+{
+	unsigned int off = tcp_tx_len;
+
+	if (tcp_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+	if (len > TCP_TX_SIZE - tcp_tx_len)
+		return -ENOSPC;
+
+	memcpy(tcp_tx_buf + off, data, len);
+	tcp_tx_len += len;
+	if (tcp_snd_una == tcp_snd_nxt)
+		tcp_rtx_time = get_timer(0);
+	tcp_snd_nxt += len;
+	tcp_output(off);
+	tcp_set_timer();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	switch (tcp_state) {
+	case TCP_SYN_SENT:
+		tcp_stop();
+		break;
+	case TCP_ESTABLISHED:
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+		tcp_stop();
+		break;
+	default:
+		break;
+	}
+}
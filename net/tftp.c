@@ -87,6 +87,8 @@ static int	tftp_tsize;
 /* The number of hashes we printed */
 static short	tftp_tsize_num_hash;
 #endif
+/* How the driver may receive the next block straight into place */
+static struct eth_rx_split tftp_rx_split;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -134,6 +136,19 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 lets the server send a window of several blocks before waiting
+ * for an ACK, which saves a round trip per block. The client ACKs the last
+ * block of each window, or the last block received in order if one goes
+ * missing, after which the server carries on from that block.
+ */
+static unsigned short tftp_window_size = 1;
+static unsigned short tftp_window_size_option = CONFIG_TFTP_WINDOWSIZE;
+/* blocks received in order since the last ACK */
+static unsigned short tftp_window_pos;
+/* the block last ACKed because one after it was missing, -1 if none */
+static ulong tftp_last_nack;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -193,7 +208,9 @@ static inline void store_block(int block, uchar *src, unsigned len)
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
 
-		memcpy(ptr, src, len);
+		/* The driver may have received the data there already */
+		if (!tftp_rx_split.placed || ptr != tftp_rx_split.dst)
+			memcpy(ptr, src, len);
 		unmap_sysmem(ptr);
 	}
 #ifdef CONFIG_MCAST_TFTP
@@ -205,12 +222,58 @@ static inline void store_block(int block, uchar *src, unsigned len)
 		net_boot_file_size = newsize;
 }
 
+#if defined(CONFIG_TFTP_TSIZE) && !defined(CONFIG_SYS_DIRECT_FLASH_TFTP)
+/* Check whether a split packet holds the block after the last one stored */
+static bool tftp_rx_match(uchar *pkt, int len)
+{
+	struct ethernet_hdr *et = (struct ethernet_hdr *)pkt;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	__be16 *s = (__be16 *)(ip + 1);
+
+	return et->et_protlen == htons(PROT_IP) &&
+		ip->ip_hl_v == 0x45 && ip->ip_p == IPPROTO_UDP &&
+		!(ip->ip_off & htons(IP_OFFS | IP_FLAGS_MFRAG)) &&
+		ntohs(ip->udp_dst) == tftp_our_port &&
+		ntohs(ip->udp_src) == tftp_remote_port &&
+		ntohs(s[0]) == TFTP_DATA &&
+		ntohs(s[1]) == (unsigned short)(tftp_prev_block + 1);
+}
+#endif
+
+/*
+ * Ask for the block after the last one stored to be received in place. This
+ * is only done for a full block within the file, as a packet which does not
+ * match may still leave bytes where the block goes.
+ */
+static void tftp_rx_split_next(void)
+{
+#if defined(CONFIG_TFTP_TSIZE) && !defined(CONFIG_SYS_DIRECT_FLASH_TFTP)
+	ulong offset = tftp_prev_block * tftp_block_size +
+		tftp_block_wrap_offset;
+
+	if (!tftp_tsize || offset + tftp_block_size > tftp_tsize)
+		return;
+#ifdef CONFIG_MCAST_TFTP
+	if (tftp_mcast_active)
+		return;
+#endif
+
+	tftp_rx_split.hdr_len = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4;
+	tftp_rx_split.dst = map_sysmem(load_addr + offset, tftp_block_size);
+	tftp_rx_split.len = tftp_block_size;
+	tftp_rx_split.match = tftp_rx_match;
+	eth_set_rx_split(&tftp_rx_split);
+#endif
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_window_pos = 0;
+	tftp_last_nack = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -372,6 +435,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* We only know how to receive a window, not send one */
+		if (tftp_window_size_option > 1 && tftp_state == STATE_SEND_RRQ)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_window_size_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -540,6 +607,16 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_window_size = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_window_size);
+				if (!tftp_window_size ||
+				    tftp_window_size > tftp_window_size_option)
+					tftp_window_size = 1;
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -568,6 +645,29 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
+
+		/*
+		 * A block out of order means one went missing, or that the
+		 * server is sending a window again because our ACK was lost.
+		 * Either way, ACK the last block received in order, once, so
+		 * that the server goes back to the block after it.
+		 */
+		if (tftp_state == STATE_DATA &&
+#ifdef CONFIG_MCAST_TFTP
+		    !tftp_mcast_active &&
+#endif
+		    ntohs(*(__be16 *)pkt) !=
+		    (unsigned short)(tftp_prev_block + 1)) {
+			if (tftp_window_size > 1 &&
+			    tftp_last_nack != tftp_prev_block) {
+				debug("Got block %d, resending ACK %ld\n",
+				      ntohs(*(__be16 *)pkt), tftp_prev_block);
+				tftp_last_nack = tftp_prev_block;
+				tftp_window_pos = 0;
+				tftp_send();
+			}
+			break;
+		}
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
 		update_block_number();
@@ -603,10 +703,18 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 
 		tftp_prev_block = tftp_cur_block;
+		tftp_last_nack = -1;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 		store_block(tftp_cur_block - 1, pkt + 2, len);
+		tftp_rx_split_next();
+
+		/* Only the last block of a window, or of the file, is ACKed */
+		if (++tftp_window_pos < tftp_window_size &&
+		    len == tftp_block_size)
+			break;
+		tftp_window_pos = 0;
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
@@ -690,6 +798,7 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		tftp_window_pos = 0;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -710,6 +819,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL)
+		tftp_window_size_option = simple_strtol(ep, NULL, 10);
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -731,8 +844,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -835,8 +948,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_window_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_window_size = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -864,8 +978,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_window_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_window_size = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
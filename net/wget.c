@@ -0,0 +1,308 @@
+/*
+ * HTTP file loader, using an HTTP/1.1 GET over TCP
+ *
+ * The body of the response is stored at the load address as it arrives.
+ * It may be sized by Content-Length, be chunked, or end when the server
+ * closes the connection. Redirects are not followed.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include "wget.h"
+
+#define HASHES_PER_LINE	65	/* Number of "loading" hashes per line	*/
+#define WGET_HASH_BYTES	(64 << 10)	/* Bytes per "loading" hash */
+#define WGET_LINE_SIZE	1024	/* Longest header line we take */
+
+enum wget_state {
+	WGET_STATUS,		/* waiting for the status line */
+	WGET_HEADER,		/* reading header lines */
+	WGET_BODY,		/* storing the body */
+	WGET_CHUNK_SIZE,	/* waiting for the size line of a chunk */
+	WGET_CHUNK_DATA,	/* storing a chunk */
+	WGET_CHUNK_END,		/* waiting for the line end after a chunk */
+	WGET_TRAILER,		/* reading the trailer after the last chunk */
+	WGET_DONE,
+};
+
+static enum wget_state wget_state;
+static struct in_addr wget_server_ip;
+static char wget_path[sizeof(net_boot_file_name) + 1];
+static char wget_line[WGET_LINE_SIZE];
+static unsigned int wget_line_len;
+static bool wget_chunked;
+static bool wget_has_length;
+static ulong wget_remaining;	/* bytes left in the body or chunk */
+static ulong wget_size;		/* bytes of the body stored so far */
+static ulong wget_time_start;
+
+static void wget_show_progress(unsigned int len)
+{
+	ulong hash;
+
+	for (hash = roundup(wget_size, WGET_HASH_BYTES);
+	     hash < wget_size + len; hash += WGET_HASH_BYTES) {
+		if (hash && !(hash % (WGET_HASH_BYTES * HASHES_PER_LINE)))
+			puts("\n\t ");
+		putc('#');
+	}
+}
+
+static void wget_store(const uchar *data, unsigned int len)
+{
+	void *ptr = map_sysmem(load_addr + wget_size, len);
+
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+	wget_show_progress(len);
+	wget_size += len;
+}
+
+static void wget_fail(void)
+{
+	wget_state = WGET_DONE;
+	tcp_close();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_success(void)
+{
+	ulong time_taken;
+
+	wget_state = WGET_DONE;
+	tcp_close();
+	net_boot_file_size = wget_size;
+
+	time_taken = get_timer(wget_time_start);
+	if (time_taken > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(wget_size / time_taken * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+/*
+ * Collect a line from the response, without its line end. This returns 1
+ * once a whole line is in wget_line, 0 if more data is needed, or -1 if
+ * the line is too long.
+ */
+static int wget_get_line(const uchar **data, unsigned int *len)
+{
+	unsigned int n;
+	char c;
+
+	while (*len) {
+		c = *(*data)++;
+		(*len)--;
+		if (c == '\n') {
+			n = wget_line_len;
+			if (n && wget_line[n - 1] == '\r')
+				n--;
+			wget_line[n] = '\0';
+			wget_line_len = 0;
+			return 1;
+		}
+		if (wget_line_len == WGET_LINE_SIZE - 1)
+			return -1;
+		wget_line[wget_line_len++] = c;
+	}
+
+	return 0;
+}
+
+/* Return the value of a header line if it is the header called @name */
+static const char *wget_header_value(const char *line, const char *name)
+{
+	int len = strlen(name);
+
+	if (strncasecmp(line, name, len) || line[len] != ':')
+		return NULL;
+	for (line += len + 1; *line == ' ' || *line == '\t'; line++)
+		;
+
+	return line;
+}
+
+/* Act on a line of the response, returning -1 if it is not acceptable */
+static int wget_handle_line(const char *line)
+{
+	const char *p;
+
+	switch (wget_state) {
+	case WGET_STATUS:
+		p = strchr(line, ' ');
+		if (strncmp(line, "HTTP/1.", 7) || !p) {
+			printf("\nHTTP error: bad response '%s'\n", line);
+			return -1;
+		}
+		if (simple_strtoul(p + 1, NULL, 10) != 200) {
+			printf("\nHTTP error: %s\n", p + 1);
+			return -1;
+		}
+		wget_state = WGET_HEADER;
+		break;
+	case WGET_HEADER:
+		if (!*line) {
+			if (wget_chunked)
+				wget_state = WGET_CHUNK_SIZE;
+			else if (wget_has_length && !wget_remaining)
+				wget_state = WGET_DONE;
+			else
+				wget_state = WGET_BODY;
+			break;
+		}
+		p = wget_header_value(line, "Content-Length");
+		if (p) {
+			wget_has_length = true;
+			wget_remaining = simple_strtoul(p, NULL, 10);
+		}
+		p = wget_header_value(line, "Transfer-Encoding");
+		if (p)
+			wget_chunked = !strncasecmp(p, "chunked", 7);
+		break;
+	case WGET_CHUNK_SIZE:
+		wget_remaining = simple_strtoul(line, NULL, 16);
+		wget_state = wget_remaining ? WGET_CHUNK_DATA : WGET_TRAILER;
+		break;
+	case WGET_CHUNK_END:
+		wget_state = WGET_CHUNK_SIZE;
+		break;
+	case WGET_TRAILER:
+		if (!*line)
+			wget_state = WGET_DONE;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static void wget_rx(const uchar *data, unsigned int len)
+{
+	unsigned int n;
+	int ret;
+
+	while (len && wget_state != WGET_DONE) {
+		if (wget_state == WGET_BODY || wget_state == WGET_CHUNK_DATA) {
+			n = len;
+			if (wget_state == WGET_CHUNK_DATA || wget_has_length) {
+				n = min_t(ulong, n, wget_remaining);
+				wget_remaining -= n;
+				if (!wget_remaining)
+					wget_state = wget_chunked ?
+						WGET_CHUNK_END : WGET_DONE;
+			}
+			wget_store(data, n);
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		ret = wget_get_line(&data, &len);
+		if (ret < 0) {
+			puts("\nHTTP error: header line too long\n");
+			wget_fail();
+			return;
+		}
+		if (!ret)
+			return;
+		if (wget_handle_line(wget_line)) {
+			wget_fail();
+			return;
+		}
+	}
+
+	if (wget_state == WGET_DONE)
+		wget_success();
+}
+
+static void wget_send_request(void)
+{
+	char req[sizeof(wget_path) + 128];
+	int len;
+
+	len = snprintf(req, sizeof(req),
+		       "GET %s HTTP/1.1\r\n"
+		       "Host: %pI4\r\n"
+		       "User-Agent: U-Boot\r\n"
+		       "Connection: close\r\n\r\n",
+		       wget_path, &wget_server_ip);
+	if (tcp_send(req, len)) {
+		puts("\nHTTP error: request too long\n");
+		wget_fail();
+	}
+}
+
+static void wget_event(enum tcp_event event)
+{
+	switch (event) {
+	case TCP_EVENT_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_EVENT_CLOSED:
+		/* Without a length or chunks, the body ends here */
+		if (wget_state == WGET_BODY && !wget_has_length) {
+			wget_success();
+		} else if (wget_state != WGET_DONE) {
+			puts("\nHTTP error: connection closed early\n");
+			wget_fail();
+		}
+		break;
+	case TCP_EVENT_RESET:
+		puts("\nHTTP error: connection reset\n");
+		wget_fail();
+		break;
+	case TCP_EVENT_TIMEOUT:
+		puts("\nHTTP error: server not answering\n");
+		wget_fail();
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	char *p;
+
+	wget_server_ip = net_server_ip;
+	p = strchr(net_boot_file_name, ':');
+	if (p) {
+		wget_server_ip = string_to_ip(net_boot_file_name);
+		++p;
+	} else {
+		p = net_boot_file_name;
+	}
+	if (!*p) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	sprintf(wget_path, "%s%s", *p == '/' ? "" : "/", p);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+	printf("Load address: 0x%lx\n", load_addr);
+	puts("Loading: *\b");
+
+	wget_state = WGET_STATUS;
+	wget_line_len = 0;
+	wget_chunked = false;
+	wget_has_length = false;
+	wget_remaining = 0;
+	wget_size = 0;
+	wget_time_start = get_timer(0);
+
+	if (tcp_connect(wget_server_ip, WGET_SERVER_PORT, wget_rx,
+			wget_event)) {
+		puts("\nHTTP error: out of memory\n");
+		net_set_state(NETLOOP_FAIL);
+	}
+}
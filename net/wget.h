@@ -0,0 +1,17 @@
+/*
+ * HTTP file loader
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+#define WGET_SERVER_PORT	80
+
+/*
+ * Start loading net_boot_file_name over HTTP (beginning of net_loop)
+ */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
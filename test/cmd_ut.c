@@ -19,6 +19,12 @@ static cmd_tbl_t cmd_ut_sub[] = {
 #if defined(CONFIG_UT_ENV)
 	U_BOOT_CMD_MKENT(env, CONFIG_SYS_MAXARGS, 1, do_ut_env, "", ""),
 #endif
+#ifdef CONFIG_UT_FS
+	U_BOOT_CMD_MKENT(fs, CONFIG_SYS_MAXARGS, 1, do_ut_fs, "", ""),
+#endif
+#ifdef CONFIG_UT_HASH
+	U_BOOT_CMD_MKENT(hash, CONFIG_SYS_MAXARGS, 1, do_ut_hash, "", ""),
+#endif
 #ifdef CONFIG_UT_OVERLAY
 	U_BOOT_CMD_MKENT(overlay, CONFIG_SYS_MAXARGS, 1, do_ut_overlay, "", ""),
 #endif
@@ -71,6 +77,12 @@ static char ut_help_text[] =
 #ifdef CONFIG_UT_ENV
 	"ut env [test-name]\n"
 #endif
+#ifdef CONFIG_UT_FS
+	"ut fs [test-name]\n"
+#endif
+#ifdef CONFIG_UT_HASH
+	"ut hash - Test checksums and hashes, and report their throughput\n"
+#endif
 #ifdef CONFIG_UT_OVERLAY
 	"ut overlay [test-name]\n"
 #endif
@@ -9,9 +9,12 @@
 #include <common.h>
 #include <bootm.h>
 #include <command.h>
+#include <decomp_stream.h>
+#include <job.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -117,8 +120,26 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
 
 #define TEST_BUFFER_SIZE	512
+#define SPEED_TEST_LOOPS	1000
 
 typedef int (*mutate_func)(void *, unsigned long, void *, unsigned long,
 			   unsigned long *);
@@ -282,6 +303,38 @@ static int uncompress_using_lz4(void *in, unsigned long in_size,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	assert(in_size == strlen(plain));
+	assert(memcmp(plain, in, in_size) == 0);
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	int ret;
+	size_t output_size = out_max;
+
+	ret = zstd_decompress(in, in_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -371,6 +424,583 @@ out:
 	return ret;
 }
 
+/* Print the ratio and decompression time of a compressor on the text */
+static int run_speed_test(char *name, mutate_func compress,
+			  mutate_func uncompress)
+{
+	ulong orig_size = strlen(plain);
+	ulong compressed_size = TEST_BUFFER_SIZE;
+	ulong uncompressed_size, start, elapsed;
+	void *compressed_buf, *uncompressed_buf;
+	int ret = 1;
+	int i;
+
+	compressed_buf = malloc(TEST_BUFFER_SIZE);
+	uncompressed_buf = malloc(TEST_BUFFER_SIZE);
+	if (!compressed_buf || !uncompressed_buf)
+		goto out;
+	if (compress((void *)plain, orig_size, compressed_buf,
+		     compressed_size, &compressed_size))
+		goto out;
+
+	start = timer_get_us();
+	for (i = 0; i < SPEED_TEST_LOOPS; i++) {
+		if (uncompress(compressed_buf, compressed_size,
+			       uncompressed_buf, TEST_BUFFER_SIZE,
+			       &uncompressed_size))
+			goto out;
+	}
+	elapsed = timer_get_us() - start;
+
+	printf(" %-6s %4lu bytes %3lu%% %6lu ns\n", name, compressed_size,
+	       compressed_size * 100 / orig_size,
+	       elapsed * 1000 / SPEED_TEST_LOOPS);
+	ret = 0;
+
+out:
+	if (ret)
+		printf(" %s: speed test FAILED\n", name);
+	free(uncompressed_buf);
+	free(compressed_buf);
+
+	return ret;
+}
+
+#define INFLATE_TEST_SIZE	(256 << 10)
+#define INFLATE_TEST_CHUNK	4096
+#define INFLATE_TEST_LOOPS	4
+
+/*
+ * Fill @buf with a mix of literals, runs, short- and long-distance repeats
+ * and text, so that inflate sees every kind of match copy
+ */
+static void fill_inflate_test(u8 *buf, ulong size)
+{
+	u32 seed = 0x2545f491;
+	ulong pos = 0, len, dist, i;
+
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		len = 3 + (seed >> 8) % 258;
+		if (len > size - pos)
+			len = size - pos;
+		switch ((seed >> 28) & 3) {
+		case 0:		/* literals */
+			for (i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				buf[pos + i] = seed >> 24;
+			}
+			break;
+		case 1:		/* overlapping repeat, distance 1 to 16 */
+			dist = 1 + (seed >> 4) % 16;
+			for (i = 0; i < len; i++)
+				buf[pos + i] = pos + i < dist ? 0 :
+					buf[pos + i - dist];
+			break;
+		case 2:		/* repeat from up to 32KB back */
+			dist = 1 + (seed >> 2) % (32 << 10);
+			for (i = 0; i < len; i++)
+				buf[pos + i] = pos + i < dist ? 'x' :
+					buf[pos + i - dist];
+			break;
+		default:	/* text */
+			for (i = 0; i < len; i++)
+				buf[pos + i] = plain[(pos + i) % strlen(plain)];
+			break;
+		}
+		pos += len;
+	}
+}
+
+/*
+ * Inflate gzip data through a small output buffer as gzwrite() does, so
+ * that matches are also copied from the sliding window
+ */
+static int gunzip_in_chunks(void *dst, ulong dstlen, u8 *src, ulong srclen,
+			    ulong *lenp)
+{
+	u8 chunk[INFLATE_TEST_CHUNK];
+	int offset, r;
+	ulong len = 0;
+	z_stream s;
+
+	offset = gzip_parse_header(src, srclen);
+	if (offset < 0)
+		return -1;
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -1;
+	s.next_in = src + offset;
+	s.avail_in = srclen - offset;
+	do {
+		s.next_out = chunk;
+		s.avail_out = sizeof(chunk);
+		r = inflate(&s, Z_SYNC_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END)
+			break;
+		if (len + sizeof(chunk) - s.avail_out > dstlen) {
+			r = Z_BUF_ERROR;
+			break;
+		}
+		memcpy(dst + len, chunk, sizeof(chunk) - s.avail_out);
+		len += sizeof(chunk) - s.avail_out;
+	} while (r != Z_STREAM_END);
+	inflateEnd(&s);
+	*lenp = len;
+
+	return r == Z_STREAM_END ? 0 : -1;
+}
+
+/*
+ * Check that gunzip() gives back exactly what was compressed, in one go
+ * and through a small output buffer, and print how long it takes
+ */
+static int run_inflate_test(void)
+{
+	ulong compressed_size, uncompressed_size;
+	ulong start, whole_us, chunked_us;
+	void *orig_buf, *compressed_buf, *uncompressed_buf;
+	int ret = 0;
+	int i;
+
+	orig_buf = malloc(INFLATE_TEST_SIZE);
+	compressed_buf = malloc(INFLATE_TEST_SIZE * 2);
+	uncompressed_buf = malloc(INFLATE_TEST_SIZE);
+	errcheck(orig_buf && compressed_buf && uncompressed_buf);
+	fill_inflate_test(orig_buf, INFLATE_TEST_SIZE);
+	compressed_size = INFLATE_TEST_SIZE * 2;
+	errcheck(gzip(compressed_buf, &compressed_size, orig_buf,
+		      INFLATE_TEST_SIZE) == 0);
+
+	start = timer_get_us();
+	for (i = 0; i < INFLATE_TEST_LOOPS; i++) {
+		memset(uncompressed_buf, '\0', INFLATE_TEST_SIZE);
+		uncompressed_size = compressed_size;
+		errcheck(gunzip(uncompressed_buf, INFLATE_TEST_SIZE,
+				compressed_buf, &uncompressed_size) == 0);
+	}
+	whole_us = (timer_get_us() - start) / INFLATE_TEST_LOOPS;
+	errcheck(uncompressed_size == INFLATE_TEST_SIZE);
+	errcheck(!memcmp(uncompressed_buf, orig_buf, INFLATE_TEST_SIZE));
+
+	start = timer_get_us();
+	for (i = 0; i < INFLATE_TEST_LOOPS; i++) {
+		memset(uncompressed_buf, '\0', INFLATE_TEST_SIZE);
+		errcheck(gunzip_in_chunks(uncompressed_buf, INFLATE_TEST_SIZE,
+					  compressed_buf, compressed_size,
+					  &uncompressed_size) == 0);
+	}
+	chunked_us = (timer_get_us() - start) / INFLATE_TEST_LOOPS;
+	errcheck(uncompressed_size == INFLATE_TEST_SIZE);
+	errcheck(!memcmp(uncompressed_buf, orig_buf, INFLATE_TEST_SIZE));
+
+	printf(" gunzip %u bytes from %lu: %lu us, in %u-byte pieces %lu us\n",
+	       INFLATE_TEST_SIZE, compressed_size, whole_us,
+	       INFLATE_TEST_CHUNK, chunked_us);
+
+out:
+	if (ret)
+		printf(" gunzip: inflate test FAILED\n");
+	free(uncompressed_buf);
+	free(compressed_buf);
+	free(orig_buf);
+
+	return ret;
+}
+
+#define LZ4_TEST_BLOCK		(64 << 10)
+#define LZ4_HASH_BITS		12
+
+/* Write an LZ4 length continuation of @len bytes */
+static u8 *lz4_put_length(u8 *op, ulong len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+
+	return op;
+}
+
+/* Write an LZ4 sequence of @lit_len literals and an optional match */
+static u8 *lz4_put_sequence(u8 *op, const u8 *lit, ulong lit_len,
+			    ulong offset, ulong match_len)
+{
+	u8 *token = op++;
+
+	*token = min(lit_len, 15UL) << 4;
+	if (lit_len >= 15)
+		op = lz4_put_length(op, lit_len - 15);
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+	if (!match_len)
+		return op;
+
+	put_unaligned_le16(offset, op);
+	op += 2;
+	match_len -= 4;
+	*token |= min(match_len, 15UL);
+	if (match_len >= 15)
+		op = lz4_put_length(op, match_len - 15);
+
+	return op;
+}
+
+/*
+ * Compress @len bytes into an LZ4 block with a greedy match finder. The
+ * matches need not be good, only valid, since this just feeds the decoder.
+ */
+static ulong lz4_compress_block(const u8 *src, ulong len, u8 *dst)
+{
+	u32 table[1 << LZ4_HASH_BITS] = { 0 };
+	const u8 *end = src + len;
+	const u8 *ip = src, *anchor = src, *ref;
+	u8 *op = dst;
+	ulong match_len;
+	u32 seq, hash;
+
+	/* The last match must start 12 bytes and end 5 bytes before the end */
+	while (len > 12 && ip < end - 12) {
+		seq = get_unaligned_le32(ip);
+		hash = (seq * 2654435761U) >> (32 - LZ4_HASH_BITS);
+		ref = src + table[hash];
+		table[hash] = ip - src;
+		if (ref >= ip || ip - ref > 0xffff ||
+		    get_unaligned_le32(ref) != seq) {
+			ip++;
+			continue;
+		}
+		for (match_len = 4; ip + match_len < end - 5 &&
+		     ip[match_len] == ref[match_len]; match_len++)
+			;
+		op = lz4_put_sequence(op, anchor, ip - anchor, ip - ref,
+				      match_len);
+		ip += match_len;
+		anchor = ip;
+	}
+
+	return lz4_put_sequence(op, anchor, end - anchor, 0, 0) - dst;
+}
+
+/*
+ * Wrap @len bytes in an LZ4 frame of 64KB blocks, without checksums, and
+ * with the content size in the header if @content_size
+ */
+static ulong lz4_compress_frame(const u8 *src, ulong len, u8 *dst,
+				bool content_size)
+{
+	static const u8 header[] = { 0x04, 0x22, 0x4d, 0x18, 0x60, 0x40, 0x82 };
+	u8 *op = dst + sizeof(header);
+	ulong pos, size, block_size;
+
+	memcpy(dst, header, sizeof(header));
+	if (content_size) {
+		/* The header checksum is not checked, so leave it be */
+		dst[4] |= 0x08;
+		put_unaligned_le64(len, dst + 6);
+		dst[14] = header[6];
+		op += 8;
+	}
+	for (pos = 0; pos < len; pos += size) {
+		size = min(len - pos, (ulong)LZ4_TEST_BLOCK);
+		block_size = lz4_compress_block(src + pos, size, op + 4);
+		put_unaligned_le32(block_size, op);
+		op += 4 + block_size;
+	}
+	put_unaligned_le32(0, op);
+
+	return op + 4 - dst;
+}
+
+/*
+ * Check that ulz4fn() gives back exactly what was compressed, and does
+ * not write past a short output buffer, and print how long it takes
+ */
+static int run_lz4_test(void)
+{
+	ulong compressed_size, start, elapsed;
+	void *orig_buf, *compressed_buf, *uncompressed_buf;
+	size_t uncompressed_size;
+	int ret = 0;
+	int i;
+
+	orig_buf = malloc(INFLATE_TEST_SIZE);
+	compressed_buf = malloc(INFLATE_TEST_SIZE * 2);
+	uncompressed_buf = malloc(INFLATE_TEST_SIZE);
+	errcheck(orig_buf && compressed_buf && uncompressed_buf);
+	fill_inflate_test(orig_buf, INFLATE_TEST_SIZE);
+	compressed_size = lz4_compress_frame(orig_buf, INFLATE_TEST_SIZE,
+					     compressed_buf, false);
+
+	start = timer_get_us();
+	for (i = 0; i < INFLATE_TEST_LOOPS; i++) {
+		memset(uncompressed_buf, '\0', INFLATE_TEST_SIZE);
+		uncompressed_size = INFLATE_TEST_SIZE;
+		errcheck(ulz4fn(compressed_buf, compressed_size,
+				uncompressed_buf, &uncompressed_size) == 0);
+	}
+	elapsed = (timer_get_us() - start) / INFLATE_TEST_LOOPS;
+	errcheck(uncompressed_size == INFLATE_TEST_SIZE);
+	errcheck(!memcmp(uncompressed_buf, orig_buf, INFLATE_TEST_SIZE));
+
+	/* Stop at the end of a short buffer, wild copies or not */
+	memset(uncompressed_buf, 'A', INFLATE_TEST_SIZE);
+	uncompressed_size = INFLATE_TEST_SIZE - 1;
+	errcheck(ulz4fn(compressed_buf, compressed_size, uncompressed_buf,
+			&uncompressed_size) != 0);
+	errcheck(((char *)uncompressed_buf)[INFLATE_TEST_SIZE - 1] == 'A');
+
+	/* A bad content checksum fails, unless checking is skipped */
+	memcpy(compressed_buf, lz4_compressed, lz4_compressed_size);
+	((char *)compressed_buf)[lz4_compressed_size - 1] ^= 1;
+	uncompressed_size = INFLATE_TEST_SIZE;
+	errcheck(ulz4fn(compressed_buf, lz4_compressed_size, uncompressed_buf,
+			&uncompressed_size) == -EBADMSG);
+	uncompressed_size = INFLATE_TEST_SIZE;
+	errcheck(ulz4fn_verify(compressed_buf, lz4_compressed_size,
+			       uncompressed_buf, &uncompressed_size,
+			       false) == 0);
+	errcheck(uncompressed_size == strlen(plain));
+	errcheck(!memcmp(uncompressed_buf, plain, strlen(plain)));
+
+	printf(" lz4 %u bytes from %lu: %lu us\n", INFLATE_TEST_SIZE,
+	       compressed_size, elapsed);
+
+out:
+	if (ret)
+		printf(" lz4: decode test FAILED\n");
+	free(uncompressed_buf);
+	free(compressed_buf);
+	free(orig_buf);
+
+	return ret;
+}
+
+#define FRAMES_TEST_COUNT	4
+#define FRAMES_TEST_SIZE	(512 << 10)
+
+/*
+ * Check that bootm_decomp_image() decompresses an image made of several
+ * frames, on other CPUs if there are any, and print how long that takes
+ * compared with decompressing the frames one after another
+ */
+static int run_frames_test(void)
+{
+	ulong frame_size[FRAMES_TEST_COUNT];
+	ulong compressed_size = 0, pos, start, serial, parallel, load_end;
+	void *orig_buf, *compressed_buf, *uncompressed_buf;
+	size_t uncompressed_size;
+	const ulong size = FRAMES_TEST_SIZE * FRAMES_TEST_COUNT;
+	int ret = 0;
+	int workers;
+	int i;
+
+	orig_buf = malloc(size);
+	compressed_buf = malloc(size * 2);
+	uncompressed_buf = malloc(size);
+	errcheck(orig_buf && compressed_buf && uncompressed_buf);
+	for (i = 0; i < FRAMES_TEST_COUNT; i++) {
+		fill_inflate_test(orig_buf + i * FRAMES_TEST_SIZE,
+				  FRAMES_TEST_SIZE);
+		frame_size[i] = lz4_compress_frame(orig_buf +
+						   i * FRAMES_TEST_SIZE,
+						   FRAMES_TEST_SIZE,
+						   compressed_buf +
+						   compressed_size, true);
+		compressed_size += frame_size[i];
+	}
+
+	start = timer_get_us();
+	for (i = 0, pos = 0; i < FRAMES_TEST_COUNT * INFLATE_TEST_LOOPS; i++) {
+		uncompressed_size = FRAMES_TEST_SIZE;
+		errcheck(ulz4fn(compressed_buf + pos,
+				frame_size[i % FRAMES_TEST_COUNT],
+				uncompressed_buf +
+				i % FRAMES_TEST_COUNT * FRAMES_TEST_SIZE,
+				&uncompressed_size) == 0);
+		pos = (pos + frame_size[i % FRAMES_TEST_COUNT]) %
+		      compressed_size;
+	}
+	serial = (timer_get_us() - start) / INFLATE_TEST_LOOPS;
+
+	/* Start any workers before timing them */
+	job_workers();
+	memset(uncompressed_buf, '\0', size);
+	start = timer_get_us();
+	for (i = 0; i < INFLATE_TEST_LOOPS; i++) {
+		errcheck(!bootm_decomp_image(IH_COMP_LZ4, 0, 1, IH_TYPE_KERNEL,
+					     uncompressed_buf, compressed_buf,
+					     compressed_size, size, false,
+					     &load_end));
+	}
+	parallel = (timer_get_us() - start) / INFLATE_TEST_LOOPS;
+	errcheck(load_end == size);
+	errcheck(!memcmp(uncompressed_buf, orig_buf, size));
+
+	/* Too little space, or a bad frame, fails */
+	errcheck(bootm_decomp_image(IH_COMP_LZ4, 0, 1, IH_TYPE_KERNEL,
+				    uncompressed_buf, compressed_buf,
+				    compressed_size, size - 1, false,
+				    &load_end));
+	memset(compressed_buf + frame_size[0] + 20, '\xff', 64);
+	errcheck(bootm_decomp_image(IH_COMP_LZ4, 0, 1, IH_TYPE_KERNEL,
+				    uncompressed_buf, compressed_buf,
+				    compressed_size, size, false, &load_end));
+
+	/* zstd frames go the same way */
+	for (i = 0; i < FRAMES_TEST_COUNT; i++)
+		memcpy(compressed_buf + i * zstd_compressed_size,
+		       zstd_compressed, zstd_compressed_size);
+	errcheck(!bootm_decomp_image(IH_COMP_ZSTD, 0, 1, IH_TYPE_KERNEL,
+				     uncompressed_buf, compressed_buf,
+				     zstd_compressed_size * FRAMES_TEST_COUNT,
+				     size, false, &load_end));
+	errcheck(load_end == strlen(plain) * FRAMES_TEST_COUNT);
+	for (i = 0; i < FRAMES_TEST_COUNT; i++)
+		errcheck(!memcmp(uncompressed_buf + i * strlen(plain), plain,
+				 strlen(plain)));
+
+	/* Workers stopped, as before booting an OS, start again when needed */
+	workers = job_workers();
+	job_stop_workers();
+	memset(uncompressed_buf, '\0', size);
+	errcheck(!bootm_decomp_image(IH_COMP_ZSTD, 0, 1, IH_TYPE_KERNEL,
+				     uncompressed_buf, compressed_buf,
+				     zstd_compressed_size * FRAMES_TEST_COUNT,
+				     size, false, &load_end));
+	errcheck(load_end == strlen(plain) * FRAMES_TEST_COUNT);
+	errcheck(!memcmp(uncompressed_buf + (FRAMES_TEST_COUNT - 1) *
+			 strlen(plain), plain, strlen(plain)));
+	errcheck(job_workers() == workers);
+
+	printf(" lz4 %d frames of %u bytes on %d workers: %lu us, serial %lu us\n",
+	       FRAMES_TEST_COUNT, FRAMES_TEST_SIZE, job_workers(), parallel,
+	       serial);
+
+out:
+	if (ret)
+		printf(" frames: decode test FAILED\n");
+	free(uncompressed_buf);
+	free(compressed_buf);
+	free(orig_buf);
+
+	return ret;
+}
+
+#ifdef CONFIG_DECOMP_STREAM
+/*
+ * Decompress @len bytes at @src with a decomp_stream, feeding it a piece of
+ * @step bytes at a time after a first piece big enough for the header
+ */
+static int stream_decomp(const u8 *src, ulong len, void *dst, ulong size,
+			 ulong step, size_t *outp)
+{
+	struct decomp_stream ds;
+	ulong pos = min(len, 64UL);
+	int ret;
+
+	ret = decomp_stream_start(&ds, dst, size, src, pos);
+	if (ret)
+		return ret;
+	for (; pos < len && !ret; pos += step)
+		ret = decomp_stream_feed(&ds, src + pos, min(len - pos, step));
+	ret = decomp_stream_end(&ds) ?: ret;
+	*outp = ds.out;
+
+	return ret;
+}
+
+/*
+ * Check that gzip and LZ4 data decompress the same whatever the pieces it
+ * arrives in, and that bad or truncated data is caught
+ */
+static int run_stream_test(void)
+{
+	static const ulong steps[] = { 1, 4093, 65536 + 3, INFLATE_TEST_SIZE };
+	ulong gzip_size, lz4_size;
+	void *orig_buf, *gzip_buf, *lz4_buf, *uncompressed_buf;
+	size_t uncompressed_size;
+	int ret = 0;
+	int i;
+
+	orig_buf = malloc(INFLATE_TEST_SIZE);
+	gzip_buf = malloc(INFLATE_TEST_SIZE * 2);
+	lz4_buf = malloc(INFLATE_TEST_SIZE * 2);
+	uncompressed_buf = malloc(INFLATE_TEST_SIZE);
+	errcheck(orig_buf && gzip_buf && lz4_buf && uncompressed_buf);
+	fill_inflate_test(orig_buf, INFLATE_TEST_SIZE);
+	gzip_size = INFLATE_TEST_SIZE * 2;
+	errcheck(gzip(gzip_buf, &gzip_size, orig_buf, INFLATE_TEST_SIZE) == 0);
+	lz4_size = lz4_compress_frame(orig_buf, INFLATE_TEST_SIZE, lz4_buf,
+				      true);
+
+	for (i = 0; i < ARRAY_SIZE(steps); i++) {
+		memset(uncompressed_buf, '\0', INFLATE_TEST_SIZE);
+		errcheck(stream_decomp(gzip_buf, gzip_size, uncompressed_buf,
+				       INFLATE_TEST_SIZE, steps[i],
+				       &uncompressed_size) == 0);
+		errcheck(uncompressed_size == INFLATE_TEST_SIZE);
+		errcheck(!memcmp(uncompressed_buf, orig_buf,
+				 INFLATE_TEST_SIZE));
+
+		memset(uncompressed_buf, '\0', INFLATE_TEST_SIZE);
+		errcheck(stream_decomp(lz4_buf, lz4_size, uncompressed_buf,
+				       INFLATE_TEST_SIZE, steps[i],
+				       &uncompressed_size) == 0);
+		errcheck(uncompressed_size == INFLATE_TEST_SIZE);
+		errcheck(!memcmp(uncompressed_buf, orig_buf,
+				 INFLATE_TEST_SIZE));
+	}
+
+	/* Truncated data, or too little space, fails */
+	errcheck(stream_decomp(gzip_buf, gzip_size - 1, uncompressed_buf,
+			       INFLATE_TEST_SIZE, 4093,
+			       &uncompressed_size) == -EINVAL);
+	errcheck(stream_decomp(lz4_buf, lz4_size - 1, uncompressed_buf,
+			       INFLATE_TEST_SIZE, 4093,
+			       &uncompressed_size) == -EINVAL);
+	errcheck(stream_decomp(gzip_buf, gzip_size, uncompressed_buf,
+			       INFLATE_TEST_SIZE - 1, 4093,
+			       &uncompressed_size) == -ENOBUFS);
+	errcheck(stream_decomp(lz4_buf, lz4_size, uncompressed_buf,
+			       INFLATE_TEST_SIZE - 1, 4093,
+			       &uncompressed_size) != 0);
+
+	/* The sample has a content checksum, which is checked */
+	errcheck(stream_decomp((const u8 *)lz4_compressed, lz4_compressed_size,
+			       uncompressed_buf, INFLATE_TEST_SIZE, 7,
+			       &uncompressed_size) == 0);
+	errcheck(uncompressed_size == strlen(plain));
+	errcheck(!memcmp(uncompressed_buf, plain, strlen(plain)));
+	memcpy(lz4_buf, lz4_compressed, lz4_compressed_size);
+	((char *)lz4_buf)[lz4_compressed_size - 1] ^= 1;
+	errcheck(stream_decomp(lz4_buf, lz4_compressed_size, uncompressed_buf,
+			       INFLATE_TEST_SIZE, 7,
+			       &uncompressed_size) == -EBADMSG);
+	((u8 *)gzip_buf)[gzip_size - 8] ^= 1;
+	errcheck(stream_decomp(gzip_buf, gzip_size, uncompressed_buf,
+			       INFLATE_TEST_SIZE, 4093,
+			       &uncompressed_size) == -EPROTO);
+
+	/* Other formats are left to the whole-image decompressors */
+	errcheck(stream_decomp((const u8 *)zstd_compressed,
+			       zstd_compressed_size, uncompressed_buf,
+			       INFLATE_TEST_SIZE, 4093,
+			       &uncompressed_size) == -EPROTONOSUPPORT);
+
+out:
+	if (ret)
+		printf(" stream: decode test FAILED\n");
+	free(uncompressed_buf);
+	free(lz4_buf);
+	free(gzip_buf);
+	free(orig_buf);
+
+	return ret;
+}
+#endif
+
 static int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 			     char *const argv[])
 {
@@ -381,6 +1011,26 @@ static int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 	err += run_test("lzma", compress_using_lzma, uncompress_using_lzma);
 	err += run_test("lzo", compress_using_lzo, uncompress_using_lzo);
 	err += run_test("lz4", compress_using_lz4, uncompress_using_lz4);
+	err += run_test("zstd", compress_using_zstd, uncompress_using_zstd);
+
+	printf(" compressed size, ratio and decompression time of %lu bytes:\n",
+	       (ulong)strlen(plain));
+	err += run_speed_test("gzip", compress_using_gzip,
+			      uncompress_using_gzip);
+	err += run_speed_test("bzip2", compress_using_bzip2,
+			      uncompress_using_bzip2);
+	err += run_speed_test("lzma", compress_using_lzma,
+			      uncompress_using_lzma);
+	err += run_speed_test("lzo", compress_using_lzo, uncompress_using_lzo);
+	err += run_speed_test("lz4", compress_using_lz4, uncompress_using_lz4);
+	err += run_speed_test("zstd", compress_using_zstd,
+			      uncompress_using_zstd);
+	err += run_inflate_test();
+	err += run_lz4_test();
+	err += run_frames_test();
+#ifdef CONFIG_DECOMP_STREAM
+	err += run_stream_test();
+#endif
 
 	printf("ut_compression %s\n", err == 0 ? "ok" : "FAILED");
 
@@ -423,13 +1073,13 @@ static int run_bootm_test(int comp_type, mutate_func compress)
 	err = bootm_decomp_image(comp_type, load_addr, image_start,
 				 IH_TYPE_KERNEL, map_sysmem(load_addr, 0),
 				 compress_buff, compress_size, unc_len,
-				 &load_end);
+				 false, &load_end);
 	if (err)
 		return err;
 	err = bootm_decomp_image(comp_type, load_addr, image_start,
 				 IH_TYPE_KERNEL, map_sysmem(load_addr, 0),
 				 compress_buff, compress_size, unc_len - 1,
-				 &load_end);
+				 false, &load_end);
 	if (!err)
 		return -EINVAL;
 
@@ -441,7 +1091,7 @@ static int run_bootm_test(int comp_type, mutate_func compress)
 	err = bootm_decomp_image(comp_type, load_addr, image_start,
 				 IH_TYPE_KERNEL, map_sysmem(load_addr, 0),
 				 compress_buff, compress_size, 0x10000,
-				 &load_end);
+				 false, &load_end);
 	if (!err)
 		return -EINVAL;
 
@@ -458,6 +1108,7 @@ static int do_ut_image_decomp(cmd_tbl_t *cmdtp, int flag, int argc,
 	err |= run_bootm_test(IH_COMP_LZMA, compress_using_lzma);
 	err |= run_bootm_test(IH_COMP_LZO, compress_using_lzo);
 	err |= run_bootm_test(IH_COMP_LZ4, compress_using_lz4);
+	err |= run_bootm_test(IH_COMP_ZSTD, compress_using_zstd);
 	err |= run_bootm_test(IH_COMP_NONE, compress_using_none);
 
 	printf("ut_image_decomp %s\n", err == 0 ? "ok" : "FAILED");
@@ -467,7 +1118,7 @@ static int do_ut_image_decomp(cmd_tbl_t *cmdtp, int flag, int argc,
 
 U_BOOT_CMD(
 	ut_compression,	5,	1,	do_ut_compression,
-	"Basic test of compressors: gzip bzip2 lzma lzo", ""
+	"Basic test of compressors: gzip bzip2 lzma lzo lz4 zstd", ""
 );
 
 U_BOOT_CMD(
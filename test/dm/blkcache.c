@@ -0,0 +1,174 @@
+/*
+ * Tests for the block cache
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define TEST_BLKSZ	512
+#define TEST_BLOCKS	1024
+
+static u8 *test_disk;
+static unsigned long test_reads;
+
+/* An in-memory block device that counts the transfers made */
+static unsigned long blkcache_test_read(struct udevice *dev, lbaint_t start,
+					lbaint_t blkcnt, void *buffer)
+{
+	if (start + blkcnt > TEST_BLOCKS)
+		return -EIO;
+
+	memcpy(buffer, test_disk + start * TEST_BLKSZ, blkcnt * TEST_BLKSZ);
+	test_reads++;
+
+	return blkcnt;
+}
+
+static unsigned long blkcache_test_write(struct udevice *dev, lbaint_t start,
+					 lbaint_t blkcnt, const void *buffer)
+{
+	if (start + blkcnt > TEST_BLOCKS)
+		return -EIO;
+
+	memcpy(test_disk + start * TEST_BLKSZ, buffer, blkcnt * TEST_BLKSZ);
+
+	return blkcnt;
+}
+
+static const struct blk_ops blkcache_test_ops = {
+	.read	= blkcache_test_read,
+	.write	= blkcache_test_write,
+};
+
+U_BOOT_DRIVER(blkcache_test_blk) = {
+	.name	= "blkcache_test_blk",
+	.id	= UCLASS_BLK,
+	.ops	= &blkcache_test_ops,
+};
+
+static int get_dev_stats(struct blk_desc *desc,
+			 struct block_cache_dev_stats *stats)
+{
+	int i;
+
+	for (i = 0; !blkcache_dev_stats(i, stats); i++)
+		if (stats->iftype == desc->if_type &&
+		    stats->devnum == desc->devnum)
+			return 0;
+
+	return -ENOENT;
+}
+
+/* Read one block, checking its contents, and return the transfers made */
+static unsigned long read_block(struct blk_desc *desc, lbaint_t blk)
+{
+	u8 buf[TEST_BLKSZ];
+
+	test_reads = 0;
+	if (blk_dread(desc, blk, 1, buf) != 1 ||
+	    memcmp(buf, test_disk + blk * TEST_BLKSZ, TEST_BLKSZ))
+		return -1UL;
+
+	return test_reads;
+}
+
+/* Test hits, read-ahead and invalidation in the block cache */
+static int dm_test_blkcache(struct unit_test_state *uts)
+{
+	struct block_cache_dev_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 buf[TEST_BLKSZ];
+	int i;
+
+	test_disk = malloc(TEST_BLOCKS * TEST_BLKSZ);
+	ut_assertnonnull(test_disk);
+	for (i = 0; i < TEST_BLOCKS * TEST_BLKSZ; i++)
+		test_disk[i] = i / TEST_BLKSZ + i;
+
+	ut_assertok(blk_create_device(gd->dm_root, "blkcache_test_blk", "test",
+				      IF_TYPE_HOST, 0, TEST_BLKSZ, TEST_BLOCKS,
+				      &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	/* Start empty, whatever earlier tests left in the cache */
+	blkcache_configure(0, 0);
+	blkcache_configure(2, 32);
+	blkcache_configure_readahead(8);
+	get_dev_stats(desc, &stats);
+
+	/* A block read twice comes from the cache the second time */
+	ut_asserteq(1, read_block(desc, 10));
+	ut_asserteq(0, read_block(desc, 10));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(1, stats.entries);
+
+	/* The third block in a row brings the next 8 with it */
+	ut_asserteq(1, read_block(desc, 100));
+	ut_asserteq(1, read_block(desc, 101));
+	ut_asserteq(1, read_block(desc, 102));
+	for (i = 103; i <= 110; i++)
+		ut_asserteq(0, read_block(desc, i));
+	ut_asserteq(1, read_block(desc, 111));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(16, stats.prefetched);
+	ut_asserteq(8, stats.prefetch_used);
+
+	/* Idle entries of another device make way for read-ahead */
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	for (i = 0; i < 32; i++)
+		blkcache_fill(IF_TYPE_HOST, desc->devnum + 1, i * 2, 1,
+			      TEST_BLKSZ, buf);
+	ut_asserteq(1, read_block(desc, 300));
+	ut_asserteq(1, read_block(desc, 301));
+	ut_asserteq(1, read_block(desc, 302));
+	for (i = 303; i <= 310; i++)
+		ut_asserteq(0, read_block(desc, i));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(8, stats.prefetch_used);
+	blkcache_invalidate(IF_TYPE_HOST, desc->devnum + 1);
+
+	/* Nothing is read ahead past the end of the device */
+	ut_asserteq(1, read_block(desc, TEST_BLOCKS - 4));
+	ut_asserteq(1, read_block(desc, TEST_BLOCKS - 3));
+	ut_asserteq(1, read_block(desc, TEST_BLOCKS - 2));
+	ut_asserteq(0, read_block(desc, TEST_BLOCKS - 1));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(1, stats.prefetched);
+
+	/* A write drops what the cache holds for the device */
+	ut_asserteq(1, blk_dread(desc, 200, 1, buf));
+	ut_asserteq(1, blk_dwrite(desc, 200, 1, buf));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(0, stats.entries);
+	ut_asserteq(1, read_block(desc, 10));
+
+	/* Lookups stay right with many entries spread over the hash */
+	blkcache_configure(1, 400);
+	for (i = 0; i < 800; i += 2)
+		ut_asserteq(1, read_block(desc, i));
+	for (i = 0; i < 800; i += 2)
+		ut_asserteq(0, read_block(desc, i));
+	ut_assertok(get_dev_stats(desc, &stats));
+	ut_asserteq(400, stats.entries);
+	ut_asserteq(400, stats.hits);
+
+	blkcache_configure(2, 32);
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_disk);
+
+	return 0;
+}
+DM_TEST(dm_test_blkcache, 0);
@@ -11,6 +11,7 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -66,6 +67,68 @@ static int dm_test_eth_alias(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_eth_alias, DM_TESTF_SCAN_FDT);
 
+/* Test that the receive statistics follow a ping */
+static int dm_test_eth_rx_stats(struct unit_test_state *uts)
+{
+	struct eth_rx_stats *stats;
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	stats = eth_get_rx_stats(dev);
+	memset(stats, '\0', sizeof(*stats));
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+	ut_asserteq_str("eth@10002000", env_get("ethact"));
+
+	ut_assert(stats->packets > 0);
+	ut_assert(stats->busy_polls > 0);
+	ut_assert(stats->max_batch > 0);
+	ut_assert(stats->polls >= stats->busy_polls);
+	ut_assert(stats->checks >= stats->polls);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_stats, DM_TESTF_SCAN_FDT);
+
+/* Test TFTP with blocks received straight into place */
+static int dm_test_eth_tftp_split(struct unit_test_state *uts)
+{
+	const int size = 4000;
+	uchar *buf;
+	int i;
+
+	buf = map_sysmem(load_addr, size);
+	memset(buf, '\0', size);
+	sandbox_eth_set_tftp_file(size);
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "split.bin",
+		      sizeof(net_boot_file_name));
+	env_set("ethact", "eth@10002000");
+	ut_asserteq(size, net_loop(TFTPGET));
+	ut_asserteq(size, net_boot_file_size);
+
+	/*
+	 * Every full block but the first is received split, and is accepted
+	 * the first time it is sent
+	 */
+	ut_asserteq(size / 512 - 1, sandbox_eth_get_tftp_placed());
+	ut_asserteq(0, sandbox_eth_get_tftp_resent());
+	for (i = 0; i < size; i++)
+		ut_asserteq(i % 251, buf[i]);
+
+	sandbox_eth_set_tftp_file(0);
+	net_server_ip.s_addr = 0;
+	net_boot_file_name[0] = '\0';
+	unmap_sysmem(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp_split, DM_TESTF_SCAN_FDT);
+
 static int dm_test_eth_prime(struct unit_test_state *uts)
 {
 	net_ping_ip = string_to_ip("1.1.2.2");
@@ -6,7 +6,10 @@
 
 #include <common.h>
 #include <dm.h>
+#include <errno.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -44,3 +47,186 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that multi-block transfers are announced with CMD23, without a stop */
+static int dm_test_mmc_cmd23(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	struct blk_desc *dev_desc;
+	char buf[8 * 512];
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_asserteq(8, blk_dread(dev_desc, 16, 8, buf));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev,
+					     MMC_CMD_READ_MULTIPLE_BLOCK));
+	ut_asserteq(0, sandbox_mmc_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION));
+
+	/* A single block needs neither */
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_asserteq(1, blk_dread(dev_desc, 100, 1, buf));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev, MMC_CMD_READ_SINGLE_BLOCK));
+	ut_asserteq(0, sandbox_mmc_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_asserteq(8, blk_dwrite(dev_desc, 16, 8, buf));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev,
+					     MMC_CMD_WRITE_MULTIPLE_BLOCK));
+	ut_asserteq(0, sandbox_mmc_cmd_count(dev, MMC_CMD_STOP_TRANSMISSION));
+
+	/* Reliable writes are for eMMC only */
+	ut_asserteq(-EOPNOTSUPP,
+		    mmc_set_reliable_write(mmc_get_mmc_dev(dev), true));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cmd23, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test queueing a read and collecting it later */
+static int dm_test_mmc_async(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	char buf[8 * 512], other[512];
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	ut_asserteq(-ENOENT, mmc_bread_complete(dev_desc));
+
+	memset(buf, '\0', sizeof(buf));
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_asserteq(8, mmc_bread_submit(dev_desc, 16, 8, buf));
+	ut_assert(sandbox_mmc_data_pending(dev));
+	ut_asserteq(-EBUSY, mmc_bread_submit(dev_desc, 24, 8, buf));
+	ut_asserteq(8, mmc_bread_complete(dev_desc));
+	ut_assert(!sandbox_mmc_data_pending(dev));
+	ut_assertok(strcmp(buf, "this is a test"));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	ut_asserteq(1, sandbox_mmc_cmd_count(dev,
+					     MMC_CMD_READ_MULTIPLE_BLOCK));
+	ut_asserteq(-ENOENT, mmc_bread_complete(dev_desc));
+
+	/* Any other access finishes the queued read first */
+	ut_asserteq(8, mmc_bread_submit(dev_desc, 16, 8, buf));
+	ut_asserteq(1, blk_dread(dev_desc, 100, 1, other));
+	ut_assert(!sandbox_mmc_data_pending(dev));
+	ut_asserteq(8, mmc_bread_complete(dev_desc));
+
+	/* So do commands that are not block accesses, and bus changes */
+	mmc = mmc_get_mmc_dev(dev);
+	sandbox_mmc_set_emmc(dev, true, 0x3c);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(8, mmc_bread_submit(dev_desc, 16, 8, buf));
+	ut_assertok(mmc_switch_part(mmc, 0));
+	ut_assert(!sandbox_mmc_data_pending(dev));
+	ut_asserteq(8, mmc_bread_complete(dev_desc));
+	ut_asserteq(8, mmc_bread_submit(dev_desc, 16, 8, buf));
+	mmc_set_clock(mmc, mmc->clock);
+	ut_assert(!sandbox_mmc_data_pending(dev));
+	ut_asserteq(8, mmc_bread_complete(dev_desc));
+	sandbox_mmc_set_emmc(dev, false, 0);
+	ut_assertok(mmc_init(mmc));
+
+	/* Reads past the end are refused up front */
+	ut_asserteq(-EINVAL, mmc_bread_submit(dev_desc, dev_desc->lba, 1,
+					      buf));
+	ut_asserteq(-ENOENT, mmc_bread_complete(dev_desc));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_async, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that an eMMC is run in HS200 when tuning works, and DDR52 if not */
+static int dm_test_mmc_hs200(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	char buf[512];
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	mmc = mmc_get_mmc_dev(dev);
+
+	sandbox_mmc_set_emmc(dev, true, 0x3c);
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_assertok(mmc_init(mmc));
+	ut_assert(!IS_SD(mmc));
+	ut_asserteq(MMC_TIMING_HS200, mmc->timing);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(0, mmc->ddr_mode);
+	ut_asserteq(MMC_HS200_MAX_DTR, mmc->clock);
+	ut_asserteq(8, sandbox_mmc_cmd_count(dev,
+					     MMC_CMD_SEND_TUNING_BLOCK_HS200));
+	ut_asserteq(1, blk_dread(dev_desc, 0, 1, buf));
+
+	/* With no working sample phase the card drops back to DDR52 */
+	sandbox_mmc_set_emmc(dev, true, 0);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_TIMING_DDR52, mmc->timing);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(1, mmc->ddr_mode);
+	ut_asserteq(52000000, mmc->clock);
+	ut_asserteq(1, blk_dread(dev_desc, 0, 1, buf));
+
+	/* The emulated SD card does not offer high speed */
+	sandbox_mmc_set_emmc(dev, false, 0);
+	ut_assertok(mmc_init(mmc));
+	ut_assert(IS_SD(mmc));
+	ut_asserteq(MMC_TIMING_LEGACY, mmc->timing);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_hs200, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_CMD_UNZIP
+/* Test that gzwrite() erases chunks of zeroes rather than writing them */
+static int dm_test_mmc_gzwrite(struct unit_test_state *uts)
+{
+	const ulong chunk = 64 << 10, size = 3 * chunk + 1000;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	ulong compressed_size;
+	u8 *data, *compressed;
+	int i;
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	ut_asserteq(1, mmc_erase_zero_grp(dev_desc));
+
+	/* Data, two chunks of zeroes, then a short chunk of data */
+	data = calloc(1, size);
+	compressed = malloc(size);
+	ut_assertnonnull(data);
+	ut_assertnonnull(compressed);
+	for (i = 0; i < chunk; i++)
+		data[i] = i % 251;
+	for (i = 3 * chunk; i < size; i++)
+		data[i] = i % 13 + 1;
+	compressed_size = size;
+	ut_assertok(gzip(compressed, &compressed_size, data, size));
+
+	sandbox_mmc_clear_cmd_counts(dev);
+	ut_assertok(gzwrite(compressed, compressed_size, dev_desc, chunk, 0,
+			    0));
+	ut_asserteq(2, sandbox_mmc_cmd_count(dev,
+					     MMC_CMD_WRITE_MULTIPLE_BLOCK));
+	ut_assert(sandbox_mmc_cmd_count(dev, MMC_CMD_ERASE) > 0);
+
+	/* A corrupt image is caught */
+	compressed[compressed_size - 8] ^= 1;
+	ut_assert(gzwrite(compressed, compressed_size, dev_desc, chunk, 0, 0));
+
+	free(compressed);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_gzwrite, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
@@ -0,0 +1,252 @@
+/*
+ * Tests for the partition table cache
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <console.h>
+#include <dm.h>
+#include <malloc.h>
+#include <membuff.h>
+#include <part.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define TEST_BLKSZ	512
+#define TEST_BLOCKS	1024
+
+static u8 *test_disk;
+static unsigned long test_reads;
+
+/* An in-memory block device that counts the reads made of it */
+static unsigned long part_test_read(struct udevice *dev, lbaint_t start,
+				    lbaint_t blkcnt, void *buffer)
+{
+	if (start + blkcnt > TEST_BLOCKS)
+		return -EIO;
+
+	memcpy(buffer, test_disk + start * TEST_BLKSZ, blkcnt * TEST_BLKSZ);
+	test_reads++;
+
+	return blkcnt;
+}
+
+static unsigned long part_test_write(struct udevice *dev, lbaint_t start,
+				     lbaint_t blkcnt, const void *buffer)
+{
+	if (start + blkcnt > TEST_BLOCKS)
+		return -EIO;
+
+	memcpy(test_disk + start * TEST_BLKSZ, buffer, blkcnt * TEST_BLKSZ);
+
+	return blkcnt;
+}
+
+static const struct blk_ops part_test_ops = {
+	.read	= part_test_read,
+	.write	= part_test_write,
+};
+
+U_BOOT_DRIVER(part_test_blk) = {
+	.name	= "part_test_blk",
+	.id	= UCLASS_BLK,
+	.ops	= &part_test_ops,
+};
+
+static void set_part(disk_partition_t *info, const char *name, int n,
+		     lbaint_t start, lbaint_t size)
+{
+	memset(info, '\0', sizeof(*info));
+	info->start = start;
+	info->size = size;
+	info->blksz = TEST_BLKSZ;
+	strcpy((char *)info->name, name);
+	sprintf(info->uuid, "bb8e3f23-1d74-4c5e-93d2-6ddc0c4e10%02x", n);
+}
+
+static int write_gpt(struct blk_desc *desc, int count)
+{
+	char guid[] = "375a56f7-d6c9-4e81-b5f0-09d41ca89efe";
+	disk_partition_t parts[3];
+
+	set_part(&parts[0], "boot", 1, 34, 100);
+	set_part(&parts[1], "rootfs", 2, 134, 200);
+	set_part(&parts[2], "data", 3, 334, 300);
+
+	return gpt_restore(desc, guid, parts, count);
+}
+
+/* Test that partitions are looked up in the cache until the table changes */
+static int dm_test_part_cache(struct unit_test_state *uts)
+{
+#ifdef CONFIG_BLOCK_CACHE
+	struct block_cache_stats blkcache;
+#endif
+	disk_partition_t info;
+	struct blk_desc *desc;
+	struct udevice *dev;
+
+	test_disk = calloc(TEST_BLOCKS, TEST_BLKSZ);
+	ut_assertnonnull(test_disk);
+
+#ifdef CONFIG_BLOCK_CACHE
+	/* Keep the block cache out of the read counts */
+	blkcache_stats(&blkcache);
+	blkcache_configure(0, 0);
+#endif
+
+	ut_assertok(blk_create_device(gd->dm_root, "part_test_blk", "part_test",
+				      IF_TYPE_HOST, -1, TEST_BLKSZ, TEST_BLOCKS,
+				      &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	desc->log2blksz = LOG2(desc->blksz);
+	ut_assertok(write_gpt(desc, 2));
+	part_init(desc);
+	ut_asserteq(PART_TYPE_EFI, desc->part_type);
+
+	/* The table is read once, then partitions come from the cache */
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 2, &info));
+	ut_assert(test_reads > 0);
+	ut_asserteq(134, info.start);
+	ut_asserteq(200, info.size);
+	ut_asserteq_str("rootfs", (char *)info.name);
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 1, &info));
+	ut_asserteq_str("boot", (char *)info.name);
+	ut_asserteq(-1, part_get_info(desc, 3, &info));
+	ut_asserteq(2, part_get_info_by_name(desc, "rootfs", &info));
+	ut_asserteq(134, info.start);
+	ut_asserteq(1, part_get_info_by_name(desc, "boot", &info));
+	ut_asserteq(0, test_reads);
+	ut_asserteq(-1, part_get_info_by_name(desc, "data", &info));
+
+	/* Writing a new table is seen by the next lookup */
+	ut_assertok(write_gpt(desc, 3));
+	ut_asserteq(3, part_get_info_by_name(desc, "data", &info));
+	ut_asserteq(334, info.start);
+	ut_asserteq(300, info.size);
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 3, &info));
+	ut_asserteq_str("data", (char *)info.name);
+	ut_asserteq(0, test_reads);
+
+	/* So is a rescan */
+	part_init(desc);
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 1, &info));
+	ut_assert(test_reads > 0);
+
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_disk);
+#ifdef CONFIG_BLOCK_CACHE
+	blkcache_configure(blkcache.max_blocks_per_entry, blkcache.max_entries);
+#endif
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache, 0);
+
+#ifdef CONFIG_MAC_PARTITION
+/* The start of the MAC blocks, as in disk/part_mac.h */
+struct test_mac_ddb {
+	u16 signature;
+	u16 blk_size;
+	u32 blk_count;
+};
+
+struct test_mac_part {
+	u16 signature;
+	u16 sig_pad;
+	u32 map_count;
+	u32 start_block;
+	u32 block_count;
+	char name[32];
+	char type[32];
+};
+
+static void write_mac_part(int n, int count, const char *name, u32 start,
+			   u32 size)
+{
+	struct test_mac_part *mp = (void *)(test_disk + n * TEST_BLKSZ);
+
+	mp->signature = 0x504d;
+	mp->map_count = count;
+	mp->start_block = start;
+	mp->block_count = size;
+	strcpy(mp->name, name);
+	strcpy(mp->type, "Apple_HFS");
+}
+
+/* Test that a MAC table is read once, without complaints, into the cache */
+static int dm_test_part_cache_mac(struct unit_test_state *uts)
+{
+#ifdef CONFIG_BLOCK_CACHE
+	struct block_cache_stats blkcache;
+#endif
+	struct test_mac_ddb *ddb;
+	disk_partition_t info;
+	struct blk_desc *desc;
+	struct udevice *dev;
+
+	test_disk = calloc(TEST_BLOCKS, TEST_BLKSZ);
+	ut_assertnonnull(test_disk);
+	ddb = (struct test_mac_ddb *)test_disk;
+	ddb->signature = 0x4552;
+	ddb->blk_size = TEST_BLKSZ;
+	ddb->blk_count = TEST_BLOCKS;
+	write_mac_part(1, 3, "map", 1, 3);
+	write_mac_part(2, 3, "boot", 100, 200);
+	write_mac_part(3, 3, "rootfs", 300, 400);
+
+#ifdef CONFIG_BLOCK_CACHE
+	blkcache_stats(&blkcache);
+	blkcache_configure(0, 0);
+#endif
+
+	ut_assertok(blk_create_device(gd->dm_root, "part_test_blk", "part_test",
+				      IF_TYPE_HOST, -1, TEST_BLKSZ, TEST_BLOCKS,
+				      &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	desc->log2blksz = LOG2(desc->blksz);
+	part_init(desc);
+	ut_asserteq(PART_TYPE_MAC, desc->part_type);
+
+	/* One read of each block of the table, and nothing printed */
+	console_record_reset_enable();
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 3, &info));
+	gd->flags &= ~GD_FLG_RECORD;
+	ut_assert(membuff_isempty(&gd->console_out));
+	ut_asserteq(4, test_reads);
+	ut_asserteq(300, info.start);
+	ut_asserteq(400, info.size);
+	ut_asserteq_str("rootfs", (char *)info.name);
+
+	test_reads = 0;
+	ut_assertok(part_get_info(desc, 2, &info));
+	ut_asserteq_str("boot", (char *)info.name);
+	ut_asserteq(-1, part_get_info(desc, 4, &info));
+	ut_asserteq(0, test_reads);
+	ut_asserteq(3, part_get_info_by_name(desc, "rootfs", &info));
+	ut_asserteq(300, info.start);
+
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_disk);
+#ifdef CONFIG_BLOCK_CACHE
+	blkcache_configure(blkcache.max_blocks_per_entry, blkcache.max_entries);
+#endif
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache_mac, 0);
+#endif
@@ -0,0 +1,538 @@
+/*
+ * Tests for the ext4 read path, run against an image built in memory
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <ext4fs.h>
+#include <ext_common.h>
+#include <fs.h>
+#include <malloc.h>
+#include <part.h>
+#include <dm/device-internal.h>
+#include <test/fs.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define IMG_BLKSZ	1024
+#define IMG_BLOCKS	1024
+#define IMG_INODES	32
+#define IMG_ITABLE	5	/* first inode table block */
+#define IMG_ROOTDIR	9	/* root directory block */
+#define IMG_BIGDIR	10	/* first block of the big directory */
+
+#define INO_IDX		12	/* "idx": the big directory, indexed */
+#define INO_LIN		13	/* "lin": the same blocks, not indexed */
+#define INO_FILE	14	/* first of the regular files */
+#define NUM_FILES	7
+#define IMG_ROOTLEAF	1010	/* extent leaf of a two-level root */
+#define IMG_ROOTDIR2	1011	/* where that leaf may move the root to */
+
+#define DIR_ENTRIES	50000
+#define DIRENT_LEN	20	/* "file%05d" plus the header, rounded up */
+#define LEAF_ENTRIES	(IMG_BLKSZ / DIRENT_LEN)
+#define ROOT_LIMIT	((IMG_BLKSZ - 32) / sizeof(struct dx_entry))
+#define NODE_LIMIT	((IMG_BLKSZ - 8) / sizeof(struct dx_entry))
+
+static const u32 test_seed[4] = {
+	0x0fbf23c0, 0x63ce4823, 0x8751a395, 0x0e6709dd
+};
+
+static u8 *test_img;
+static unsigned long test_reads;
+
+#ifdef CONFIG_BLOCK_CACHE
+static struct block_cache_stats test_blkcache;
+#endif
+
+/* Keep the block cache out of the read counts while a test runs */
+static void test_blkcache_off(void)
+{
+#ifdef CONFIG_BLOCK_CACHE
+	blkcache_stats(&test_blkcache);
+	blkcache_configure(0, 0);
+#endif
+}
+
+static void test_blkcache_restore(void)
+{
+#ifdef CONFIG_BLOCK_CACHE
+	blkcache_configure(test_blkcache.max_blocks_per_entry,
+			   test_blkcache.max_entries);
+#endif
+}
+
+/* An in-memory block device that counts the reads made of it */
+static unsigned long ext4_test_blk_read(struct udevice *dev, lbaint_t start,
+					lbaint_t blkcnt, void *buffer)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	if (start + blkcnt > desc->lba)
+		return -EIO;
+
+	memcpy(buffer, test_img + start * desc->blksz, blkcnt * desc->blksz);
+	test_reads++;
+
+	return blkcnt;
+}
+
+static unsigned long ext4_test_blk_write(struct udevice *dev, lbaint_t start,
+					 lbaint_t blkcnt, const void *buffer)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	if (start + blkcnt > desc->lba)
+		return -EIO;
+
+	memcpy(test_img + start * desc->blksz, buffer, blkcnt * desc->blksz);
+
+	return blkcnt;
+}
+
+static const struct blk_ops ext4_test_blk_ops = {
+	.read	= ext4_test_blk_read,
+	.write	= ext4_test_blk_write,
+};
+
+U_BOOT_DRIVER(ext4_test_blk) = {
+	.name	= "ext4_test_blk",
+	.id	= UCLASS_BLK,
+	.ops	= &ext4_test_blk_ops,
+};
+
+struct test_name {
+	u32 hash;
+	int idx;
+};
+
+static int test_name_cmp(const void *a, const void *b)
+{
+	const struct test_name *na = a, *nb = b;
+
+	if (na->hash != nb->hash)
+		return na->hash < nb->hash ? -1 : 1;
+
+	return na->idx - nb->idx;
+}
+
+static void *img_block(int blk)
+{
+	return test_img + blk * IMG_BLKSZ;
+}
+
+static int put_dirent(void *p, int ino, int reclen, const char *name,
+		      int type)
+{
+	struct ext2_dirent *dirent = p;
+
+	dirent->inode = cpu_to_le32(ino);
+	dirent->direntlen = cpu_to_le16(reclen);
+	dirent->namelen = strlen(name);
+	dirent->filetype = type;
+	memcpy(dirent + 1, name, dirent->namelen);
+
+	return reclen;
+}
+
+static void put_inode(int ino, int mode, u32 size, u32 flags, u32 start,
+		      u32 len)
+{
+	struct ext2_inode *inode = img_block(IMG_ITABLE) +
+				   (ino - 1) * sizeof(struct ext2_inode);
+	struct ext4_extent_header *eh;
+	struct ext4_extent *extent;
+
+	inode->mode = cpu_to_le16(mode);
+	inode->size = cpu_to_le32(size);
+	inode->nlinks = cpu_to_le16(1);
+	inode->flags = cpu_to_le32(flags | EXT4_EXTENTS_FL);
+
+	eh = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_max = cpu_to_le16(4);
+	if (!len)
+		return;
+
+	eh->eh_entries = cpu_to_le16(1);
+	extent = (struct ext4_extent *)(eh + 1);
+	extent->ee_len = cpu_to_le16(len);
+	extent->ee_start_lo = cpu_to_le32(start);
+}
+
+/*
+ * Build a single-group filesystem whose root holds "idx", a two-level
+ * htree directory with DIR_ENTRIES names, and "lin", an unindexed inode
+ * sharing the same directory blocks. Returns the directory size in blocks.
+ */
+static int build_image(void)
+{
+	struct ext2_sblock *sb = img_block(1);
+	struct ext2_block_group *bg = img_block(2);
+	int nleaves = DIV_ROUND_UP(DIR_ENTRIES, LEAF_ENTRIES);
+	int nnodes = DIV_ROUND_UP(nleaves, NODE_LIMIT);
+	struct test_name *names;
+	struct dx_countlimit *cl;
+	struct dx_root_info *info;
+	struct dx_entry *entries;
+	u32 *leafhash;
+	char name[16];
+	int i, j, leaf, off, dirblocks;
+	u8 *p;
+
+	names = calloc(DIR_ENTRIES, sizeof(*names));
+	leafhash = calloc(nleaves, sizeof(*leafhash));
+	if (!names || !leafhash) {
+		free(names);
+		free(leafhash);
+		return -ENOMEM;
+	}
+
+	dirblocks = 1 + nnodes + nleaves;
+	sb->magic = cpu_to_le16(EXT2_MAGIC);
+	sb->revision_level = cpu_to_le32(1);
+	sb->total_inodes = cpu_to_le32(IMG_INODES);
+	sb->total_blocks = cpu_to_le32(IMG_BLOCKS);
+	sb->first_data_block = cpu_to_le32(1);
+	sb->blocks_per_group = cpu_to_le32(8192);
+	sb->inodes_per_group = cpu_to_le32(IMG_INODES);
+	sb->first_inode = cpu_to_le32(11);
+	sb->inode_size = cpu_to_le16(sizeof(struct ext2_inode));
+	sb->feature_compatibility = cpu_to_le32(EXT4_FEATURE_COMPAT_DIR_INDEX);
+	sb->feature_incompat = cpu_to_le32(EXT4_FEATURE_INCOMPAT_EXTENTS);
+	for (i = 0; i < 4; i++)
+		sb->hash_seed[i] = cpu_to_le32(test_seed[i]);
+	sb->default_hash_version = DX_HASH_HALF_MD4;
+	sb->flags = cpu_to_le32(EXT2_FLAGS_UNSIGNED_HASH);
+	bg->inode_table_id = cpu_to_le32(IMG_ITABLE);
+
+	put_inode(2, FILETYPE_INO_DIRECTORY | 0755, IMG_BLKSZ, 0,
+		  IMG_ROOTDIR, 1);
+	put_inode(INO_IDX, FILETYPE_INO_DIRECTORY | 0755,
+		  dirblocks * IMG_BLKSZ, EXT4_INDEX_FL, IMG_BIGDIR, dirblocks);
+	put_inode(INO_LIN, FILETYPE_INO_DIRECTORY | 0755,
+		  dirblocks * IMG_BLKSZ, 0, IMG_BIGDIR, dirblocks);
+	for (i = 0; i < NUM_FILES; i++)
+		put_inode(INO_FILE + i, FILETYPE_INO_REG | 0644, i, 0, 0, 0);
+
+	p = img_block(IMG_ROOTDIR);
+	p += put_dirent(p, 2, 12, ".", FILETYPE_DIRECTORY);
+	p += put_dirent(p, 2, 12, "..", FILETYPE_DIRECTORY);
+	p += put_dirent(p, INO_IDX, 12, "idx", FILETYPE_DIRECTORY);
+	put_dirent(p, INO_LIN, IMG_BLKSZ - 36, "lin", FILETYPE_DIRECTORY);
+
+	/* Leaves hold the names in hash order */
+	for (i = 0; i < DIR_ENTRIES; i++) {
+		snprintf(name, sizeof(name), "file%05d", i);
+		ext4fs_dirhash(name, strlen(name), DX_HASH_HALF_MD4_UNSIGNED,
+			       test_seed, &names[i].hash);
+		names[i].idx = i;
+	}
+	qsort(names, DIR_ENTRIES, sizeof(*names), test_name_cmp);
+
+	for (leaf = 0, i = 0; leaf < nleaves; leaf++) {
+		p = img_block(IMG_BIGDIR + 1 + nnodes + leaf);
+		leafhash[leaf] = names[i].hash;
+		/* Mark a hash that continues from the previous leaf */
+		if (leaf && names[i].hash == names[i - 1].hash)
+			leafhash[leaf] |= 1;
+		for (j = 0, off = 0; j < LEAF_ENTRIES && i < DIR_ENTRIES;
+		     j++, i++) {
+			snprintf(name, sizeof(name), "file%05d", names[i].idx);
+			off += put_dirent(p + off,
+					  INO_FILE + names[i].idx % NUM_FILES,
+					  DIRENT_LEN, name, FILETYPE_REG);
+		}
+		/* The last entry takes up the rest of the block */
+		((struct ext2_dirent *)(p + off - DIRENT_LEN))->direntlen =
+			cpu_to_le16(IMG_BLKSZ - off + DIRENT_LEN);
+	}
+
+	/* Interior nodes, each indexing up to NODE_LIMIT leaves */
+	for (i = 0; i < nnodes; i++) {
+		p = img_block(IMG_BIGDIR + 1 + i);
+		put_dirent(p, 0, IMG_BLKSZ, "", 0);
+		entries = (struct dx_entry *)(p + sizeof(struct ext2_dirent));
+		cl = (struct dx_countlimit *)entries;
+		cl->limit = cpu_to_le16(NODE_LIMIT);
+		for (j = 0; j < NODE_LIMIT; j++) {
+			leaf = i * NODE_LIMIT + j;
+			if (leaf == nleaves)
+				break;
+			if (j)
+				entries[j].hash = cpu_to_le32(leafhash[leaf]);
+			entries[j].block = cpu_to_le32(1 + nnodes + leaf);
+		}
+		cl->count = cpu_to_le16(j);
+	}
+
+	/* The root, with fake "." and ".." entries in front of the index */
+	p = img_block(IMG_BIGDIR);
+	put_dirent(p, INO_IDX, 12, ".", FILETYPE_DIRECTORY);
+	put_dirent(p + 12, 2, IMG_BLKSZ - 12, "..", FILETYPE_DIRECTORY);
+	info = (struct dx_root_info *)(p + 24);
+	info->hash_version = DX_HASH_HALF_MD4;
+	info->info_length = sizeof(*info);
+	info->indirect_levels = 1;
+	entries = (struct dx_entry *)(info + 1);
+	cl = (struct dx_countlimit *)entries;
+	cl->limit = cpu_to_le16(ROOT_LIMIT);
+	cl->count = cpu_to_le16(nnodes);
+	for (i = 0; i < nnodes; i++) {
+		if (i)
+			entries[i].hash =
+				cpu_to_le32(leafhash[i * NODE_LIMIT]);
+		entries[i].block = cpu_to_le32(1 + i);
+	}
+
+	free(leafhash);
+	free(names);
+
+	return dirblocks;
+}
+
+/* Look a file up, returning its size or -1, and count the reads made */
+static loff_t lookup(const char *path, unsigned long *reads)
+{
+	loff_t size;
+	int ret;
+
+	test_reads = 0;
+	ret = ext4fs_open(path, &size);
+	*reads = test_reads;
+	if (ret)
+		return -1;
+
+	ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+	ext4fs_file = NULL;
+
+	return size;
+}
+
+/* Test that names in an htree directory are found through the index */
+static int fs_test_ext4_htree(struct unit_test_state *uts)
+{
+	unsigned long reads, max_reads = 0, lin_reads;
+	disk_partition_t info;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char path[32];
+	int i;
+
+	test_img = calloc(IMG_BLOCKS, IMG_BLKSZ);
+	ut_assertnonnull(test_img);
+	ut_assert(build_image() > 0);
+	test_blkcache_off();
+
+	ut_assertok(blk_create_device(gd->dm_root, "ext4_test_blk", "ext4_test",
+				      IF_TYPE_HOST, -1, 512,
+				      IMG_BLOCKS * IMG_BLKSZ / 512, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	desc->log2blksz = LOG2(desc->blksz);
+
+	memset(&info, 0, sizeof(info));
+	info.size = desc->lba;
+	info.blksz = desc->blksz;
+	ext4fs_set_blk_dev(desc, &info);
+	ut_assert(ext4fs_mount(info.size));
+
+	for (i = 0; i < DIR_ENTRIES; i += 97) {
+		snprintf(path, sizeof(path), "/idx/file%05d", i);
+		ut_asserteq(i % NUM_FILES, lookup(path, &reads));
+		max_reads = max(max_reads, reads);
+	}
+	ut_asserteq(-1, lookup("/idx/file50000", &reads));
+	max_reads = max(max_reads, reads);
+
+	/* The unindexed copy finds the same names, but has to scan for them */
+	snprintf(path, sizeof(path), "/lin/file%05d", DIR_ENTRIES - 1);
+	ut_asserteq((DIR_ENTRIES - 1) % NUM_FILES, lookup(path, &reads));
+	ut_asserteq(-1, lookup("/lin/file50000", &lin_reads));
+	printf("htree lookup: at most %lu reads, linear scan: %lu reads\n",
+	       max_reads, lin_reads);
+
+	/* root scan, root inode, dx root, dx node, leaf and file inode */
+	ut_assert(max_reads <= 16);
+	ut_assert(lin_reads > 100 * max_reads);
+
+	ext4fs_close();
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_img);
+	test_blkcache_restore();
+
+	return 0;
+}
+FS_TEST(fs_test_ext4_htree, 0);
+
+/* Count the reads made to find a file's size through the generic layer */
+static unsigned long size_reads(struct blk_desc *desc, const char *path,
+				loff_t *size)
+{
+	test_reads = 0;
+	if (fs_set_blk_dev_with_part(desc, 0) || fs_size(path, size))
+		*size = -1;
+
+	return test_reads;
+}
+
+/* Test that the filesystem stays mounted between commands until changed */
+static int fs_test_ext4_mount_cache(struct unit_test_state *uts)
+{
+	unsigned long first, reads;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 block[512];
+	loff_t size;
+
+	test_img = calloc(IMG_BLOCKS, IMG_BLKSZ);
+	ut_assertnonnull(test_img);
+	ut_assert(build_image() > 0);
+	test_blkcache_off();
+
+	ut_assertok(blk_create_device(gd->dm_root, "ext4_test_blk", "ext4_test",
+				      IF_TYPE_HOST, -1, 512,
+				      IMG_BLOCKS * IMG_BLKSZ / 512, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	desc->log2blksz = LOG2(desc->blksz);
+
+	first = size_reads(desc, "/idx/file00012", &size);
+	ut_asserteq(12 % NUM_FILES, size);
+
+	/* No probe and no superblock or root inode the second time */
+	reads = size_reads(desc, "/idx/file00012", &size);
+	ut_asserteq(12 % NUM_FILES, size);
+	printf("size: %lu reads mounting, %lu reads mounted\n", first, reads);
+	ut_assert(reads < first);
+
+	/* Writing to the device, even the same data, drops the mount */
+	ut_asserteq(1, blk_dread(desc, 0, 1, block));
+	ut_asserteq(1, blk_dwrite(desc, 0, 1, block));
+	ut_asserteq(first, size_reads(desc, "/idx/file00012", &size));
+	ut_asserteq(12 % NUM_FILES, size);
+
+	/* And so does an explicit unmount */
+	fs_umount();
+	ut_asserteq(first, size_reads(desc, "/idx/file00012", &size));
+
+	fs_umount();
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_img);
+	test_blkcache_restore();
+
+	return 0;
+}
+FS_TEST(fs_test_ext4_mount_cache, 0);
+
+/*
+ * Give the root directory of the image at @img a two-level extent tree,
+ * whose leaf maps it to @dirblk. Only the leaf depends on @dirblk.
+ */
+static void move_root_dir(u8 *img, int dirblk)
+{
+	u8 *save = test_img;
+	struct ext4_extent_header *eh;
+	struct ext4_extent_idx *idx;
+	struct ext4_extent *extent;
+	struct ext2_inode *inode;
+
+	test_img = img;
+	if (dirblk != IMG_ROOTDIR)
+		memcpy(img_block(dirblk), img_block(IMG_ROOTDIR), IMG_BLKSZ);
+
+	inode = img_block(IMG_ITABLE) + (2 - 1) * sizeof(struct ext2_inode);
+	eh = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	eh->eh_depth = cpu_to_le16(1);
+	idx = (struct ext4_extent_idx *)(eh + 1);
+	memset(idx, 0, sizeof(*idx));
+	idx->ei_leaf_lo = cpu_to_le32(IMG_ROOTLEAF);
+
+	eh = img_block(IMG_ROOTLEAF);
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_entries = cpu_to_le16(1);
+	eh->eh_max = cpu_to_le16(4);
+	extent = (struct ext4_extent *)(eh + 1);
+	extent->ee_len = cpu_to_le16(1);
+	extent->ee_start_lo = cpu_to_le32(dirblk);
+	test_img = save;
+}
+
+/* Mount a partition, look a file up and unmount, returning its size or -1 */
+static loff_t part_lookup(struct blk_desc *desc, disk_partition_t *info,
+			  const char *path)
+{
+	unsigned long reads;
+	loff_t size = -1;
+
+	ext4fs_set_blk_dev(desc, info);
+	if (ext4fs_mount(info->size)) {
+		size = lookup(path, &reads);
+		/* Unmount, leaving what ext4fs_close() would clear up */
+		free(ext4fs_root);
+		ext4fs_root = NULL;
+	}
+
+	return size;
+}
+
+/* Test that extent maps are not shared between partitions */
+static int fs_test_ext4_extmap_part(struct unit_test_state *uts)
+{
+	disk_partition_t info[2];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 *img2;
+	int i;
+
+	/*
+	 * Two copies of the image, with the same root inode, but the
+	 * second has its root directory elsewhere and with "new" in it
+	 */
+	test_img = calloc(2 * IMG_BLOCKS, IMG_BLKSZ);
+	ut_assertnonnull(test_img);
+	ut_assert(build_image() > 0);
+	img2 = test_img + IMG_BLOCKS * IMG_BLKSZ;
+	memcpy(img2, test_img, IMG_BLOCKS * IMG_BLKSZ);
+	move_root_dir(test_img, IMG_ROOTDIR);
+	move_root_dir(img2, IMG_ROOTDIR2);
+	put_dirent(img2 + IMG_ROOTDIR2 * IMG_BLKSZ + 36, INO_LIN, 12, "lin",
+		   FILETYPE_DIRECTORY);
+	put_dirent(img2 + IMG_ROOTDIR2 * IMG_BLKSZ + 48, INO_FILE + 3,
+		   IMG_BLKSZ - 48, "new", FILETYPE_REG);
+	test_blkcache_off();
+
+	ut_assertok(blk_create_device(gd->dm_root, "ext4_test_blk", "ext4_test",
+				      IF_TYPE_HOST, -1, 512,
+				      2 * IMG_BLOCKS * IMG_BLKSZ / 512, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	desc->log2blksz = LOG2(desc->blksz);
+
+	memset(info, 0, sizeof(info));
+	for (i = 0; i < 2; i++) {
+		info[i].start = i * IMG_BLOCKS * IMG_BLKSZ / 512;
+		info[i].size = IMG_BLOCKS * IMG_BLKSZ / 512;
+		info[i].blksz = desc->blksz;
+	}
+
+	/* Each lookup ends with the root directory's map loaded */
+	ut_asserteq(-1, part_lookup(desc, &info[0], "/new"));
+	ut_asserteq(3, part_lookup(desc, &info[1], "/new"));
+	ut_asserteq(-1, part_lookup(desc, &info[0], "/new"));
+
+	ext4fs_close();
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	free(test_img);
+	test_blkcache_restore();
+
+	return 0;
+}
+FS_TEST(fs_test_ext4_extmap_part, 0);
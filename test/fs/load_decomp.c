@@ -0,0 +1,111 @@
+/*
+ * Tests for decompressing a file while it is loaded, using the sandbox host
+ * filesystem and a host block device
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <test/fs.h>
+#include <test/ut.h>
+
+#define TEST_FILE	"/tmp/u-boot-load-decomp.gz"
+#define TEST_SIZE	((2 << 20) + 3)	/* compresses to several reads */
+#define TEST_ADDR	0x100000
+
+/* Write @len bytes to TEST_FILE, padded with zeroes to a whole block */
+static int write_test_file(const void *buf, ulong len)
+{
+	char pad[512] = { 0 };
+	int fd;
+
+	os_unlink(TEST_FILE);
+	fd = os_open(TEST_FILE, OS_O_WRONLY | OS_O_CREAT);
+	if (fd < 0)
+		return -1;
+	if (os_write(fd, buf, len) != len ||
+	    os_write(fd, pad, -len % sizeof(pad)) != -len % sizeof(pad)) {
+		os_close(fd);
+		return -1;
+	}
+	os_close(fd);
+
+	return 0;
+}
+
+/* Test that 'load -d' and 'read -d' decompress what they read */
+static int fs_test_load_decomp(struct unit_test_state *uts)
+{
+	ulong compressed_size, outlen;
+	loff_t actread;
+	char cmd[128];
+	u8 *data, *compressed;
+	u32 seed = 1;
+	int i;
+
+	/* Half random, so that it does not compress to a single read */
+	data = malloc(TEST_SIZE);
+	compressed = malloc(TEST_SIZE * 2);
+	ut_assertnonnull(data);
+	ut_assertnonnull(compressed);
+	for (i = 0; i < TEST_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (seed >> 28) | (i >> 10 << 4);
+	}
+	compressed_size = TEST_SIZE * 2;
+	ut_assertok(gzip(compressed, &compressed_size, data, TEST_SIZE));
+	ut_assert(compressed_size > (1 << 20));
+	ut_assertok(write_test_file(compressed, compressed_size));
+
+	memset(map_sysmem(TEST_ADDR, TEST_SIZE), 0, TEST_SIZE);
+	snprintf(cmd, sizeof(cmd), "load -d hostfs - %x %s", TEST_ADDR,
+		 TEST_FILE);
+	ut_assertok(run_command(cmd, 0));
+	ut_assertok(memcmp(map_sysmem(TEST_ADDR, TEST_SIZE), data,
+			   TEST_SIZE));
+	ut_asserteq(TEST_SIZE, env_get_hex("filesize", 0));
+
+	/* The same from a block device, ignoring the padding at the end */
+	snprintf(cmd, sizeof(cmd), "host bind 3 %s", TEST_FILE);
+	ut_assertok(run_command(cmd, 0));
+	memset(map_sysmem(TEST_ADDR, TEST_SIZE), 0, TEST_SIZE);
+	snprintf(cmd, sizeof(cmd), "read -d host 3 %x 0 %lx", TEST_ADDR,
+		 DIV_ROUND_UP(compressed_size, 512));
+	ut_assertok(run_command(cmd, 0));
+	ut_assertok(memcmp(map_sysmem(TEST_ADDR, TEST_SIZE), data,
+			   TEST_SIZE));
+	ut_asserteq(TEST_SIZE, env_get_hex("filesize", 0));
+
+	/* Too few blocks fail */
+	snprintf(cmd, sizeof(cmd), "read -d host 3 %x 0 %lx", TEST_ADDR,
+		 compressed_size / 512 - 1);
+	ut_assert(run_command(cmd, 0));
+	ut_assertok(run_command("host bind 3", 0));
+
+	/* So do too little space and a truncated file */
+	ut_assertok(fs_set_blk_dev("hostfs", "-", FS_TYPE_ANY));
+	ut_asserteq(-ENOBUFS, fs_read_decomp(TEST_FILE, TEST_ADDR,
+					     TEST_SIZE - 1, 0, 0, &actread,
+					     &outlen));
+	snprintf(cmd, sizeof(cmd), "load -d hostfs - %x %s 80000", TEST_ADDR,
+		 TEST_FILE);
+	ut_assert(run_command(cmd, 0));
+
+	/* As does a file which is not compressed */
+	ut_assertok(write_test_file(data, TEST_SIZE));
+	snprintf(cmd, sizeof(cmd), "load -d hostfs - %x %s", TEST_ADDR,
+		 TEST_FILE);
+	ut_assert(run_command(cmd, 0));
+
+	os_unlink(TEST_FILE);
+	free(compressed);
+	free(data);
+
+	return 0;
+}
+FS_TEST(fs_test_load_decomp, 0);
@@ -0,0 +1,87 @@
+/*
+ * Tests for hashing a file while it is loaded, using the sandbox host
+ * filesystem
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <hash.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <test/fs.h>
+#include <test/ut.h>
+
+#define TEST_FILE	"/tmp/u-boot-load-hash.bin"
+#define TEST_SIZE	((600 << 10) + 1)	/* a few reads, ending mid-block */
+#define TEST_ADDR	0x100000
+
+/* Hash @len bytes at @addr and return the digest in hex */
+static int hex_digest(const char *algo_name, ulong addr, ulong len,
+		      char *hex)
+{
+	uint8_t digest[HASH_MAX_DIGEST_SIZE];
+	int size = sizeof(digest), i;
+
+	if (hash_block(algo_name, map_sysmem(addr, len), len, digest, &size))
+		return -1;
+	for (i = 0; i < size; i++)
+		sprintf(hex + i * 2, "%02x", digest[i]);
+
+	return 0;
+}
+
+/* Test that 'load -h' loads the file and hashes what it loaded */
+static int fs_test_load_hash(struct unit_test_state *uts)
+{
+	char hex[HASH_MAX_DIGEST_SIZE * 2 + 1];
+	char cmd[128];
+	u8 *data;
+	int fd, i;
+
+	data = malloc(TEST_SIZE);
+	ut_assertnonnull(data);
+	for (i = 0; i < TEST_SIZE; i++)
+		data[i] = i * 7 + (i >> 11);
+	os_unlink(TEST_FILE);
+	fd = os_open(TEST_FILE, OS_O_WRONLY | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	ut_asserteq(TEST_SIZE, os_write(fd, data, TEST_SIZE));
+	os_close(fd);
+
+	/* The whole file */
+	memset(map_sysmem(TEST_ADDR, TEST_SIZE), 0, TEST_SIZE);
+	snprintf(cmd, sizeof(cmd), "load -h sha256 hostfs - %x %s",
+		 TEST_ADDR, TEST_FILE);
+	ut_assertok(run_command(cmd, 0));
+	ut_assertok(memcmp(map_sysmem(TEST_ADDR, TEST_SIZE), data,
+			   TEST_SIZE));
+	ut_asserteq(TEST_SIZE, env_get_hex("filesize", 0));
+	ut_assertok(hex_digest("sha256", TEST_ADDR, TEST_SIZE, hex));
+	ut_asserteq_str(hex, env_get("filehash"));
+
+	/* Part of it, with another algorithm */
+	snprintf(cmd, sizeof(cmd), "load -h sha1 hostfs - %x %s 50001 1000",
+		 TEST_ADDR, TEST_FILE);
+	ut_assertok(run_command(cmd, 0));
+	ut_assertok(memcmp(map_sysmem(TEST_ADDR, 0x50001), data + 0x1000,
+			   0x50001));
+	ut_assertok(hex_digest("sha1", TEST_ADDR, 0x50001, hex));
+	ut_asserteq_str(hex, env_get("filehash"));
+
+	/* Unknown algorithms and missing files fail */
+	snprintf(cmd, sizeof(cmd), "load -h nohash hostfs - %x %s",
+		 TEST_ADDR, TEST_FILE);
+	ut_assert(run_command(cmd, 0));
+	snprintf(cmd, sizeof(cmd), "load -h sha256 hostfs - %x %s.none",
+		 TEST_ADDR, TEST_FILE);
+	ut_assert(run_command(cmd, 0));
+
+	os_unlink(TEST_FILE);
+	free(data);
+
+	return 0;
+}
+FS_TEST(fs_test_load_hash, 0);
@@ -0,0 +1,310 @@
+/*
+ * Tests for the checksum and hash functions, with a throughput report
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+
+#define HASH_SPEED_SIZE		(1 << 20)
+#define HASH_SPEED_MIN_US	200000
+
+/* Bit-at-a-time CRC32 to check the table-driven one against */
+static u32 crc32_bitwise(u32 crc, const u8 *p, uint len)
+{
+	int k;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *p++;
+		for (k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+	}
+
+	return ~crc;
+}
+
+static int test_crc32_vectors(void)
+{
+	static const struct {
+		const char *data;
+		u32 crc;
+	} vectors[] = {
+		{ "", 0 },
+		{ "a", 0xe8b7be43 },
+		{ "123456789", 0xcbf43926 },
+		{ "The quick brown fox jumps over the lazy dog", 0x414fa339 },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		const char *data = vectors[i].data;
+		u32 crc = crc32(0, (const u8 *)data, strlen(data));
+
+		if (crc != vectors[i].crc) {
+			printf("%s: crc32(\"%s\") is %08x, expected %08x\n",
+			       __func__, data, crc, vectors[i].crc);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Check every alignment and tail length, and that CRCs can be chained */
+static int test_crc32_lengths(void)
+{
+	u8 buf[80];
+	u32 crc, expect;
+	int start, len, i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 167 + 13;
+
+	for (start = 0; start < 8; start++) {
+		for (len = 0; start + len <= sizeof(buf); len++) {
+			expect = crc32_bitwise(0x12345678, buf + start, len);
+			crc = crc32(0x12345678, buf + start, len);
+			if (crc != expect) {
+				printf("%s: start %d len %d: %08x, expected %08x\n",
+				       __func__, start, len, crc, expect);
+				return -EINVAL;
+			}
+
+			crc = crc32(0x12345678, buf + start, len / 3);
+			crc = crc32(crc, buf + start + len / 3, len - len / 3);
+			if (crc != expect) {
+				printf("%s: start %d len %d: chained CRC differs\n",
+				       __func__, start, len);
+				return -EINVAL;
+			}
+
+			if (crc32_no_comp(~0x12345678, buf + start, len) !=
+			    ~expect) {
+				printf("%s: start %d len %d: crc32_no_comp() differs\n",
+				       __func__, start, len);
+				return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Hash @len bytes of @data, or @data repeated up to @len bytes when it is
+ * shorter, through the progressive interface, feeding it in pieces of
+ * @step bytes so that partial and multi-block updates are both used.
+ */
+static int hash_pieces(struct hash_algo *algo, const char *data, uint len,
+		       uint step, u8 *digest)
+{
+	uint dlen = strlen(data), done, n, i;
+	void *ctx;
+	u8 *buf;
+
+	buf = malloc(step);
+	if (!buf)
+		return -ENOMEM;
+	if (algo->hash_init(algo, &ctx)) {
+		free(buf);
+		return -EINVAL;
+	}
+	for (done = 0; done < len; done += n) {
+		n = min(step, len - done);
+		for (i = 0; i < n; i++)
+			buf[i] = data[(done + i) % dlen];
+		if (algo->hash_update(algo, ctx, buf, n, done + n == len)) {
+			free(buf);
+			return -EINVAL;
+		}
+	}
+	free(buf);
+
+	return algo->hash_finish(algo, ctx, digest, algo->digest_size);
+}
+
+static int test_sha_vectors(void)
+{
+	static const struct {
+		const char *algo;
+		const char *data;
+		uint len;
+		const char *digest;
+	} vectors[] = {
+		{ "sha1", "", 0,
+		  "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+		{ "sha1", "abc", 3,
+		  "a9993e364706816aba3e25717850c26c9cd0d89d" },
+		{ "sha1", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		  56, "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+		{ "sha1", "a", 1000000,
+		  "34aa973cd4c4daa4f61eeb2bdbad27316534016f" },
+		{ "sha256", "", 0,
+		  "e3b0c44298fc1c149afbf4c8996fb924"
+		  "27ae41e4649b934ca495991b7852b855" },
+		{ "sha256", "abc", 3,
+		  "ba7816bf8f01cfea414140de5dae2223"
+		  "b00361a396177a9cb410ff61f20015ad" },
+		{ "sha256", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		  56, "248d6a61d20638b8e5c026930c3e6039"
+		  "a33ce45964ff2167f6ecedd419db06c1" },
+		{ "sha256", "a", 1000000,
+		  "cdc76e5c9914fb9281a1c7e284d73e67"
+		  "f1809a48a497200e046d39ccc7112cd0" },
+	};
+	static const uint steps[] = { 1, 63, 64, 65, 1000, 4096 };
+	struct hash_algo *algo;
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	char hex[HASH_MAX_DIGEST_SIZE * 2 + 1];
+	int i, j, k;
+
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		if (hash_progressive_lookup_algo(vectors[i].algo, &algo))
+			continue;
+		for (j = 0; j < ARRAY_SIZE(steps); j++) {
+			/* A byte at a time over a megabyte takes too long */
+			if (vectors[i].len > 10000 && steps[j] < 64)
+				continue;
+			if (hash_pieces(algo, vectors[i].data, vectors[i].len,
+					steps[j], digest))
+				return -ENOMEM;
+			for (k = 0; k < algo->digest_size; k++)
+				sprintf(hex + k * 2, "%02x", digest[k]);
+			if (strcmp(hex, vectors[i].digest)) {
+				printf("%s: %s of %u bytes in %u-byte pieces is %s, expected %s\n",
+				       __func__, vectors[i].algo,
+				       vectors[i].len, steps[j], hex,
+				       vectors[i].digest);
+				return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Check that one pass with several algorithms gives each one's digest */
+static int test_hash_multi(void)
+{
+	static const char *const names[] = { "crc32", "sha1", "sha256" };
+	uint8_t output[HASH_MULTI_MAX][HASH_MAX_DIGEST_SIZE];
+	uint8_t expect[HASH_MAX_DIGEST_SIZE];
+	const uint len = 3 * HASH_MULTI_CHUNK + 5;
+	struct hash_multi hm;
+	int i, size, ret;
+	u8 *buf;
+
+	buf = malloc(len);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < len; i++)
+		buf[i] = i * 31 + (i >> 9);
+
+	hash_multi_init(&hm);
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (hash_multi_add(&hm, names[i]) != i) {
+			printf("%s: cannot add %s\n", __func__, names[i]);
+			free(buf);
+			return -EINVAL;
+		}
+	}
+	/* Two updates, the first ending part way through a chunk */
+	ret = hash_multi_update(&hm, buf, 1000, 0);
+	ret |= hash_multi_update(&hm, buf + 1000, len - 1000, 1);
+	ret |= hash_multi_finish(&hm, output);
+
+	for (i = 0; !ret && i < ARRAY_SIZE(names); i++) {
+		size = sizeof(expect);
+		ret = hash_block(names[i], buf, len, expect, &size);
+		if (!ret && memcmp(output[i], expect, size)) {
+			printf("%s: %s digest differs\n", __func__, names[i]);
+			ret = -EINVAL;
+		}
+	}
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Run @func over a buffer until enough time has passed to give a useful
+ * figure, and print the throughput in MB/s.
+ */
+static int hash_speed(const char *name,
+		      void (*func)(const u8 *buf, uint len))
+{
+	ulong start, elapsed, bytes = 0;
+	u8 *buf;
+	int i;
+
+	buf = malloc(HASH_SPEED_SIZE);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < HASH_SPEED_SIZE; i++)
+		buf[i] = i ^ (i >> 8);
+
+	start = timer_get_us();
+	do {
+		func(buf, HASH_SPEED_SIZE);
+		bytes += HASH_SPEED_SIZE;
+		elapsed = timer_get_us() - start;
+	} while (elapsed < HASH_SPEED_MIN_US);
+
+	printf("%s: %lu MB/s\n", name, bytes / elapsed);
+	free(buf);
+
+	return 0;
+}
+
+static void speed_crc32(const u8 *buf, uint len)
+{
+	crc32(0, buf, len);
+}
+
+#ifdef CONFIG_SHA1
+static void speed_sha1(const u8 *buf, uint len)
+{
+	u8 digest[SHA1_SUM_LEN];
+
+	sha1_csum_wd(buf, len, digest, CHUNKSZ_SHA1);
+}
+#endif
+
+#ifdef CONFIG_SHA256
+static void speed_sha256(const u8 *buf, uint len)
+{
+	u8 digest[SHA256_SUM_LEN];
+
+	sha256_csum_wd(buf, len, digest, CHUNKSZ_SHA256);
+}
+#endif
+
+int do_ut_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret = 0;
+
+	ret |= test_crc32_vectors();
+	ret |= test_crc32_lengths();
+	ret |= test_sha_vectors();
+	ret |= test_hash_multi();
+	ret |= hash_speed("crc32", speed_crc32);
+#ifdef CONFIG_SHA1
+	ret |= hash_speed("sha1", speed_sha1);
+#endif
+#ifdef CONFIG_SHA256
+	ret |= hash_speed("sha256", speed_sha256);
+#endif
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}